@@ -8,16 +8,12 @@ if [ $? = 0 ]; then
 	exit
 fi;
 
-tab=($((echo "NEW base"; cat $input; echo ?$num) | $program 2> /dev/null))
+result=$( (echo "NEW base"; cat $input; echo; echo !$num) | $program 2> /dev/null)
 if [ $? = 1 ]; then
 	echo "ERROR"
 	exit
 fi;
 
-idx=0
-for i in `(echo "NEW base"; cat $input; echo ; printf "%s? " "${tab[@]}") | $program`; do
-	if [ $i = $num ]; then
-		echo "${tab[$idx]}"
-	fi;
-	((idx++))
-done; 
\ No newline at end of file
+if [ -n "$result" ]; then
+	echo "$result"
+fi;
@@ -0,0 +1,288 @@
+/** @file
+ * Implementacja klasy udostępniającej przekierowania numerów telefonicznych
+ * wielu wątkom jednocześnie.
+ *
+ * Struktura przechowuje dwie kopie przekierowań. Wątki czytające korzystają
+ * zawsze z kopii aktywnej, a wątek modyfikujący najpierw zmienia kopię
+ * nieaktywną, następnie atomowo zamienia kopie rolami i po odczekaniu, aż
+ * czytający opuszczą starą kopię, wprowadza w niej tę samą zmianę. Dzięki
+ * temu czytający nigdy nie czekają, a pula węzłów każdej z kopii może być
+ * swobodnie realokowana i kompaktowana przez modyfikującego.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include "concurrent_forward.h"
+
+/// Liczba liczników wątków czytających przypadających na jedną kopię.
+#define READER_SLOTS 64
+
+/// Rozmiar linii pamięci podręcznej procesora.
+#define CACHE_LINE 64
+
+/**
+ * Licznik wątków czytających zajmujący osobną linię pamięci podręcznej, aby
+ * wątki korzystające z różnych liczników nie unieważniały sobie nawzajem
+ * pamięci podręcznej.
+ */
+typedef struct {
+	alignas(CACHE_LINE) atomic_size_t count; ///< liczba wątków czytających
+} Readers;
+
+/**
+ * Struktura przechowująca przekierowania współdzielone przez wątki.
+ */
+struct ConcurrentForward {
+	struct PhoneForward *sides[2];        ///< obie kopie przekierowań
+	Readers readers[2][READER_SLOTS];     ///< liczniki czytających każdej kopii
+	alignas(CACHE_LINE) atomic_int active; ///< indeks kopii aktywnej
+	pthread_mutex_t writer;               ///< blokada modyfikujących
+	bool diverged;                        ///< czy kopia nieaktywna jest nieaktualna
+};
+
+/// Licznik przydzielający wątkom czytającym ich liczniki.
+static atomic_uint nextSlot = 0;
+
+/// Indeks licznika bieżącego wątku powiększony o 1 lub 0, gdy nie przydzielono.
+static _Thread_local unsigned slot = 0;
+
+/// Rodzaj modyfikacji struktury.
+typedef enum {
+	ADD,   ///< dodanie przekierowania
+	REMOVE ///< usunięcie przekierowań
+} Operation;
+
+/** @brief Podaje licznik bieżącego wątku.
+* Przy pierwszym wywołaniu w danym wątku przydziela mu licznik.
+* @return Indeks licznika bieżącego wątku.
+*/
+static unsigned readerSlot(void) {
+	if (slot == 0)
+		slot = 1 + atomic_fetch_add_explicit(&nextSlot, 1, memory_order_relaxed)
+			   % READER_SLOTS;
+
+	return slot - 1;
+}
+
+/** @brief Rozpoczyna odczyt.
+* Rejestruje bieżący wątek jako czytający kopię aktywną.
+* @param[in, out] cf – wskaźnik na strukturę przechowującą przekierowania.
+* @param[out] side – indeks kopii, z której należy czytać.
+* @return Wskaźnik na licznik, który należy zmniejszyć po zakończeniu odczytu.
+*/
+static atomic_size_t * beginRead(struct ConcurrentForward *cf, int *side) {
+	unsigned i = readerSlot();
+
+	while (true) {
+		int s = atomic_load(&cf->active);
+		atomic_size_t *count = &cf->readers[s][i].count;
+		atomic_fetch_add(count, 1);
+
+		// Jeśli w międzyczasie kopie zamieniono rolami, modyfikujący mógł nie
+		// zauważyć naszego licznika, więc próbujemy ponownie.
+		if (atomic_load(&cf->active) == s) {
+			*side = s;
+			return count;
+		}
+
+		atomic_fetch_sub(count, 1);
+	}
+}
+
+/** @brief Kończy odczyt.
+* @param[in, out] count – licznik zwrócony przez @ref beginRead.
+*/
+static void endRead(atomic_size_t *count) {
+	atomic_fetch_sub_explicit(count, 1, memory_order_release);
+}
+
+/** @brief Czeka, aż kopię opuszczą wszystkie wątki czytające.
+* Odczyt liczników musi być sekwencyjnie spójny: zapis kopii aktywnej
+* i odczyt licznika, tak jak zwiększenie licznika i odczyt kopii aktywnej
+* w @ref beginRead, nie mogą zostać zamienione miejscami.
+* @param[in] cf – wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] side – indeks kopii.
+*/
+static void waitForReaders(struct ConcurrentForward *cf, int side) {
+	for (int i = 0; i < READER_SLOTS; i++)
+		while (atomic_load(&cf->readers[side][i].count) != 0)
+			sched_yield();
+}
+
+/** @brief Wprowadza modyfikację w jednej kopii.
+* @param[in, out] pf – wskaźnik na modyfikowaną kopię.
+* @param[in] op – rodzaj modyfikacji.
+* @param[in] num1 – pierwszy argument modyfikacji.
+* @param[in] num2 – drugi argument modyfikacji lub NULL.
+* @return Wartość @p true, jeśli modyfikacja się powiodła.
+*/
+static bool apply(struct PhoneForward *pf, Operation op, char const *num1,
+				  char const *num2) {
+	if (op == ADD)
+		return phfwdAdd(pf, num1, num2);
+
+	phfwdRemove(pf, num1);
+
+	return true;
+}
+
+/** @brief Zastępuje kopię nieaktywną kopią aktywnej.
+* Wywoływana, gdy nie udało się wprowadzić w kopii nieaktywnej modyfikacji
+* zastosowanej już w kopii aktywnej.
+* @param[in, out] cf – wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] side – indeks kopii nieaktywnej.
+* @return Wartość @p true, jeśli udało się utworzyć kopię.
+*/
+static bool resync(struct ConcurrentForward *cf, int side) {
+	struct PhoneForward *copy = phfwdDuplicate(cf->sides[1 - side]);
+
+	if (copy == NULL)
+		return false;
+
+	phfwdDelete(cf->sides[side]);
+	cf->sides[side] = copy;
+
+	return true;
+}
+
+/** @brief Modyfikuje strukturę.
+* Wprowadza modyfikację w obu kopiach, publikując ją atomowo.
+* @param[in, out] cf – wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] op – rodzaj modyfikacji.
+* @param[in] num1 – pierwszy argument modyfikacji.
+* @param[in] num2 – drugi argument modyfikacji lub NULL.
+* @return Wartość @p true, jeśli modyfikacja się powiodła.
+*/
+static bool update(struct ConcurrentForward *cf, Operation op,
+				   char const *num1, char const *num2) {
+	pthread_mutex_lock(&cf->writer);
+
+	int old = atomic_load(&cf->active);
+	int side = 1 - old;
+	waitForReaders(cf, side);
+
+	if (cf->diverged) {
+		if (!resync(cf, side)) {
+			pthread_mutex_unlock(&cf->writer);
+			return false;
+		}
+
+		cf->diverged = false;
+	}
+
+	if (!apply(cf->sides[side], op, num1, num2)) {
+		pthread_mutex_unlock(&cf->writer);
+		return false;
+	}
+
+	atomic_store(&cf->active, side);
+	waitForReaders(cf, old);
+
+	if (!apply(cf->sides[old], op, num1, num2) && !resync(cf, old))
+		cf->diverged = true;
+
+	pthread_mutex_unlock(&cf->writer);
+
+	return true;
+}
+
+struct ConcurrentForward * phcfNew(void) {
+	return phcfFrom(phfwdNew());
+}
+
+struct ConcurrentForward * phcfFrom(struct PhoneForward *pf) {
+	if (pf == NULL)
+		return NULL;
+
+	struct ConcurrentForward *cf = (struct ConcurrentForward*)aligned_alloc(
+		CACHE_LINE, sizeof(struct ConcurrentForward));
+
+	if (cf == NULL) {
+		phfwdDelete(pf);
+		return NULL;
+	}
+
+	cf->sides[0] = pf;
+	cf->sides[1] = phfwdDuplicate(pf);
+
+	if (cf->sides[1] == NULL || pthread_mutex_init(&cf->writer, NULL) != 0) {
+		phfwdDelete(cf->sides[1]);
+		phfwdDelete(pf);
+		free(cf);
+		return NULL;
+	}
+
+	for (int s = 0; s < 2; s++)
+		for (int i = 0; i < READER_SLOTS; i++)
+			atomic_init(&cf->readers[s][i].count, 0);
+
+	atomic_init(&cf->active, 0);
+	cf->diverged = false;
+
+	return cf;
+}
+
+void phcfDelete(struct ConcurrentForward *cf) {
+	if (cf == NULL)
+		return;
+
+	pthread_mutex_destroy(&cf->writer);
+	phfwdDelete(cf->sides[0]);
+	phfwdDelete(cf->sides[1]);
+	free(cf);
+}
+
+bool phcfAdd(struct ConcurrentForward *cf, char const *num1, char const *num2) {
+	if (cf == NULL)
+		return false;
+
+	return update(cf, ADD, num1, num2);
+}
+
+void phcfRemove(struct ConcurrentForward *cf, char const *num) {
+	if (cf != NULL)
+		update(cf, REMOVE, num, NULL);
+}
+
+struct PhoneNumbers const * phcfGet(struct ConcurrentForward *cf, char const *num) {
+	if (cf == NULL)
+		return phfwdGet(NULL, num);
+
+	int side;
+	atomic_size_t *count = beginRead(cf, &side);
+	struct PhoneNumbers const *ph = phfwdGet(cf->sides[side], num);
+	endRead(count);
+
+	return ph;
+}
+
+struct PhoneNumbers const * phcfReverse(struct ConcurrentForward *cf, char const *num) {
+	if (cf == NULL)
+		return phfwdReverse(NULL, num);
+
+	int side;
+	atomic_size_t *count = beginRead(cf, &side);
+	struct PhoneNumbers const *ph = phfwdReverse(cf->sides[side], num);
+	endRead(count);
+
+	return ph;
+}
+
+size_t phcfReverseCount(struct ConcurrentForward *cf, char const *num) {
+	if (cf == NULL)
+		return 0;
+
+	int side;
+	atomic_size_t *count = beginRead(cf, &side);
+	size_t result = phfwdReverseCount(cf->sides[side], num);
+	endRead(count);
+
+	return result;
+}
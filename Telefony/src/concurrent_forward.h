@@ -0,0 +1,93 @@
+/** @file
+ * Interfejs klasy udostępniającej przekierowania numerów telefonicznych
+ * wielu wątkom jednocześnie.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#ifndef __CONCURRENT_FORWARD_H__
+#define __CONCURRENT_FORWARD_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "phone_forward.h"
+
+/// Struktura przechowująca przekierowania współdzielone przez wątki.
+struct ConcurrentForward;
+
+/** @brief Tworzy nową strukturę.
+* Tworzy nową strukturę niezawierającą żadnych przekierowań.
+* @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
+*         zaalokować pamięci.
+*/
+struct ConcurrentForward * phcfNew(void);
+
+/** @brief Tworzy strukturę z istniejących przekierowań.
+* Tworzy strukturę zawierającą przekierowania struktury @p pf, która
+* przechodzi na jej własność.
+* @param[in] pf – wskaźnik na strukturę przekierowań.
+* @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
+*         zaalokować pamięci; struktura @p pf jest wtedy usuwana.
+*/
+struct ConcurrentForward * phcfFrom(struct PhoneForward *pf);
+
+/** @brief Usuwa strukturę.
+* Usuwa strukturę wskazywaną przez @p cf. Żaden wątek nie może wtedy z niej
+* korzystać. Nic nie robi, jeśli wskaźnik ten ma wartość NULL.
+* @param[in] cf – wskaźnik na usuwaną strukturę.
+*/
+void phcfDelete(struct ConcurrentForward *cf);
+
+/** @brief Dodaje przekierowanie.
+* Działa jak funkcja @ref phfwdAdd. Zmiany są publikowane atomowo: wątek
+* czytający widzi strukturę sprzed zmiany albo po niej. Zmiany wykonywane
+* przez kilka wątków są szeregowane.
+* @param[in, out] cf – wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] num1 – wskaźnik na napis reprezentujący prefiks numerów
+*                   przekierowywanych;
+* @param[in] num2 – wskaźnik na napis reprezentujący prefiks numerów, na które
+*                   jest wykonywane przekierowanie.
+* @return Wartość @p true, jeśli przekierowanie zostało dodane.
+*         Wartość @p false, jeśli wystąpił błąd, np. podany napis nie
+*         reprezentuje numeru, oba podane numery są identyczne lub nie
+*         udało się zaalokować pamięci.
+*/
+bool phcfAdd(struct ConcurrentForward *cf, char const *num1, char const *num2);
+
+/** @brief Usuwa przekierowania.
+* Działa jak funkcja @ref phfwdRemove, publikując zmianę atomowo.
+* @param[in, out] cf – wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] num – wskaźnik na napis reprezentujący prefiks numerów.
+*/
+void phcfRemove(struct ConcurrentForward *cf, char const *num);
+
+/** @brief Wyznacza przekierowanie numeru.
+* Działa jak funkcja @ref phfwdGet. Wątki czytające nie blokują się
+* wzajemnie ani nie czekają na wątek modyfikujący strukturę.
+* @param[in] cf – wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] num – wskaźnik na napis reprezentujący numer.
+* @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+*         udało się zaalokować pamięci.
+*/
+struct PhoneNumbers const * phcfGet(struct ConcurrentForward *cf, char const *num);
+
+/** @brief Wyznacza przekierowania na dany numer.
+* Działa jak funkcja @ref phfwdReverse, nie blokując innych wątków
+* czytających.
+* @param[in] cf – wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] num – wskaźnik na napis reprezentujący numer.
+* @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+*         udało się zaalokować pamięci.
+*/
+struct PhoneNumbers const * phcfReverse(struct ConcurrentForward *cf, char const *num);
+
+/** @brief Zlicza przekierowania na dany numer.
+* Działa jak funkcja @ref phfwdReverseCount, nie blokując innych wątków
+* czytających.
+* @param[in] cf – wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] num – wskaźnik na napis reprezentujący numer.
+* @return Liczba różnych numerów, które przekierowują na numer @p num.
+*/
+size_t phcfReverseCount(struct ConcurrentForward *cf, char const *num);
+
+#endif /* __CONCURRENT_FORWARD_H__ */
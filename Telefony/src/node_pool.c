@@ -0,0 +1,1489 @@
+/** @file
+ * Implementacja interfejsu klasy przechowującej węzły drzew
+ * przekierowań w jednej puli.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "node_pool.h"
+
+/// Początkowy rozmiar tablicy węzłów.
+#define INITIAL_NODES 64
+
+/// Początkowy rozmiar tablic znaków.
+#define INITIAL_CHARS 256
+
+/// Minimalna liczba zwolnionych znaków, przy której opłaca się upakowanie.
+#define MIN_GARBAGE 4096
+
+/// Znacznik rozpoczynający plik z zapisem drzew.
+#define SNAPSHOT_MAGIC "PHFWDSNP"
+
+/// Wersja formatu pliku z zapisem drzew.
+#define SNAPSHOT_VERSION 2
+
+/** @brief Nagłówek pliku z zapisem drzew.
+ * Po nagłówku znajdują się kolejno tablica węzłów, tablica etykiet i tablica
+ * numerów. Wszystkie odwołania w tablicach są indeksami, więc plik można
+ * odwzorować pod dowolnym adresem.
+ */
+typedef struct Snapshot {
+	/// Znacznik @p SNAPSHOT_MAGIC.
+	char magic[8];
+	/// Wersja formatu.
+	uint32_t version;
+	/// Rozmiar węzła, chroniący przed wczytaniem pliku z innej architektury.
+	uint32_t nodeSize;
+	/// Liczba węzłów.
+	uint32_t size;
+	/// Liczba znaków etykiet.
+	uint32_t labelsSize;
+	/// Liczba znaków numerów.
+	uint32_t charsSize;
+	/// Wyrównanie do ośmiu bajtów.
+	uint32_t padding;
+	/// Indeksy korzeni drzew.
+	NodeIdx roots[SNAPSHOT_TREES];
+	/// Parametry zapisane razem z drzewami.
+	uint64_t params[SNAPSHOT_PARAMS];
+} Snapshot;
+
+/** @brief Sprawdza, czy tablica leży w odwzorowaniu pliku.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] array - wskaźnik na tablicę puli.
+* @return Wartość @p true, jeśli tablica leży w odwzorowaniu pliku.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+static bool isMapped(NodePool const *pool, void const *array) {
+	char const *begin = (char const*)pool->mapping;
+
+	return begin != NULL && (char const*)array >= begin
+		   && (char const*)array < begin + pool->mappingSize;
+}
+
+/** @brief Zmienia rozmiar tablicy puli.
+* Działa jak realloc, ale tablicę leżącą w odwzorowaniu pliku kopiuje na
+* stertę, zostawiając odwzorowanie bez zmian.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] array - wskaźnik na tablicę.
+* @param[in] size - liczba wykorzystanych bajtów tablicy.
+* @param[in] capacity - nowy rozmiar tablicy w bajtach.
+* @return Wskaźnik na tablicę nowego rozmiaru lub NULL, gdy nie udało się
+*         zaalokować pamięci.
+*/
+static void * resizeArray(NodePool const *pool, void *array, size_t size,
+						  size_t capacity) {
+	if (!isMapped(pool, array))
+		return realloc(array, capacity);
+
+	void *copy = malloc(capacity);
+
+	if (copy != NULL)
+		memcpy(copy, array, size);
+
+	return copy;
+}
+
+/** @brief Zwalnia tablicę puli.
+* Tablice leżące w odwzorowaniu pliku są zwalniane razem z nim.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] array - wskaźnik na tablicę.
+*/
+static void freeArray(NodePool const *pool, void *array) {
+	if (!isMapped(pool, array))
+		free(array);
+}
+
+bool initPool(NodePool *pool) {
+	pool->nodes = (Node*)malloc(sizeof(Node) * INITIAL_NODES);
+	pool->chars = (char*)malloc(sizeof(char) * INITIAL_CHARS);
+	pool->labels = (char*)malloc(sizeof(char) * INITIAL_CHARS);
+
+	if (pool->nodes == NULL || pool->chars == NULL || pool->labels == NULL) {
+		free(pool->nodes);
+		free(pool->chars);
+		free(pool->labels);
+		return false;
+	}
+
+	// Indeksy i wartości równe zeru oznaczają brak węzła i brak numeru,
+	// a wartość PRESENT nie jest numerem.
+	pool->size = 1;
+	pool->capacity = INITIAL_NODES;
+	pool->charsSize = PRESENT + 1;
+	pool->charsCapacity = INITIAL_CHARS;
+	pool->garbage = 0;
+	pool->labelsSize = 0;
+	pool->labelsCapacity = INITIAL_CHARS;
+	pool->labelsGarbage = 0;
+	pool->refs = NULL;
+	pool->users = 1;
+	pool->released = NULL;
+	pool->releasedSize = 0;
+	pool->releasedCapacity = 0;
+	pool->mapping = NULL;
+	pool->mappingSize = 0;
+
+	for (int i = 0; i <= SYMBOLS; i++)
+		pool->freeBlocks[i] = NO_NODE;
+
+	return true;
+}
+
+void clearPool(NodePool *pool) {
+	freeArray(pool, pool->nodes);
+	freeArray(pool, pool->chars);
+	freeArray(pool, pool->labels);
+	free(pool->refs);
+	free(pool->released);
+
+	if (pool->mapping != NULL)
+		munmap(pool->mapping, pool->mappingSize);
+
+	pool->nodes = NULL;
+	pool->chars = NULL;
+	pool->labels = NULL;
+	pool->refs = NULL;
+	pool->released = NULL;
+	pool->mapping = NULL;
+}
+
+bool sharePool(NodePool *pool) {
+	if (pool->refs != NULL)
+		return true;
+
+	pool->refs = (uint32_t*)malloc(sizeof(uint32_t) * pool->capacity);
+
+	if (pool->refs == NULL)
+		return false;
+
+	// Dotychczas każdy blok należał do jednego drzewa.
+	for (uint32_t i = 0; i < pool->capacity; i++)
+		pool->refs[i] = 1;
+
+	return true;
+}
+
+/** @brief Zwraca liczbę odwołań do bloku.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks pierwszego węzła bloku.
+* @return Liczba węzłów, których dziećmi są węzły bloku.
+*/
+static inline uint32_t blockRefs(NodePool const *pool, NodeIdx idx) {
+	return pool->refs == NULL ? 1 : pool->refs[idx];
+}
+
+/** @brief Alokuje blok węzłów.
+* Bierze blok z listy wolnych bloków danego rozmiaru, a gdy jest ona pusta,
+* z końca tablicy węzłów, powiększając ją w razie potrzeby.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] n - liczba węzłów bloku.
+* @return Indeks pierwszego węzła bloku lub @p NO_NODE, gdy nie udało się
+*         zaalokować pamięci.
+*/
+static NodeIdx allocBlock(NodePool *pool, uint32_t n) {
+	NodeIdx idx = pool->freeBlocks[n];
+
+	if (idx != NO_NODE) {
+		pool->freeBlocks[n] = pool->nodes[idx].kids;
+	}
+	else {
+		if (pool->capacity - pool->size < n) {
+			uint64_t capacity = 2 * (uint64_t)pool->capacity;
+
+			// Pula wczytana z pliku może mieć tablicę mniejszą od bloku.
+			while (capacity - pool->size < n)
+				capacity *= 2;
+
+			if (capacity > UINT32_MAX)
+				return NO_NODE;
+
+			if (pool->refs != NULL) {
+				uint32_t *refs = (uint32_t*)realloc(pool->refs, sizeof(uint32_t) * capacity);
+
+				if (refs == NULL)
+					return NO_NODE;
+
+				pool->refs = refs;
+			}
+
+			Node *nodes = (Node*)resizeArray(pool, pool->nodes,
+											 sizeof(Node) * pool->size,
+											 sizeof(Node) * capacity);
+
+			if (nodes == NULL)
+				return NO_NODE;
+
+			pool->nodes = nodes;
+			pool->capacity = capacity;
+		}
+
+		idx = pool->size;
+		pool->size += n;
+	}
+
+	if (pool->refs != NULL)
+		pool->refs[idx] = 1;
+
+	return idx;
+}
+
+/** @brief Zwalnia blok węzłów.
+* Zeruje długości etykiet i wartości węzłów bloku, dzięki czemu upakowanie
+* etykiet i numerów pomija wolne węzły.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks pierwszego węzła bloku.
+* @param[in] n - liczba węzłów bloku.
+*/
+static void freeBlock(NodePool *pool, NodeIdx idx, uint32_t n) {
+	for (uint32_t i = 0; i < n; i++) {
+		pool->nodes[idx + i].length = 0;
+		pool->nodes[idx + i].value = 0;
+	}
+
+	pool->nodes[idx].kids = pool->freeBlocks[n];
+	pool->freeBlocks[n] = idx;
+}
+
+/** @brief Zapewnia miejsce w tablicy etykiet.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] len - liczba znaków, które mają się zmieścić w tablicy.
+* @return Wartość @p true, jeśli tablica ma wystarczający rozmiar.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool reserveLabels(NodePool *pool, size_t len) {
+	if (pool->labelsCapacity - pool->labelsSize >= len)
+		return true;
+
+	if (len >= UINT32_MAX - pool->labelsSize)
+		return false;
+
+	// Pula wczytana z pliku może mieć pustą tablicę etykiet.
+	uint64_t capacity = pool->labelsCapacity < INITIAL_CHARS
+						? INITIAL_CHARS : (uint64_t)pool->labelsCapacity * 2;
+
+	while (capacity - pool->labelsSize < len)
+		capacity *= 2;
+
+	if (capacity > UINT32_MAX)
+		capacity = UINT32_MAX;
+
+	char *labels = (char*)resizeArray(pool, pool->labels, pool->labelsSize,
+									  sizeof(char) * capacity);
+
+	if (labels == NULL)
+		return false;
+
+	pool->labels = labels;
+	pool->labelsCapacity = capacity;
+
+	return true;
+}
+
+/** @brief Upakowuje etykiety.
+* Jeśli etykiety usuniętych krawędzi zajmują więcej niż połowę tablicy
+* etykiet, przepisuje etykiety wszystkich węzłów do nowej tablicy.
+* Gdy nie uda się zaalokować pamięci, pula pozostaje bez zmian.
+* @param[in] pool - wskaźnik na pulę.
+*/
+static void compactLabels(NodePool *pool) {
+	if (pool->labelsGarbage < MIN_GARBAGE
+		|| pool->labelsGarbage < pool->labelsSize / 2)
+		return;
+
+	// Etykiety wspólne dla kopii węzłów są liczone jako zwolnione, gdy
+	// zwalniana jest jedna z kopii, więc rozmiar wyznaczamy dokładnie.
+	uint64_t capacity = 0;
+
+	for (NodeIdx i = 1; i < pool->size; i++)
+		capacity += pool->nodes[i].length;
+
+	if (capacity > UINT32_MAX)
+		return;
+
+	if (capacity < INITIAL_CHARS)
+		capacity = INITIAL_CHARS;
+
+	char *labels = (char*)malloc(sizeof(char) * capacity);
+
+	if (labels == NULL)
+		return;
+
+	uint32_t size = 0;
+
+	for (NodeIdx i = 1; i < pool->size; i++) {
+		Node *node = pool->nodes + i;
+
+		if (node->length != 0) {
+			memcpy(labels + size, pool->labels + node->label, node->length);
+			node->label = size;
+			size += node->length;
+		}
+	}
+
+	freeArray(pool, pool->labels);
+	pool->labels = labels;
+	pool->labelsSize = size;
+	pool->labelsCapacity = capacity;
+	pool->labelsGarbage = 0;
+}
+
+NodeIdx cloneRoot(NodePool *pool, NodeIdx root) {
+	NodeIdx idx = allocBlock(pool, 1);
+
+	if (idx == NO_NODE)
+		return NO_NODE;
+
+	Node *node = pool->nodes + idx;
+	*node = pool->nodes[root];
+
+	if (node->mask != 0)
+		pool->refs[node->kids]++;
+
+	return idx;
+}
+
+NodeIdx newRoot(NodePool *pool) {
+	NodeIdx idx = allocBlock(pool, 1);
+
+	if (idx == NO_NODE)
+		return NO_NODE;
+
+	pool->nodes[idx].mask = 0;
+	pool->nodes[idx].length = 0;
+	pool->nodes[idx].kids = NO_NODE;
+	pool->nodes[idx].value = 0;
+	pool->nodes[idx].label = 0;
+
+	return idx;
+}
+
+/** @brief Zapewnia wyłączność bloku dzieci węzła.
+* Jeśli blok dzieci węzła @p idx jest dzielony z innymi drzewami, zastępuje
+* go kopią, której węzły dzielą dalsze bloki z oryginałem.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła.
+* @return Wartość @p true, jeśli blok dzieci należy tylko do węzła @p idx.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool ownKids(NodePool *pool, NodeIdx idx) {
+	uint32_t n = __builtin_popcount(pool->nodes[idx].mask);
+
+	if (n == 0 || blockRefs(pool, pool->nodes[idx].kids) == 1)
+		return true;
+
+	NodeIdx kids = allocBlock(pool, n);
+
+	if (kids == NO_NODE)
+		return false;
+
+	Node *nodes = pool->nodes;
+	NodeIdx old = nodes[idx].kids;
+	memcpy(nodes + kids, nodes + old, sizeof(Node) * n);
+
+	for (uint32_t i = 0; i < n; i++)
+		if (nodes[kids + i].mask != 0)
+			pool->refs[nodes[kids + i].kids]++;
+
+	pool->refs[old]--;
+	nodes[idx].kids = kids;
+
+	return true;
+}
+
+/** @brief Dodaje dziecko węzła.
+* Dodaje węzłowi dziecko o pustej etykiecie. Węzeł nie może mieć już
+* dziecka o danym symbolu.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła.
+* @param[in] c - symbol krawędzi prowadzącej do dziecka.
+* @return Indeks dziecka lub @p NO_NODE, gdy nie udało się zaalokować pamięci.
+*/
+static NodeIdx addChild(NodePool *pool, NodeIdx idx, char c) {
+	uint16_t mask = pool->nodes[idx].mask;
+	uint16_t bit = 1u << (c - '0');
+	uint32_t n = __builtin_popcount(mask);
+	uint32_t rank = __builtin_popcount(mask & (bit - 1));
+	NodeIdx kids = allocBlock(pool, n + 1);
+
+	if (kids == NO_NODE)
+		return NO_NODE;
+
+	NodeIdx old = pool->nodes[idx].kids;
+	Node *nodes = pool->nodes;
+
+	memcpy(nodes + kids, nodes + old, sizeof(Node) * rank);
+	memcpy(nodes + kids + rank + 1, nodes + old + rank, sizeof(Node) * (n - rank));
+	nodes[kids + rank].mask = 0;
+	nodes[kids + rank].length = 0;
+	nodes[kids + rank].kids = NO_NODE;
+	nodes[kids + rank].value = 0;
+	nodes[kids + rank].label = 0;
+
+	if (n > 0)
+		freeBlock(pool, old, n);
+
+	nodes[idx].mask = mask | bit;
+	nodes[idx].kids = kids;
+
+	return kids + rank;
+}
+
+/** @brief Zwalnia blok dzieci.
+* Usuwa jedno odwołanie do bloku @p kids. Gdy było ono ostatnie, zwalnia
+* blok wraz ze wszystkimi blokami poddrzew jego węzłów, do których nie
+* odwołują się inne drzewa.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] kids - indeks pierwszego węzła bloku.
+* @param[in] n - liczba węzłów bloku.
+* @param[in] numbers - czy zwalniać numery będące wartościami węzłów.
+*/
+static void releaseKids(NodePool *pool, NodeIdx kids, uint32_t n, bool numbers) {
+	if (blockRefs(pool, kids) > 1) {
+		pool->refs[kids]--;
+		return;
+	}
+
+	for (uint32_t i = 0; i < n; i++) {
+		Node const *node = pool->nodes + kids + i;
+
+		if (node->mask != 0)
+			releaseKids(pool, node->kids, __builtin_popcount(node->mask), numbers);
+
+		if (numbers && node->value > PRESENT)
+			freeNumber(pool, node->value);
+
+		pool->labelsGarbage += node->length;
+	}
+
+	freeBlock(pool, kids, n);
+}
+
+/** @brief Usuwa potomków węzła.
+* Zwalnia wszystkie bloki poddrzewa o korzeniu @p idx, poza blokiem, w którym
+* znajduje się sam węzeł, i zeruje jego maskę.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła.
+*/
+static void freeSubtree(NodePool *pool, NodeIdx idx) {
+	Node *node = pool->nodes + idx;
+
+	if (node->mask == 0)
+		return;
+
+	releaseKids(pool, node->kids, __builtin_popcount(node->mask), false);
+	node->mask = 0;
+	node->kids = NO_NODE;
+}
+
+/** @brief Odkłada blok na stos bloków oczekujących na zwolnienie.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] kids - indeks pierwszego węzła bloku.
+* @param[in] n - liczba węzłów bloku.
+* @param[in] numbers - czy wartości węzłów są numerami, które należy zwolnić.
+* @return Wartość @p true, jeśli udało się odłożyć blok.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool pushRelease(NodePool *pool, NodeIdx kids, uint32_t n, bool numbers) {
+	if (pool->releasedSize == pool->releasedCapacity) {
+		size_t capacity = pool->releasedCapacity == 0 ? INITIAL_NODES
+						  : 2 * pool->releasedCapacity;
+		Release *released = (Release*)realloc(pool->released,
+											  sizeof(Release) * capacity);
+
+		if (released == NULL)
+			return false;
+
+		pool->released = released;
+		pool->releasedCapacity = capacity;
+	}
+
+	Release *r = pool->released + pool->releasedSize++;
+	r->kids = kids;
+	r->n = n;
+	r->numbers = numbers;
+
+	return true;
+}
+
+void deferBlock(NodePool *pool, NodeIdx kids, uint32_t n, bool numbers) {
+	if (!pushRelease(pool, kids, n, numbers)) {
+		releaseKids(pool, kids, n, numbers);
+		compactLabels(pool);
+	}
+}
+
+void releaseTree(NodePool *pool, NodeIdx root, bool numbers) {
+	deferBlock(pool, root, 1, numbers);
+}
+
+bool reclaimPool(NodePool *pool, size_t budget) {
+	if (pool->releasedSize == 0)
+		return false;
+
+	for (size_t done = 0; pool->releasedSize > 0 && done < budget; ) {
+		Release r = pool->released[--pool->releasedSize];
+
+		if (blockRefs(pool, r.kids) > 1) {
+			pool->refs[r.kids]--;
+			done++;
+			continue;
+		}
+
+		// Dalsze bloki odkładamy, więc jeden krok zwalnia jeden blok.
+		for (uint32_t i = 0; i < r.n; i++) {
+			Node const *node = pool->nodes + r.kids + i;
+			uint32_t n = __builtin_popcount(node->mask);
+
+			if (n != 0 && !pushRelease(pool, node->kids, n, r.numbers))
+				releaseKids(pool, node->kids, n, r.numbers);
+
+			if (r.numbers && node->value > PRESENT)
+				freeNumber(pool, node->value);
+
+			pool->labelsGarbage += node->length;
+		}
+
+		freeBlock(pool, r.kids, r.n);
+		done += r.n;
+	}
+
+	compactLabels(pool);
+
+	return pool->releasedSize > 0;
+}
+
+/** @brief Węzeł oczekujący na zbudowanie poddrzewa.
+ * Zadanie funkcji buildTree: węzeł @p idx, którego ścieżka od korzenia jest
+ * wspólnym prefixem długości @p depth kluczy z przedziału [@p lo, @p hi).
+ */
+typedef struct Task {
+	/// Indeks węzła.
+	NodeIdx idx;
+	/// Początek przedziału kluczy.
+	size_t lo;
+	/// Koniec przedziału kluczy.
+	size_t hi;
+	/// Długość ścieżki od korzenia do węzła.
+	size_t depth;
+} Task;
+
+/** @brief Wyznacza kubełek klucza.
+* @param[in] entry - wskaźnik na klucz.
+* @param[in] depth - pozycja symbolu klucza.
+* @return @p 0, gdy klucz ma długość @p depth, a w przeciwnym przypadku
+*         numer symbolu na pozycji @p depth powiększony o 1.
+*/
+static inline uint32_t bucket(Entry const *entry, size_t depth) {
+	return entry->len == depth ? 0 : entry->key[depth] - '0' + 1;
+}
+
+/** @brief Wyznacza etykietę krawędzi budowanego drzewa.
+* @param[in] entries - wskaźnik na pierwszy klucz przedziału.
+* @param[in] n - liczba kluczy przedziału.
+* @param[in] depth - pozycja pierwszego symbolu etykiety.
+* @return Długość wspólnego prefixu kluczy przedziału zaczynającego się na
+*         pozycji @p depth, nie dłuższego niż @p MAX_LABEL i niezawierającego
+*         separatora.
+*/
+static uint32_t commonLabel(Entry const *entries, size_t n, size_t depth) {
+	char const *key = entries[0].key + depth;
+	size_t length = entries[0].len - depth;
+
+	if (length > MAX_LABEL)
+		length = MAX_LABEL;
+
+	char const *separator = (char const*)memchr(key, SEPARATOR, length);
+
+	if (separator != NULL)
+		length = separator - key;
+
+	for (size_t i = 1; i < n && length > 0; i++) {
+		size_t end = entries[i].len - depth;
+		size_t l = 0;
+
+		while (l < length && l < end && entries[i].key[depth + l] == key[l])
+			l++;
+
+		length = l;
+	}
+
+	return length;
+}
+
+bool buildTree(NodePool *pool, NodeIdx root, Entry *entries, size_t n) {
+	size_t capacity = 64;
+	size_t top = 0;
+	Task *tasks = (Task*)malloc(sizeof(Task) * capacity);
+	Entry *buffer = (Entry*)malloc(sizeof(Entry) * (n > 0 ? n : 1));
+
+	if (tasks == NULL || buffer == NULL) {
+		free(tasks);
+		free(buffer);
+		return false;
+	}
+
+	// Zadania przetwarzamy w głąb, dzięki czemu klucze poddrzewa pozostają
+	// w pamięci podręcznej, a poddrzewa zajmują spójne fragmenty puli.
+	tasks[top++] = (Task){root, 0, n, 0};
+	bool ok = true;
+
+	while (ok && top > 0) {
+		Task task = tasks[--top];
+		size_t count[SYMBOLS + 1] = {0};
+
+		// Sortujemy przedział stabilnie według symbolu na pozycji depth,
+		// a klucze kończące się w węźle przenosimy na początek.
+		for (size_t i = task.lo; i < task.hi; i++)
+			count[bucket(entries + i, task.depth)]++;
+
+		size_t start[SYMBOLS + 1];
+		start[0] = task.lo;
+
+		for (int b = 1; b <= SYMBOLS; b++)
+			start[b] = start[b - 1] + count[b - 1];
+
+		for (size_t i = task.lo; i < task.hi; i++)
+			buffer[start[bucket(entries + i, task.depth)]++] = entries[i];
+
+		memcpy(entries + task.lo, buffer + task.lo,
+			   sizeof(Entry) * (task.hi - task.lo));
+
+		if (count[0] > 0) {
+			for (size_t i = task.lo; i + 1 < task.lo + count[0]; i++)
+				entries[i].len = 0;
+
+			task.lo += count[0];
+			pool->nodes[task.idx].value = entries[task.lo - 1].value;
+		}
+
+		uint16_t mask = 0;
+
+		for (int b = 1; b <= SYMBOLS; b++)
+			if (count[b] > 0)
+				mask |= 1u << (b - 1);
+
+		uint32_t m = __builtin_popcount(mask);
+
+		if (m == 0)
+			continue;
+
+		if (top + m > capacity) {
+			Task *bigger = (Task*)realloc(tasks, sizeof(Task) * 2 * (top + m));
+
+			if (bigger == NULL) {
+				ok = false;
+				break;
+			}
+
+			tasks = bigger;
+			capacity = 2 * (top + m);
+		}
+
+		NodeIdx kids = allocBlock(pool, m);
+
+		if (kids == NO_NODE) {
+			ok = false;
+			break;
+		}
+
+		for (uint32_t i = 0; i < m; i++) {
+			pool->nodes[kids + i].mask = 0;
+			pool->nodes[kids + i].length = 0;
+			pool->nodes[kids + i].kids = NO_NODE;
+			pool->nodes[kids + i].value = 0;
+		}
+
+		pool->nodes[task.idx].mask = mask;
+		pool->nodes[task.idx].kids = kids;
+
+		// Dzieci odpowiadają kolejnym niepustym kubełkom.
+		size_t lo = task.lo;
+
+		for (int b = 1; b <= SYMBOLS; b++) {
+			if (count[b] == 0)
+				continue;
+
+			size_t depth = task.depth + 1;
+			uint32_t length = commonLabel(entries + lo, count[b], depth);
+
+			if (!reserveLabels(pool, length)) {
+				ok = false;
+				break;
+			}
+
+			Node *node = pool->nodes + kids;
+			node->length = length;
+			node->label = pool->labelsSize;
+			memcpy(pool->labels + pool->labelsSize, entries[lo].key + depth, length);
+			pool->labelsSize += length;
+			tasks[top + m - 1 - (kids - pool->nodes[task.idx].kids)] =
+				(Task){kids, lo, lo + count[b], depth + length};
+			kids++;
+			lo += count[b];
+		}
+
+		// Pierwsze dziecko trafia na szczyt stosu.
+		top += m;
+	}
+
+	free(tasks);
+	free(buffer);
+
+	if (!ok) {
+		freeSubtree(pool, root);
+		pool->nodes[root].value = 0;
+	}
+
+	return ok;
+}
+
+/** @brief Usuwa dziecko węzła.
+* Usuwa dziecko węzła o indeksie @p idx wraz z całym jego poddrzewem.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła.
+* @param[in] c - symbol krawędzi prowadzącej do dziecka.
+*/
+static void removeChild(NodePool *pool, NodeIdx idx, char c) {
+	NodeIdx child = getChild(pool, idx, c);
+
+	freeSubtree(pool, child);
+	pool->labelsGarbage += pool->nodes[child].length;
+
+	uint16_t mask = pool->nodes[idx].mask;
+	uint16_t bit = 1u << (c - '0');
+	uint32_t n = __builtin_popcount(mask);
+	uint32_t rank = __builtin_popcount(mask & (bit - 1));
+	NodeIdx old = pool->nodes[idx].kids;
+	NodeIdx kids = NO_NODE;
+
+	if (n > 1) {
+		kids = allocBlock(pool, n - 1);
+
+		// Gdy brakuje pamięci na mniejszy blok, zostawiamy stary blok.
+		if (kids == NO_NODE) {
+			Node *nodes = pool->nodes;
+			memmove(nodes + old + rank, nodes + old + rank + 1,
+					sizeof(Node) * (n - rank - 1));
+			nodes[old + n - 1].length = 0;
+			nodes[old + n - 1].value = 0;
+			nodes[idx].mask = mask & ~bit;
+			return;
+		}
+
+		Node *nodes = pool->nodes;
+		memcpy(nodes + kids, nodes + old, sizeof(Node) * rank);
+		memcpy(nodes + kids + rank, nodes + old + rank + 1,
+			   sizeof(Node) * (n - rank - 1));
+	}
+
+	freeBlock(pool, old, n);
+	pool->nodes[idx].mask = mask & ~bit;
+	pool->nodes[idx].kids = kids;
+}
+
+/** @brief Dzieli krawędź.
+* Wstawia nowy węzeł bez wartości w miejsce pierwszych @p j symboli
+* etykiety krawędzi prowadzącej do węzła @p idx. Pod indeksem @p idx
+* znajduje się następnie nowy węzeł, a dotychczasowy węzeł staje się jego
+* jedynym dzieckiem.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła, do którego prowadzi dzielona krawędź.
+* @param[in] j - długość etykiety krawędzi prowadzącej do nowego węzła,
+*                mniejsza od długości dzielonej etykiety.
+* @return Wartość @p true, jeśli udało się podzielić krawędź.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool splitEdge(NodePool *pool, NodeIdx idx, uint32_t j) {
+	NodeIdx kid = allocBlock(pool, 1);
+
+	if (kid == NO_NODE)
+		return false;
+
+	Node *upper = pool->nodes + idx;
+	Node *lower = pool->nodes + kid;
+	char c = pool->labels[upper->label + j];
+
+	*lower = *upper;
+	lower->label = upper->label + j + 1;
+	lower->length = upper->length - j - 1;
+	upper->mask = 1u << (c - '0');
+	upper->kids = kid;
+	upper->value = 0;
+	upper->length = j;
+
+	return true;
+}
+
+/** @brief Scala krawędzie.
+* Jeśli węzeł @p idx nie ma wartości i ma jedno dziecko, do którego nie
+* prowadzi krawędź etykietowana separatorem, to zastępuje go tym dzieckiem,
+* łącząc etykiety obu krawędzi. Korzenie drzew nie są scalane.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła.
+* @param[in] root - indeks korzenia drzewa.
+*/
+static void mergeEdge(NodePool *pool, NodeIdx idx, NodeIdx root) {
+	Node *node = pool->nodes + idx;
+
+	if (idx == root || node->value != 0 || __builtin_popcount(node->mask) != 1)
+		return;
+
+	int c = __builtin_ctz(node->mask);
+	Node *child = pool->nodes + node->kids;
+	uint32_t length = node->length + 1 + child->length;
+
+	if (c == SEPARATOR - '0' || length > MAX_LABEL || !reserveLabels(pool, length))
+		return;
+
+	node = pool->nodes + idx;
+	child = pool->nodes + node->kids;
+	char *label = pool->labels + pool->labelsSize;
+	memcpy(label, pool->labels + node->label, node->length);
+	label[node->length] = '0' + c;
+	memcpy(label + node->length + 1, pool->labels + child->label, child->length);
+
+	NodeIdx kid = node->kids;
+	pool->labelsGarbage += node->length + child->length;
+	node->mask = child->mask;
+	node->kids = child->kids;
+	node->value = child->value;
+	node->length = length;
+	node->label = pool->labelsSize;
+	pool->labelsSize += length;
+
+	// Dziecko dzielone z innymi drzewami pozostaje w puli.
+	if (blockRefs(pool, kid) > 1) {
+		pool->refs[kid]--;
+
+		if (node->mask != 0)
+			pool->refs[node->kids]++;
+	}
+	else {
+		freeBlock(pool, kid, 1);
+	}
+}
+
+NodeIdx findKey(NodePool const *pool, NodeIdx idx, char const *key, size_t len) {
+	size_t i = 0;
+
+	while (i < len) {
+		idx = getChild(pool, idx, key[i]);
+
+		if (idx == NO_NODE)
+			return NO_NODE;
+
+		uint16_t length = pool->nodes[idx].length;
+
+		if (len - i - 1 < length
+			|| memcmp(getLabel(pool, idx), key + i + 1, length) != 0)
+			return NO_NODE;
+
+		i += 1 + length;
+	}
+
+	return idx;
+}
+
+NodeIdx locateKey(NodePool const *pool, NodeIdx idx, char const *key, size_t len,
+				  size_t *depth) {
+	size_t i = 0;
+
+	while (i < len) {
+		idx = getChild(pool, idx, key[i]);
+
+		if (idx == NO_NODE)
+			return NO_NODE;
+
+		uint16_t length = pool->nodes[idx].length;
+		size_t n = len - i - 1 < length ? len - i - 1 : length;
+
+		if (memcmp(getLabel(pool, idx), key + i + 1, n) != 0)
+			return NO_NODE;
+
+		i += 1 + length;
+	}
+
+	*depth = i;
+
+	return idx;
+}
+
+/** @brief Dokleja ścieżkę klucza.
+* Tworzy ścieżkę nowych węzłów od węzła @p idx, odpowiadającą kluczowi
+* @p key. Węzeł nie może mieć dziecka o symbolu @p key[0].
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła.
+* @param[in] key - wskaźnik na ciąg symboli.
+* @param[in] len - długość klucza.
+* @return Indeks ostatniego węzła ścieżki lub @p NO_NODE, gdy nie udało się
+*         zaalokować pamięci.
+*/
+static NodeIdx appendPath(NodePool *pool, NodeIdx idx, char const *key, size_t len) {
+	while (len > 0) {
+		idx = addChild(pool, idx, key[0]);
+
+		if (idx == NO_NODE)
+			return NO_NODE;
+
+		char const *end = memchr(key + 1, SEPARATOR, len - 1);
+		size_t length = end == NULL ? len - 1 : (size_t)(end - key - 1);
+
+		if (length > MAX_LABEL)
+			length = MAX_LABEL;
+
+		if (!reserveLabels(pool, length))
+			return NO_NODE;
+
+		memcpy(pool->labels + pool->labelsSize, key + 1, length);
+		pool->nodes[idx].label = pool->labelsSize;
+		pool->nodes[idx].length = length;
+		pool->labelsSize += length;
+		key += 1 + length;
+		len -= 1 + length;
+	}
+
+	return idx;
+}
+
+NodeIdx insertKey(NodePool *pool, NodeIdx idx, char const *key, size_t len) {
+	size_t i = 0;
+
+	while (i < len) {
+		if (!ownKids(pool, idx))
+			return NO_NODE;
+
+		NodeIdx child = getChild(pool, idx, key[i]);
+
+		if (child == NO_NODE)
+			return appendPath(pool, idx, key + i, len - i);
+
+		uint16_t length = pool->nodes[child].length;
+		char const *label = getLabel(pool, child);
+		uint32_t j = 0;
+
+		while (j < length && i + 1 + j < len && label[j] == key[i + 1 + j])
+			j++;
+
+		if (j < length && !splitEdge(pool, child, j))
+			return NO_NODE;
+
+		i += 1 + j;
+		idx = child;
+	}
+
+	return idx;
+}
+
+/** @brief Kopiuje dzielone bloki ścieżki klucza.
+* Zapewnia wyłączność bloków dzieci węzłów na ścieżce klucza @p key,
+* kończąc na pierwszej niepasującej krawędzi.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła, od którego zaczynamy.
+* @param[in] key - wskaźnik na ciąg symboli.
+* @param[in] len - długość klucza.
+* @return Wartość @p true, jeśli bloki na ścieżce należą tylko do niej.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool ownPath(NodePool *pool, NodeIdx idx, char const *key, size_t len) {
+	size_t i = 0;
+
+	while (i < len) {
+		if (!ownKids(pool, idx))
+			return false;
+
+		idx = getChild(pool, idx, key[i]);
+
+		if (idx == NO_NODE)
+			return true;
+
+		uint16_t length = pool->nodes[idx].length;
+		size_t n = len - i - 1 < length ? len - i - 1 : length;
+
+		if (memcmp(getLabel(pool, idx), key + i + 1, n) != 0)
+			return true;
+
+		i += 1 + length;
+	}
+
+	return ownKids(pool, idx);
+}
+
+bool eraseKey(NodePool *pool, NodeIdx root, char const *key, size_t len,
+			  bool subtree) {
+	if (pool->refs != NULL && !ownPath(pool, root, key, len))
+		return false;
+
+	// Ostatni węzeł ścieżki, który musi pozostać w drzewie, i symbol
+	// krawędzi, od której zaczyna się zbędna część ścieżki.
+	NodeIdx keep = root;
+	char keepSymbol = key[0];
+	NodeIdx idx = root;
+	size_t i = 0;
+
+	while (i < len) {
+		Node const *node = pool->nodes + idx;
+
+		if (idx == root || node->value != 0 || __builtin_popcount(node->mask) > 1) {
+			keep = idx;
+			keepSymbol = key[i];
+		}
+
+		idx = getChild(pool, idx, key[i]);
+
+		if (idx == NO_NODE)
+			return true;
+
+		uint16_t length = pool->nodes[idx].length;
+		size_t n = len - i - 1 < length ? len - i - 1 : length;
+
+		if ((!subtree && n < length)
+			|| memcmp(getLabel(pool, idx), key + i + 1, n) != 0)
+			return true;
+
+		i += 1 + length;
+	}
+
+	if (!subtree && pool->nodes[idx].mask != 0) {
+		pool->nodes[idx].value = 0;
+		mergeEdge(pool, idx, root);
+	}
+	else {
+		removeChild(pool, keep, keepSymbol);
+		mergeEdge(pool, keep, root);
+	}
+
+	compactLabels(pool);
+
+	return true;
+}
+
+bool detachKey(NodePool *pool, NodeIdx root, char const *key, size_t len,
+			   Node *detached) {
+	if (pool->refs != NULL && !ownPath(pool, root, key, len))
+		return false;
+
+	size_t depth;
+	NodeIdx idx = locateKey(pool, root, key, len, &depth);
+
+	if (idx == NO_NODE) {
+		detached->mask = 0;
+		detached->value = 0;
+		return true;
+	}
+
+	// Po odłączeniu dzieci usuwana część ścieżki jest łańcuchem węzłów
+	// o co najwyżej jednym dziecku.
+	*detached = pool->nodes[idx];
+	pool->nodes[idx].mask = 0;
+	pool->nodes[idx].kids = NO_NODE;
+
+	return eraseKey(pool, root, key, len, true);
+}
+
+uint32_t newNumber(NodePool *pool, char const *num, size_t len) {
+	if (len >= UINT32_MAX - NUMBER_HEADER - pool->charsSize)
+		return 0;
+
+	size_t total = NUMBER_HEADER + len + 1;
+
+	if (pool->charsCapacity - pool->charsSize < total) {
+		uint64_t capacity = (uint64_t)pool->charsCapacity * 2;
+
+		while (capacity - pool->charsSize < total)
+			capacity *= 2;
+
+		if (capacity > UINT32_MAX)
+			capacity = UINT32_MAX;
+
+		char *chars = (char*)resizeArray(pool, pool->chars, pool->charsSize,
+										 sizeof(char) * capacity);
+
+		if (chars == NULL)
+			return 0;
+
+		pool->chars = chars;
+		pool->charsCapacity = capacity;
+	}
+
+	uint32_t length = len;
+	uint32_t value = pool->charsSize + NUMBER_HEADER;
+	memcpy(pool->chars + pool->charsSize, &length, NUMBER_HEADER);
+	memcpy(pool->chars + value, num, len);
+	pool->chars[value + len] = '\0';
+	pool->charsSize += total;
+
+	return value;
+}
+
+void freeNumber(NodePool *pool, uint32_t value) {
+	pool->garbage += NUMBER_HEADER + numberSize(pool, value) + 1;
+}
+
+void compactNumbers(NodePool *pool) {
+	if (pool->garbage < MIN_GARBAGE || pool->garbage < pool->charsSize / 2)
+		return;
+
+	// Numery węzłów skopiowanych z bloków dzielonych są przepisywane osobno,
+	// więc rozmiar nowej tablicy wyznaczamy dokładnie.
+	uint64_t capacity = PRESENT + 1;
+	Node *nodes = pool->nodes;
+
+	for (NodeIdx i = 1; i < pool->size; i++)
+		if (nodes[i].value > PRESENT)
+			capacity += NUMBER_HEADER + numberSize(pool, nodes[i].value) + 1;
+
+	if (capacity > UINT32_MAX)
+		return;
+
+	if (capacity < INITIAL_CHARS)
+		capacity = INITIAL_CHARS;
+
+	char *chars = (char*)malloc(sizeof(char) * capacity);
+
+	if (chars == NULL)
+		return;
+
+	uint32_t size = PRESENT + 1;
+
+	for (NodeIdx i = 1; i < pool->size; i++) {
+		if (nodes[i].value > PRESENT) {
+			uint32_t value = nodes[i].value;
+			size_t len = NUMBER_HEADER + numberSize(pool, value) + 1;
+			memcpy(chars + size, pool->chars + value - NUMBER_HEADER, len);
+			nodes[i].value = size + NUMBER_HEADER;
+			size += len;
+		}
+	}
+
+	freeArray(pool, pool->chars);
+	pool->chars = chars;
+	pool->charsSize = size;
+	pool->charsCapacity = capacity;
+	pool->garbage = 0;
+}
+
+/** @brief Kopiuje węzeł do upakowanej puli.
+* Przepisuje etykietę i numer węzła @p idx do puli @p packed. Pole @p kids
+* kopii wskazuje do czasu przetworzenia kopii na blok dzieci w puli @p pool.
+* @param[in] pool - wskaźnik na pulę źródłową.
+* @param[in] idx - indeks kopiowanego węzła.
+* @param[in, out] packed - wskaźnik na upakowaną pulę.
+* @param[in] to - indeks kopii w upakowanej puli.
+* @return Wartość @p true, jeśli udało się skopiować węzeł.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool packNode(NodePool const *pool, NodeIdx idx, NodePool *packed,
+					 NodeIdx to) {
+	Node node = pool->nodes[idx];
+
+	if (!reserveLabels(packed, node.length))
+		return false;
+
+	memcpy(packed->labels + packed->labelsSize, getLabel(pool, idx), node.length);
+	node.label = packed->labelsSize;
+	packed->labelsSize += node.length;
+
+	if (node.value > PRESENT) {
+		node.value = newNumber(packed, getNumber(pool, node.value),
+							   numberSize(pool, node.value));
+
+		if (node.value == 0)
+			return false;
+	}
+
+	packed->nodes[to] = node;
+
+	return true;
+}
+
+/** @brief Upakowuje drzewa.
+* Kopiuje drzewa o korzeniach @p roots do nowej puli, w której węzły leżą
+* w kolejności przeszukiwania wszerz, a tablice znaków nie zawierają
+* zwolnionych fragmentów. Korzenie kopii mają indeksy od 1.
+* @param[in] pool - wskaźnik na pulę źródłową.
+* @param[in] roots - indeksy korzeni kopiowanych drzew.
+* @param[out] packed - wskaźnik na inicjowaną upakowaną pulę.
+* @return Wartość @p true, jeśli udało się upakować drzewa.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool packTrees(NodePool const *pool, NodeIdx const roots[SNAPSHOT_TREES],
+					  NodePool *packed) {
+	if (!initPool(packed))
+		return false;
+
+	for (int i = 0; i < SNAPSHOT_TREES; i++) {
+		NodeIdx idx = allocBlock(packed, 1);
+
+		if (idx == NO_NODE || !packNode(pool, roots[i], packed, idx)) {
+			clearPool(packed);
+			return false;
+		}
+	}
+
+	// Kolejne węzły upakowanej puli są kopiami dzieci węzłów wcześniejszych.
+	for (NodeIdx i = 1; i < packed->size; i++) {
+		uint32_t n = __builtin_popcount(packed->nodes[i].mask);
+
+		if (n == 0)
+			continue;
+
+		NodeIdx from = packed->nodes[i].kids;
+		NodeIdx kids = allocBlock(packed, n);
+
+		if (kids == NO_NODE) {
+			clearPool(packed);
+			return false;
+		}
+
+		for (uint32_t j = 0; j < n; j++) {
+			if (!packNode(pool, from + j, packed, kids + j)) {
+				clearPool(packed);
+				return false;
+			}
+		}
+
+		packed->nodes[i].kids = kids;
+	}
+
+	// Nieużywane elementy zapisujemy jako zera.
+	memset(packed->nodes, 0, sizeof(Node));
+	memset(packed->chars, 0, PRESENT + 1);
+
+	return true;
+}
+
+bool copyTrees(NodePool const *pool, NodeIdx roots[SNAPSHOT_TREES], NodePool *copy) {
+	if (!packTrees(pool, roots, copy))
+		return false;
+
+	for (int i = 0; i < SNAPSHOT_TREES; i++)
+		roots[i] = 1 + i;
+
+	return true;
+}
+
+bool saveTrees(NodePool const *pool, NodeIdx const roots[SNAPSHOT_TREES],
+			   uint64_t const params[SNAPSHOT_PARAMS], char const *path) {
+	NodePool packed;
+
+	if (!packTrees(pool, roots, &packed))
+		return false;
+
+	Snapshot header;
+	memset(&header, 0, sizeof(Snapshot));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.nodeSize = sizeof(Node);
+	header.size = packed.size;
+	header.labelsSize = packed.labelsSize;
+	header.charsSize = packed.charsSize;
+
+	for (int i = 0; i < SNAPSHOT_TREES; i++)
+		header.roots[i] = 1 + i;
+
+	for (int i = 0; i < SNAPSHOT_PARAMS; i++)
+		header.params[i] = params[i];
+
+	size_t len = strlen(path);
+	char *tmp = (char*)malloc(sizeof(char) * (len + 5));
+
+	if (tmp == NULL) {
+		clearPool(&packed);
+		return false;
+	}
+
+	memcpy(tmp, path, len);
+	memcpy(tmp + len, ".tmp", 5);
+
+	FILE *file = fopen(tmp, "wb");
+	bool ok = file != NULL
+			  && fwrite(&header, sizeof(Snapshot), 1, file) == 1
+			  && fwrite(packed.nodes, sizeof(Node), packed.size, file) == packed.size
+			  && fwrite(packed.labels, sizeof(char), packed.labelsSize, file)
+				 == packed.labelsSize
+			  && fwrite(packed.chars, sizeof(char), packed.charsSize, file)
+				 == packed.charsSize;
+
+	if (file != NULL && fclose(file) != 0)
+		ok = false;
+
+	if (ok)
+		ok = rename(tmp, path) == 0;
+	else if (file != NULL)
+		remove(tmp);
+
+	free(tmp);
+	clearPool(&packed);
+
+	return ok;
+}
+
+/** @brief Sprawdza, czy znaki są cyframi.
+* @param[in] str - wskaźnik na sprawdzane znaki.
+* @param[in] n - liczba znaków.
+* @return Wartość @p true, jeśli wszystkie znaki są cyframi.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+static bool validDigits(char const *str, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		if ((unsigned char)(str[i] - '0') >= ALPHABET_SIZE)
+			return false;
+
+	return true;
+}
+
+/** @brief Sprawdza wartość węzła wczytanego z pliku.
+* @param[in] chars - wskaźnik na tablicę numerów z pliku.
+* @param[in] charsSize - liczba znaków tablicy @p chars.
+* @param[in] value - sprawdzana wartość.
+* @return Wartość @p true, jeśli wartość jest zerem, znacznikiem
+*         @p PRESENT albo wskazuje niepusty numer zakończony znakiem '\0',
+*         który w całości mieści się w tablicy.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+static bool validValue(char const *chars, uint32_t charsSize, uint32_t value) {
+	if (value == 0 || value == PRESENT)
+		return true;
+
+	if (value < NUMBER_HEADER || value >= charsSize)
+		return false;
+
+	uint32_t length;
+	memcpy(&length, chars + value - NUMBER_HEADER, sizeof(length));
+
+	return length > 0 && length < charsSize - value
+		   && chars[value + length] == '\0' && validDigits(chars + value, length);
+}
+
+/** @brief Sprawdza tablice wczytanego pliku.
+* Sprawdza w jednym przejściu, że węzły tworzą drzewa ułożone w kolejności
+* przeszukiwania wszerz, tak jak zapisuje je funkcja @ref saveTrees: każdy
+* blok dzieci leży bezpośrednio za blokami dzieci wcześniejszych węzłów.
+* Dzięki temu indeksy dzieci nie wychodzą poza tablicę, a drzewa nie mają
+* cykli ani wspólnych bloków. Sprawdza też, że etykiety mieszczą się
+* w tablicy etykiet i składają się z cyfr, a wartości węzłów są poprawne.
+* @param[in] header - wskaźnik na nagłówek pliku.
+* @param[in] nodes - wskaźnik na tablicę węzłów z pliku.
+* @param[in] labels - wskaźnik na tablicę etykiet z pliku.
+* @param[in] chars - wskaźnik na tablicę numerów z pliku.
+* @return Wartość @p true, jeśli tablice są poprawne.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+static bool validSnapshot(Snapshot const *header, Node const *nodes,
+						  char const *labels, char const *chars) {
+	for (int i = 0; i < SNAPSHOT_TREES; i++) {
+		Node const *root = nodes + 1 + i;
+
+		if (header->roots[i] != (NodeIdx)(1 + i) || root->length != 0
+			|| root->value != 0)
+			return false;
+	}
+
+	uint64_t next = 1 + SNAPSHOT_TREES;
+
+	for (NodeIdx i = 1; i < header->size; i++) {
+		Node const *node = nodes + i;
+
+		// Węzeł spoza dotychczasowych bloków nie należy do żadnego drzewa.
+		if (i >= next || node->mask >= 1u << SYMBOLS
+			|| (uint64_t)node->label + node->length > header->labelsSize
+			|| !validDigits(labels + node->label, node->length)
+			|| !validValue(chars, header->charsSize, node->value))
+			return false;
+
+		if (node->mask != 0) {
+			if (node->kids != next)
+				return false;
+
+			next += __builtin_popcount(node->mask);
+		}
+	}
+
+	return next == header->size;
+}
+
+bool loadTrees(NodePool *pool, NodeIdx roots[SNAPSHOT_TREES],
+			   uint64_t params[SNAPSHOT_PARAMS], char const *path) {
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Snapshot)) {
+		close(fd);
+		return false;
+	}
+
+	size_t mappingSize = st.st_size;
+
+	// Odwzorowanie prywatne: zapisy kopiują zmieniane strony, nie plik.
+	void *mapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE,
+						 MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+		return false;
+
+	Snapshot const *header = (Snapshot const*)mapping;
+	uint64_t expected = sizeof(Snapshot) + (uint64_t)header->size * sizeof(Node)
+						+ header->labelsSize + header->charsSize;
+	bool ok = memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0
+			  && header->version == SNAPSHOT_VERSION
+			  && header->nodeSize == sizeof(Node)
+			  && header->size > SNAPSHOT_TREES
+			  && header->charsSize > PRESENT
+			  && expected == mappingSize;
+
+	char *data = (char*)mapping + sizeof(Snapshot);
+	char *labels = data + sizeof(Node) * header->size;
+
+	// Plik mógł zostać uszkodzony lub podmieniony, więc przed użyciem
+	// sprawdzamy wszystkie odwołania zapisane w tablicach.
+	if (!ok || !validSnapshot(header, (Node const*)data, labels,
+							  labels + header->labelsSize)) {
+		munmap(mapping, mappingSize);
+		return false;
+	}
+
+	pool->nodes = (Node*)data;
+	pool->size = header->size;
+	pool->capacity = header->size;
+	pool->labels = labels;
+	pool->labelsSize = header->labelsSize;
+	pool->labelsCapacity = header->labelsSize;
+	pool->labelsGarbage = 0;
+	pool->chars = pool->labels + header->labelsSize;
+	pool->charsSize = header->charsSize;
+	pool->charsCapacity = header->charsSize;
+	pool->garbage = 0;
+	pool->refs = NULL;
+	pool->users = 1;
+	pool->released = NULL;
+	pool->releasedSize = 0;
+	pool->releasedCapacity = 0;
+	pool->mapping = mapping;
+	pool->mappingSize = mappingSize;
+
+	for (int i = 0; i <= SYMBOLS; i++)
+		pool->freeBlocks[i] = NO_NODE;
+
+	for (int i = 0; i < SNAPSHOT_TREES; i++)
+		roots[i] = header->roots[i];
+
+	for (int i = 0; i < SNAPSHOT_PARAMS; i++)
+		params[i] = header->params[i];
+
+	return true;
+}
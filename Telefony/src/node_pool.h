@@ -0,0 +1,454 @@
+/** @file
+ * Interfejs klasy przechowującej węzły drzew przekierowań w jednej puli.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#ifndef __NODE_POOL_H__
+#define __NODE_POOL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "phone_forward.h"
+
+/// Liczba symboli, którymi mogą być etykietowane krawędzie drzew w puli.
+#define SYMBOLS (ALPHABET_SIZE + 1)
+
+/// Znak oddzielający numer docelowy od źródłowego w kluczach indeksu odwrotnego.
+#define SEPARATOR ('0' + ALPHABET_SIZE)
+
+/// Indeks węzła w puli.
+typedef uint32_t NodeIdx;
+
+/// Indeks oznaczający brak węzła.
+#define NO_NODE 0
+
+/// Maksymalna długość etykiety krawędzi.
+#define MAX_LABEL UINT16_MAX
+
+/// Wartość węzła, która oznacza obecność klucza, a nie numer.
+#define PRESENT 1
+
+/// Liczba bajtów długości zapisanej przed każdym numerem w tablicy znaków.
+#define NUMBER_HEADER sizeof(uint32_t)
+
+/// Liczba drzew zapisywanych razem w jednym pliku.
+#define SNAPSHOT_TREES 2
+
+/// Liczba parametrów zapisywanych razem z drzewami.
+#define SNAPSHOT_PARAMS 2
+
+/** @brief Węzeł drzewa.
+ * Drzewa są skompresowane: krawędź prowadząca do węzła jest etykietowana
+ * symbolem, pod którym węzeł występuje w bloku rodzica, oraz ciągiem
+ * symboli @p label. Węzły mające jedno dziecko i żadnej wartości występują
+ * jedynie przed krawędzią etykietowaną separatorem albo gdy etykieta
+ * osiągnęłaby długość większą niż @p MAX_LABEL. Etykiety nie zawierają
+ * separatora.
+ * Dzieci węzła zajmują w puli spójny blok, w którym są uporządkowane
+ * według symboli. Pozycję dziecka w bloku wyznacza liczba zapalonych bitów
+ * maski o numerach mniejszych od jego symbolu. Blok może być dzielony przez
+ * kilka drzew; modyfikujący drzewo kopiuje wcześniej bloki na ścieżce.
+ */
+typedef struct Node {
+	/// Maska symboli, dla których węzeł ma dzieci.
+	uint16_t mask;
+	/// Długość etykiety krawędzi prowadzącej do węzła.
+	uint16_t length;
+	/// Indeks pierwszego węzła bloku dzieci.
+	NodeIdx kids;
+	/// Wartość przechowywana w węźle lub @p 0, gdy jej brak.
+	uint32_t value;
+	/// Pozycja etykiety krawędzi w tablicy etykiet.
+	uint32_t label;
+} Node;
+
+/** @brief Blok oczekujący na zwolnienie.
+ * Blok usuniętego drzewa, którego węzły i dalsze bloki nie zostały jeszcze
+ * zwolnione.
+ */
+typedef struct Release {
+	/// Indeks pierwszego węzła bloku.
+	NodeIdx kids;
+	/// Liczba węzłów bloku.
+	uint32_t n;
+	/// Czy wartości węzłów są numerami, które należy zwolnić.
+	bool numbers;
+} Release;
+
+/** @brief Pula węzłów i numerów.
+ * Przechowuje węzły wszystkich drzew struktury przekierowań w jednej
+ * tablicy, numery docelowe w jednej tablicy znaków, a etykiety krawędzi
+ * w drugiej. Zwolnione bloki dzieci trafiają na listy wolnych bloków według
+ * rozmiaru, a zwolnione numery i etykiety są odzyskiwane przez okresowe
+ * upakowanie tablic znaków.
+ * Pula może być współdzielona przez kilka struktur przekierowań, których
+ * drzewa mają wspólne poddrzewa. Wtedy dla każdego bloku pamiętana jest
+ * liczba węzłów, których dziećmi są węzły tego bloku.
+ * Usuwane drzewa są zwalniane stopniowo: ich bloki trafiają na stos
+ * bloków oczekujących na zwolnienie, który opróżnia funkcja
+ * @ref reclaimPool, kilka bloków na raz.
+ * Tablice puli wczytanej z pliku leżą w prywatnym odwzorowaniu pliku
+ * w pamięci i są przenoszone na stertę dopiero wtedy, gdy trzeba je
+ * powiększyć lub upakować.
+ */
+typedef struct NodePool {
+	/// Tablica węzłów, węzeł o indeksie @p NO_NODE nie jest używany.
+	Node *nodes;
+	/// Liczba wykorzystanych elementów tablicy węzłów.
+	uint32_t size;
+	/// Rozmiar tablicy węzłów.
+	uint32_t capacity;
+	/// Początki list wolnych bloków dla każdego rozmiaru bloku.
+	NodeIdx freeBlocks[SYMBOLS + 1];
+	/// Tablica znaków przechowująca numery poprzedzone ich długością
+	/// i zakończone znakiem '\0'.
+	char *chars;
+	/// Liczba wykorzystanych elementów tablicy znaków.
+	uint32_t charsSize;
+	/// Rozmiar tablicy znaków.
+	uint32_t charsCapacity;
+	/// Liczba znaków zajmowanych przez zwolnione numery.
+	uint32_t garbage;
+	/// Tablica etykiet krawędzi.
+	char *labels;
+	/// Liczba wykorzystanych elementów tablicy etykiet.
+	uint32_t labelsSize;
+	/// Rozmiar tablicy etykiet.
+	uint32_t labelsCapacity;
+	/// Liczba znaków zajmowanych przez etykiety usuniętych krawędzi.
+	uint32_t labelsGarbage;
+	/// Liczniki odwołań do bloków lub NULL, gdy żaden blok nie jest dzielony.
+	uint32_t *refs;
+	/// Liczba struktur korzystających z puli.
+	uint32_t users;
+	/// Stos bloków oczekujących na zwolnienie.
+	Release *released;
+	/// Liczba bloków na stosie @p released.
+	size_t releasedSize;
+	/// Rozmiar stosu @p released.
+	size_t releasedCapacity;
+	/// Odwzorowanie pliku w pamięci lub NULL, gdy pula nie korzysta z pliku.
+	void *mapping;
+	/// Rozmiar odwzorowania @p mapping.
+	size_t mappingSize;
+} NodePool;
+
+/** @brief Klucz wstawiany do budowanego drzewa.
+ * Opisuje klucz i wartość przekazywane funkcji @ref buildTree.
+ */
+typedef struct Entry {
+	/// Wskaźnik na ciąg symboli klucza.
+	char const *key;
+	/// Długość klucza.
+	size_t len;
+	/// Wartość węzła odpowiadającego kluczowi.
+	uint32_t value;
+} Entry;
+
+/** @brief Inicjuje pulę.
+* @param[in] pool - wskaźnik na inicjowaną pulę.
+* @return Wartość @p true, jeśli udało się zaalokować pamięć.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+bool initPool(NodePool *pool);
+
+/** @brief Zwalnia pulę.
+* Zwalnia całą pamięć zajmowaną przez pulę @p pool.
+* @param[in] pool - wskaźnik na zwalnianą pulę.
+*/
+void clearPool(NodePool *pool);
+
+/** @brief Przygotowuje pulę do współdzielenia drzew.
+* Tworzy liczniki odwołań do bloków, jeśli jeszcze nie istnieją.
+* @param[in] pool - wskaźnik na pulę.
+* @return Wartość @p true, jeśli liczniki istnieją.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+bool sharePool(NodePool *pool);
+
+/** @brief Tworzy korzeń nowego drzewa.
+* @param[in] pool - wskaźnik na pulę.
+* @return Indeks utworzonego węzła lub @p NO_NODE, gdy nie udało się
+*         zaalokować pamięci.
+*/
+NodeIdx newRoot(NodePool *pool);
+
+/** @brief Kopiuje drzewo.
+* Tworzy nowy korzeń, którego poddrzewa są wspólne z drzewem o korzeniu
+* @p root. Pula musi być przygotowana funkcją @ref sharePool.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] root - indeks korzenia kopiowanego drzewa.
+* @return Indeks korzenia kopii lub @p NO_NODE, gdy nie udało się
+*         zaalokować pamięci.
+*/
+NodeIdx cloneRoot(NodePool *pool, NodeIdx root);
+
+/** @brief Usuwa drzewo.
+* Odkłada do zwolnienia korzeń @p root i te bloki drzewa, które nie należą
+* do innych drzew, tak jak funkcja @ref deferBlock.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] root - indeks korzenia usuwanego drzewa.
+* @param[in] numbers - czy wartości węzłów drzewa są numerami, które należy
+*                      zwolnić.
+*/
+void releaseTree(NodePool *pool, NodeIdx root, bool numbers);
+
+/** @brief Odkłada blok do zwolnienia.
+* Odkłada na stos bloków oczekujących na zwolnienie blok, do którego nie
+* prowadzi już żadna krawędź usuwającego go drzewa. Blok i jego poddrzewa
+* zwolni funkcja @ref reclaimPool, a gdy brakuje pamięci na stos, są one
+* zwalniane od razu.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] kids - indeks pierwszego węzła bloku.
+* @param[in] n - liczba węzłów bloku.
+* @param[in] numbers - czy wartości węzłów są numerami, które należy zwolnić.
+*/
+void deferBlock(NodePool *pool, NodeIdx kids, uint32_t n, bool numbers);
+
+/** @brief Zwalnia część bloków oczekujących na zwolnienie.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] budget - przybliżona liczba węzłów, które można zwolnić.
+* @return Wartość @p true, jeśli na zwolnienie oczekują jeszcze bloki.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+bool reclaimPool(NodePool *pool, size_t budget);
+
+/** @brief Kopiuje drzewa do nowej puli.
+* Tworzy pulę niezależną od puli @p pool, zawierającą upakowane kopie drzew
+* o korzeniach @p roots, i zastępuje indeksy korzeni indeksami kopii.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in, out] roots - indeksy korzeni kopiowanych drzew.
+* @param[out] copy - wskaźnik na inicjowaną pulę.
+* @return Wartość @p true, jeśli udało się skopiować drzewa.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+bool copyTrees(NodePool const *pool, NodeIdx roots[SNAPSHOT_TREES], NodePool *copy);
+
+/** @brief Zapisuje drzewa do pliku.
+* Zapisuje drzewa o korzeniach @p roots wraz z parametrami @p params do pliku
+* @p path w postaci niezależnej od położenia w pamięci: nagłówka oraz
+* upakowanych tablic węzłów, etykiet i numerów. Plik jest najpierw
+* zapisywany pod nazwą tymczasową, a następnie podmieniany, więc pule
+* korzystające z jego poprzedniej wersji działają dalej.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] roots - indeksy korzeni zapisywanych drzew.
+* @param[in] params - zapisywane parametry.
+* @param[in] path - ścieżka do pliku.
+* @return Wartość @p true, jeśli udało się zapisać plik.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci lub zapisać
+*         pliku.
+*/
+bool saveTrees(NodePool const *pool, NodeIdx const roots[SNAPSHOT_TREES],
+			   uint64_t const params[SNAPSHOT_PARAMS], char const *path);
+
+/** @brief Wczytuje drzewa z pliku.
+* Inicjuje pulę, której tablice znajdują się w prywatnym odwzorowaniu pliku
+* @p path w pamięci, więc węzły nie są kopiowane, a jedynie sprawdzane
+* jednym przejściem: plik, którego węzły nie tworzą drzew zapisanych
+* funkcją @ref saveTrees lub odwołują się poza tablice, jest odrzucany.
+* Zmiany puli nie są zapisywane w pliku. Plik nie może być modyfikowany
+* w czasie korzystania z puli.
+* @param[out] pool - wskaźnik na inicjowaną pulę.
+* @param[out] roots - indeksy korzeni wczytanych drzew.
+* @param[out] params - wczytane parametry.
+* @param[in] path - ścieżka do pliku.
+* @return Wartość @p true, jeśli udało się wczytać plik.
+*         Wartość @p false, gdy nie udało się otworzyć pliku, ma on
+*         niepoprawny nagłówek lub zawartość albo nie udało się zaalokować
+*         pamięci.
+*/
+bool loadTrees(NodePool *pool, NodeIdx roots[SNAPSHOT_TREES],
+			   uint64_t params[SNAPSHOT_PARAMS], char const *path);
+
+/** @brief Zwraca węzeł o danym indeksie.
+* Wskaźnik jest ważny do najbliższej operacji dodającej węzły do puli.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła.
+* @return Wskaźnik na węzeł.
+*/
+static inline Node * getNode(NodePool const *pool, NodeIdx idx) {
+	return pool->nodes + idx;
+}
+
+/** @brief Znajduje dziecko węzła.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła.
+* @param[in] c - symbol krawędzi prowadzącej do dziecka.
+* @return Indeks dziecka lub @p NO_NODE, gdy węzeł nie ma takiego dziecka.
+*/
+static inline NodeIdx getChild(NodePool const *pool, NodeIdx idx, char c) {
+	Node const *node = pool->nodes + idx;
+	uint32_t bit = 1u << (c - '0');
+
+	if ((node->mask & bit) == 0)
+		return NO_NODE;
+
+	return node->kids + __builtin_popcount(node->mask & (bit - 1));
+}
+
+/** @brief Udostępnia etykietę krawędzi.
+* Wskaźnik jest ważny do najbliższej operacji modyfikującej pulę.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła, do którego prowadzi krawędź.
+* @return Wskaźnik na etykietę.
+*/
+static inline char const * getLabel(NodePool const *pool, NodeIdx idx) {
+	return pool->labels + pool->nodes[idx].label;
+}
+
+/** @brief Sprawdza, czy etykieta krawędzi jest prefixem napisu.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła, do którego prowadzi krawędź.
+* @param[in] str - wskaźnik na napis.
+* @param[in] n - długość napisu @p str.
+* @return Wartość @p true, jeśli etykieta jest prefixem napisu @p str.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+static inline bool matchLabel(NodePool const *pool, NodeIdx idx, char const *str,
+							  size_t n) {
+	uint16_t length = pool->nodes[idx].length;
+
+	return length == 0
+		   || (length <= n && memcmp(getLabel(pool, idx), str, length) == 0);
+}
+
+/** @brief Znajduje węzeł odpowiadający kluczowi.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła, od którego zaczynamy.
+* @param[in] key - wskaźnik na ciąg symboli.
+* @param[in] len - długość klucza.
+* @return Indeks znalezionego węzła lub @p NO_NODE, gdy go nie ma.
+*/
+NodeIdx findKey(NodePool const *pool, NodeIdx idx, char const *key, size_t len);
+
+/** @brief Znajduje poddrzewo kluczy o danym prefixie.
+* Znajduje węzeł, na którego ścieżce od węzła @p idx kończy się klucz
+* @p key. Klucz może kończyć się wewnątrz etykiety krawędzi prowadzącej
+* do znalezionego węzła.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła, od którego zaczynamy.
+* @param[in] key - wskaźnik na ciąg symboli.
+* @param[in] len - długość klucza.
+* @param[out] depth - długość ścieżki od węzła @p idx do znalezionego węzła.
+* @return Indeks znalezionego węzła lub @p NO_NODE, gdy go nie ma.
+*/
+NodeIdx locateKey(NodePool const *pool, NodeIdx idx, char const *key, size_t len,
+				  size_t *depth);
+
+/** @brief Wstawia klucz.
+* Tworzy brakujące węzły na ścieżce klucza @p key, dzieląc w razie potrzeby
+* krawędzie. Bloki na ścieżce dzielone z innymi drzewami są kopiowane, więc
+* znaleziony węzeł można modyfikować.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] idx - indeks węzła, od którego zaczynamy.
+* @param[in] key - wskaźnik na ciąg symboli.
+* @param[in] len - długość klucza.
+* @return Indeks węzła odpowiadającego kluczowi lub @p NO_NODE, gdy nie udało
+*         się zaalokować pamięci.
+*/
+NodeIdx insertKey(NodePool *pool, NodeIdx idx, char const *key, size_t len);
+
+/** @brief Buduje drzewo z listy kluczy.
+* Wstawia klucze @p entries do drzewa o korzeniu @p root, które nie może mieć
+* dzieci. Drzewo powstaje w jednym przejściu w głąb, prowadzonym na
+* własnym stosie zadań, w którym klucze każdego węzła są rozdzielane
+* sortowaniem pozycyjnym według kolejnego symbolu, a każdy blok dzieci jest
+* alokowany raz, na końcu tablicy węzłów.
+* Kolejność kluczy w tablicy @p entries się zmienia. Gdy klucz się powtarza,
+* węzeł dostaje wartość jego ostatniego wystąpienia, a pozostałe wystąpienia
+* dostają długość @p 0.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] root - indeks korzenia drzewa.
+* @param[in, out] entries - tablica niepustych kluczy.
+* @param[in] n - liczba kluczy.
+* @return Wartość @p true, jeśli udało się wstawić klucze.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci; drzewo
+*         pozostaje wtedy puste.
+*/
+bool buildTree(NodePool *pool, NodeIdx root, Entry *entries, size_t n);
+
+/** @brief Usuwa klucz.
+* Usuwa wartość węzła odpowiadającego kluczowi @p key (a gdy @p subtree ma
+* wartość @p true, to poddrzewo wszystkich kluczy o prefixie @p key) oraz
+* zwalnia węzły ścieżki, które przestały być potrzebne, scalając krawędzie.
+* Wartości usuwanych węzłów nie są zwalniane.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] root - indeks korzenia drzewa.
+* @param[in] key - wskaźnik na ciąg symboli.
+* @param[in] len - długość klucza, większa od zera.
+* @param[in] subtree - czy usuwać całe poddrzewo.
+* @return Wartość @p false, gdy nie udało się zaalokować pamięci na kopie
+*         bloków dzielonych z innymi drzewami i klucz nie został usunięty.
+*         Wartość @p true w przeciwnym przypadku.
+*/
+bool eraseKey(NodePool *pool, NodeIdx root, char const *key, size_t len,
+			  bool subtree);
+
+/** @brief Odłącza poddrzewo klucza.
+* Usuwa poddrzewo kluczy o prefixie @p key tak jak funkcja @ref eraseKey,
+* ale nie zwalnia bloku dzieci węzła, na którego ścieżce kończy się klucz,
+* więc działa w czasie zależnym tylko od długości klucza. Blok przechodzi
+* na własność wywołującego, który powinien go przekazać funkcji
+* @ref deferBlock.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] root - indeks korzenia drzewa.
+* @param[in] key - wskaźnik na ciąg symboli.
+* @param[in] len - długość klucza, większa od zera.
+* @param[out] detached - kopia usuniętego węzła, na którego ścieżce kończy
+*                        się klucz, z maską @p 0, gdy takiego węzła nie ma.
+* @return Wartość @p false, gdy nie udało się zaalokować pamięci na kopie
+*         bloków dzielonych z innymi drzewami i klucz nie został usunięty.
+*         Wartość @p true w przeciwnym przypadku.
+*/
+bool detachKey(NodePool *pool, NodeIdx root, char const *key, size_t len,
+			   Node *detached);
+
+/** @brief Zapisuje numer w puli.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] num - wskaźnik na zapisywany numer.
+* @param[in] len - długość numeru.
+* @return Wartość identyfikująca numer w puli lub @p 0, gdy nie udało się
+*         zaalokować pamięci.
+*/
+uint32_t newNumber(NodePool *pool, char const *num, size_t len);
+
+/** @brief Udostępnia numer zapisany w puli.
+* Wskaźnik jest ważny do najbliższej operacji zapisującej numer w puli.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] value - wartość identyfikująca numer.
+* @return Wskaźnik na numer.
+*/
+static inline char const * getNumber(NodePool const *pool, uint32_t value) {
+	return pool->chars + value;
+}
+
+/** @brief Podaje długość numeru zapisanego w puli.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] value - wartość identyfikująca numer.
+* @return Liczba znaków numeru.
+*/
+static inline size_t numberSize(NodePool const *pool, uint32_t value) {
+	uint32_t length;
+	memcpy(&length, pool->chars + value - NUMBER_HEADER, NUMBER_HEADER);
+
+	return length;
+}
+
+/** @brief Zwalnia numer zapisany w puli.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] value - wartość identyfikująca numer.
+*/
+void freeNumber(NodePool *pool, uint32_t value);
+
+/** @brief Upakowuje numery.
+* Jeśli zwolnione numery zajmują więcej niż połowę tablicy znaków, przepisuje
+* do nowej tablicy numery będące wartościami węzłów puli i aktualizuje te
+* wartości. Gdy nie uda się zaalokować pamięci, pula pozostaje bez zmian.
+* @param[in] pool - wskaźnik na pulę.
+*/
+void compactNumbers(NodePool *pool);
+
+#endif /* __NODE_POOL_H__ */
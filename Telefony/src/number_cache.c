@@ -0,0 +1,163 @@
+/** @file
+ * Implementacja klasy przechowującej pamięć podręczną wyników przekierowań
+ * często sprawdzanych numerów.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "number_cache.h"
+
+/// Początkowa wartość skrótu FNV-1a.
+#define FNV_OFFSET 14695981039346656037ull
+
+/// Mnożnik skrótu FNV-1a.
+#define FNV_PRIME 1099511628211ull
+
+/// Mnożnik mieszający bity skrótu.
+#define GOLDEN 0x9E3779B97F4A7C15ull
+
+/** @brief Dopisuje znak do skrótu.
+* @param[in] h - skrót prefixu.
+* @param[in] c - kolejny znak.
+* @return Skrót prefixu przedłużonego o znak @p c.
+*/
+static inline uint64_t extendHash(uint64_t h, char c) {
+	return (h ^ (unsigned char)c) * FNV_PRIME;
+}
+
+/** @brief Wyznacza znacznik czasu prefixu.
+* @param[in] c - wskaźnik na pamięć podręczną.
+* @param[in] h - skrót prefixu.
+* @return Wskaźnik na znacznik czasu ostatniej modyfikacji prefixu.
+*/
+static inline uint64_t * stampOf(NumberCache *c, uint64_t h) {
+	return c->stamps + ((h * GOLDEN) >> (64 - CACHE_STAMP_BITS));
+}
+
+/** @brief Wyznacza zbiór i znacznik numeru.
+* @param[in] c - wskaźnik na pamięć podręczną.
+* @param[in] h - skrót numeru.
+* @param[out] tag - niezerowy znacznik numeru.
+* @return Wskaźnik na zbiór, w którym może znajdować się numer.
+*/
+static CacheSet * locate(NumberCache *c, uint64_t h, uint32_t *tag) {
+	uint64_t m = h * GOLDEN;
+	*tag = (uint32_t)m | 1;
+
+	return c->sets + (m >> 32) % CACHE_SETS;
+}
+
+/** @brief Szuka numeru w zbiorze.
+* @param[in] set - wskaźnik na zbiór.
+* @param[in] tag - znacznik numeru.
+* @param[in] num - wskaźnik na numer.
+* @param[in] n - długość numeru.
+* @return Pozycja numeru w zbiorze lub @p CACHE_WAYS, gdy go w nim nie ma.
+*/
+static int findWay(CacheSet const *set, uint32_t tag, char const *num, size_t n) {
+	for (int i = 0; i < CACHE_WAYS; i++) {
+		CacheEntry const *e = set->entries + i;
+
+		if (set->tags[i] == tag && e->length == n && memcmp(e->number, num, n) == 0)
+			return i;
+	}
+
+	return CACHE_WAYS;
+}
+
+NumberCache * newNumberCache(void) {
+	return (NumberCache*)calloc(1, sizeof(NumberCache));
+}
+
+void clearNumberCache(NumberCache *c) {
+	free(c);
+}
+
+void invalidateCached(NumberCache *c, char const *prefix, size_t n) {
+	// Dłuższym prefixem nie zaczyna się żaden zapisany numer.
+	if (n > CACHE_NUMBER)
+		return;
+
+	uint64_t h = FNV_OFFSET;
+
+	for (size_t i = 0; i < n; i++)
+		h = extendHash(h, prefix[i]);
+
+	*stampOf(c, h) = ++c->clock;
+}
+
+CacheEntry const * findCached(NumberCache *c, char const *num, size_t n) {
+	if (n > CACHE_NUMBER)
+		return NULL;
+
+	uint64_t prefixes[CACHE_NUMBER];
+	uint64_t h = FNV_OFFSET;
+
+	for (size_t i = 0; i < n; i++) {
+		h = extendHash(h, num[i]);
+		prefixes[i] = h;
+	}
+
+	uint32_t tag;
+	CacheSet *set = locate(c, h, &tag);
+	int way = findWay(set, tag, num, n);
+
+	if (way == CACHE_WAYS)
+		return NULL;
+
+	CacheEntry const *e = set->entries + way;
+
+	for (size_t i = 0; i < n; i++) {
+		if (*stampOf(c, prefixes[i]) > e->time) {
+			set->tags[way] = 0;
+			return NULL;
+		}
+	}
+
+	set->referenced |= 1u << way;
+
+	return e;
+}
+
+void storeCached(NumberCache *c, char const *num, size_t n, size_t len,
+				 char const *num2, size_t n2) {
+	if (n > CACHE_NUMBER || n2 + n - len > CACHE_NUMBER)
+		return;
+
+	uint64_t h = FNV_OFFSET;
+
+	for (size_t i = 0; i < n; i++)
+		h = extendHash(h, num[i]);
+
+	uint32_t tag;
+	CacheSet *set = locate(c, h, &tag);
+	int way = findWay(set, tag, num, n);
+
+	for (int i = 0; way == CACHE_WAYS && i < CACHE_WAYS; i++)
+		if (set->tags[i] == 0)
+			way = i;
+
+	// Wskazówka zegara daje drugą szansę pozycjom odczytanym od jej
+	// poprzedniego przejścia.
+	if (way == CACHE_WAYS) {
+		while ((set->referenced & (1u << set->hand)) != 0) {
+			set->referenced &= ~(1u << set->hand);
+			set->hand = (set->hand + 1) % CACHE_WAYS;
+		}
+
+		way = set->hand;
+		set->hand = (set->hand + 1) % CACHE_WAYS;
+	}
+
+	CacheEntry *e = set->entries + way;
+	set->tags[way] = tag;
+	set->referenced &= ~(1u << way);
+	e->time = c->clock;
+	e->length = n;
+	e->resultLength = n2 + n - len;
+	memcpy(e->number, num, n);
+	memcpy(e->result, num2, n2);
+	memcpy(e->result + n2, num + len, n - len);
+}
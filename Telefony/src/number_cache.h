@@ -0,0 +1,118 @@
+/** @file
+ * Interfejs klasy przechowującej pamięć podręczną wyników przekierowań
+ * często sprawdzanych numerów.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#ifndef __NUMBER_CACHE_H__
+#define __NUMBER_CACHE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Maksymalna długość numeru i wyniku przechowywanych w pamięci podręcznej.
+#define CACHE_NUMBER 24
+
+/// Liczba pozycji w jednym zbiorze pamięci podręcznej.
+#define CACHE_WAYS 8
+
+/// Liczba zbiorów pamięci podręcznej.
+#define CACHE_SETS 128
+
+/// Liczba bitów skrótu prefixu wybierających jego znacznik czasu.
+#define CACHE_STAMP_BITS 10
+
+/** @brief Pozycja pamięci podręcznej.
+* Przechowuje numer i wynik jego przekierowania bez kończących je znaków
+* '\0'.
+*/
+typedef struct CacheEntry {
+	/// Chwila zapisania wyniku.
+	uint64_t time;
+	/// Długość numeru.
+	uint8_t length;
+	/// Długość wyniku.
+	uint8_t resultLength;
+	/// Numer.
+	char number[CACHE_NUMBER];
+	/// Wynik przekierowania numeru.
+	char result[CACHE_NUMBER];
+} CacheEntry;
+
+/** @brief Zbiór pozycji pamięci podręcznej.
+* Numer może znajdować się tylko w zbiorze wyznaczonym przez jego skrót.
+* Gdy zbiór jest pełny, pozycję do zastąpienia wybiera algorytm zegarowy
+* (CLOCK): wskazówka omija pozycje odczytane od czasu jej ostatniego
+* przejścia, kasując ich bity odczytu.
+*/
+typedef struct CacheSet {
+	/// Znaczniki numerów na pozycjach lub @p 0 dla wolnych pozycji.
+	uint32_t tags[CACHE_WAYS];
+	/// Bity odczytu pozycji.
+	uint8_t referenced;
+	/// Pozycja wskazywana przez wskazówkę zegara.
+	uint8_t hand;
+	/// Pozycje zbioru.
+	CacheEntry entries[CACHE_WAYS];
+} CacheSet;
+
+/** @brief Pamięć podręczna wyników przekierowań.
+* Zamiast wyszukiwać pozycje zależne od zmienianego prefixu, każdy prefix
+* ma znacznik czasu swojej ostatniej modyfikacji, wybierany skrótem
+* prefixu. Pozycja jest aktualna, jeśli żaden prefix jej numeru nie był
+* modyfikowany po jej zapisaniu, bo tylko takie modyfikacje mogą zmienić
+* wynik przekierowania numeru. Kolizje skrótów powodują jedynie zbędne
+* unieważnienia.
+*/
+typedef struct NumberCache {
+	/// Bieżący czas, zwiększany przy każdej modyfikacji.
+	uint64_t clock;
+	/// Znaczniki czasu ostatnich modyfikacji prefixów.
+	uint64_t stamps[1u << CACHE_STAMP_BITS];
+	/// Zbiory pozycji.
+	CacheSet sets[CACHE_SETS];
+} NumberCache;
+
+/** @brief Tworzy pustą pamięć podręczną.
+* @return Wskaźnik na utworzoną pamięć lub NULL, gdy nie udało się
+*         zaalokować pamięci.
+*/
+NumberCache * newNumberCache(void);
+
+/** @brief Usuwa pamięć podręczną.
+* @param[in] c - wskaźnik na usuwaną pamięć.
+*/
+void clearNumberCache(NumberCache *c);
+
+/** @brief Unieważnia wyniki numerów zaczynających się prefixem.
+* @param[in,out] c - wskaźnik na pamięć podręczną.
+* @param[in] prefix - wskaźnik na zmieniany prefix.
+* @param[in] n - długość prefixu.
+*/
+void invalidateCached(NumberCache *c, char const *prefix, size_t n);
+
+/** @brief Znajduje aktualny wynik przekierowania numeru.
+* @param[in,out] c - wskaźnik na pamięć podręczną.
+* @param[in] num - wskaźnik na numer.
+* @param[in] n - długość numeru.
+* @return Wskaźnik na pozycję z wynikiem, ważny do następnej operacji na
+*         pamięci, lub NULL, gdy nie ma w niej aktualnego wyniku.
+*/
+CacheEntry const * findCached(NumberCache *c, char const *num, size_t n);
+
+/** @brief Zapisuje wynik przekierowania numeru.
+* Wynikiem jest numer @p num, w którym prefix długości @p len zamieniono na
+* numer @p num2. Wyniki zbyt długich numerów nie są zapisywane.
+* @param[in,out] c - wskaźnik na pamięć podręczną.
+* @param[in] num - wskaźnik na numer.
+* @param[in] n - długość numeru.
+* @param[in] len - długość zamienianego prefixu.
+* @param[in] num2 - wskaźnik na numer, na który zamieniany jest prefix.
+* @param[in] n2 - długość numeru @p num2.
+*/
+void storeCached(NumberCache *c, char const *num, size_t n, size_t len,
+				 char const *num2, size_t n2);
+
+#endif /* __NUMBER_CACHE_H__ */
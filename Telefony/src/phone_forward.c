@@ -5,24 +5,86 @@
  * @author Philip Smolenski-Jensen
  */
 
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include "phone_forward.h"
+#include "node_pool.h"
+#include "phone_forward_stats.h"
+#include "stride_index.h"
+#include "number_cache.h"
+#include "reclaimer.h"
+
+/// Liczba numerów, których przekierowania wyznaczane są jednocześnie.
+#define BATCH_WIDTH 16
+
+/// Liczba zapamiętywanych wyników funkcji phfwdNonTrivialCount.
+#define MEMO_SIZE 64
+
+/// Liczba węzłów zwalnianych jednorazowo przez odłożone usuwanie.
+#define RECLAIM_SLICE 256
+
+/** @brief Zapamiętany wynik funkcji phfwdNonTrivialCount.
+* Wynik jest aktualny, dopóki pokolenie struktury przekierowań nie zmieni się.
+*/
+typedef struct Memo {
+	/// Pokolenie struktury, dla którego wyznaczono wynik lub @p 0.
+	uint64_t generation;
+	/// Maska dozwolonych cyfr.
+	uint16_t mask;
+	/// Długość zliczanych numerów.
+	size_t len;
+	/// Wynik.
+	size_t result;
+} Memo;
 
 /** @brief Struktura przechowująca przekierowania numerów telefonów.
- * Przekierowania trzymamy w drzewie prefixowym.
- * Każde przekierowanie zawiera tablicę dzieci, przy czym a jest dzieckiem b
- * gdy pierwszy numer przekierowania w a jest pierwszym numerem
- * przekierowania w b, powiększonym o 1 cyfrę.
+ * Przekierowania trzymamy w drzewie prefixowym, którego węzły znajdują się
+ * w puli @p pool. Węzeł odpowiadający numerowi x przechowuje jako wartość
+ * numer, na który przekierowany jest x. Sam numer x wynika ze ścieżki od
+ * korzenia, więc nie jest zapamiętywany.
+ * Indeks odwrotny jest drugim drzewem w tej samej puli, zawierającym
+ * klucze postaci y SEPARATOR x dla każdego przekierowania x na y. Pozwala on
+ * wyznaczać przekierowania na dany numer bez przeglądania całego drzewa.
+ * Kopie struktury utworzone funkcją phfwdCopy korzystają z tej samej puli
+ * i dzielą niezmienione poddrzewa.
+ * Usunięcie przekierowań odłącza poddrzewo w czasie zależnym od długości
+ * numeru, a ich klucze znikają z indeksu odwrotnego stopniowo, przy
+ * kolejnych modyfikacjach. Do tego czasu operacje przeglądające indeks
+ * odwrotny pomijają klucze przekierowań, których nie ma w drzewie, i liczą
+ * je w @p skipped, a kolejny krok usuwania usuwa co najmniej tyle węzłów.
  */
 struct PhoneForward {
-	/// Tablica dzieci przekierowania. 
-	struct PhoneForward **children;
-	/// Wskaźnik na przekierowywany numer.
-	char *fstNum;
-	/// Wskażnik na numer, na który przekierowany jest numer.
-	char *sndNum;   
+	/// Pula węzłów i numerów obu drzew, wspólna dla kopii struktury.
+	NodePool *pool;
+	/// Korzeń drzewa przekierowań.
+	NodeIdx root;
+	/// Korzeń indeksu odwrotnego.
+	NodeIdx reverse;
+	/// Bufor, w którym budowane są klucze indeksu odwrotnego.
+	char *key;
+	/// Rozmiar bufora @p key.
+	size_t keyCapacity;
+	/// Długość najdłuższego dodanego numeru przekierowywanego.
+	size_t maxSource;
+	/// Długość najdłuższego dodanego numeru docelowego.
+	size_t maxTarget;
+	/// Pokolenie struktury, zwiększane przy każdej jej modyfikacji.
+	uint64_t generation;
+	/// Zapamiętane wyniki funkcji phfwdNonTrivialCount.
+	Memo memo[MEMO_SIZE];
+	/// Liczniki wywołań operacji na strukturze.
+	Stats stats;
+	/// Wielokrokowy indeks drzewa przekierowań lub NULL, gdy jest wyłączony.
+	StrideIndex *stride;
+	/// Pamięć podręczna wyników przekierowań lub NULL, gdy jest wyłączona.
+	NumberCache *cache;
+	/// Odłączone poddrzewa przekierowań lub NULL, gdy żadnego nie odłączono.
+	Reclaimer *reclaim;
+	/// Liczba nieaktualnych kluczy pominiętych przez odczyty od ostatniego
+	/// kroku usuwania.
+	atomic_size_t skipped;
 };
 
 /** @brief Struktura przechowująca ciąg numerów telefonów.
@@ -47,9 +109,37 @@ struct PhoneForward * phfwdNew(void) {
 	if (pf == NULL)
 		return NULL;
 
-	pf->children = NULL;
-	pf->fstNum = NULL;
-	pf->sndNum = NULL;
+	initStats(&pf->stats);
+	atomic_init(&pf->skipped, 0);
+	pf->stride = NULL;
+	pf->cache = NULL;
+	pf->reclaim = NULL;
+	pf->pool = (NodePool*)malloc(sizeof(NodePool));
+
+	if (pf->pool == NULL || !initPool(pf->pool)) {
+		free(pf->pool);
+		free(pf);
+		return NULL;
+	}
+
+	pf->root = newRoot(pf->pool);
+	pf->reverse = newRoot(pf->pool);
+
+	if (pf->root == NO_NODE || pf->reverse == NO_NODE) {
+		clearPool(pf->pool);
+		free(pf->pool);
+		free(pf);
+		return NULL;
+	}
+
+	pf->key = NULL;
+	pf->keyCapacity = 0;
+	pf->maxSource = 0;
+	pf->maxTarget = 0;
+	pf->generation = 1;
+
+	for (size_t i = 0; i < MEMO_SIZE; i++)
+		pf->memo[i].generation = 0;
 
 	return pf;
 }
@@ -58,21 +148,25 @@ void phfwdDelete(struct PhoneForward *pf) {
 	if (pf == NULL)
 		return;
 
-	if (pf->children != NULL) {
-		for(int i = 0; i < ALPHABET_SIZE; i++) {
-			phfwdDelete(pf->children[i]);
-		}
-		free(pf->children);
-	}
-
-	if (pf->fstNum != NULL)
-		free (pf->fstNum);
+	NodePool *pool = pf->pool;
 
-	if (pf->sndNum != NULL)
-		free (pf->sndNum);	 
+	// Drzewa kopii zwolnią stopniowo pozostałe struktury korzystające z puli.
+	if (--pool->users == 0) {
+		clearReclaimer(pf->reclaim, NULL);
+		clearPool(pool);
+		free(pool);
+	}
+	else {
+		clearReclaimer(pf->reclaim, pool);
+		releaseTree(pool, pf->root, true);
+		releaseTree(pool, pf->reverse, false);
+	}
 
+	clearStats(&pf->stats);
+	clearStrideIndex(pf->stride);
+	clearNumberCache(pf->cache);
+	free(pf->key);
 	free(pf);
-	pf = NULL;
 }
 
 /** @brief Zwraca liczbę znaków numeru.
@@ -80,12 +174,65 @@ void phfwdDelete(struct PhoneForward *pf) {
 * @return Liczba znaków składających się na numer.
 */
 size_t size(char const *num) {
+	return strlen(num);
+}
+
+/** @brief Sprawdza, czy znaki są symbolami numeru.
+* Sprawdza po osiem znaków na raz: bajt x jest symbolem, gdy jego najstarszy
+* bit jest zgaszony, x + 0x50 go zapala (x >= '0'), a x + 0x44 go nie zapala
+* (x < '0' + ALPHABET_SIZE). Dla bajtów mniejszych od 0x80 dodawanie nie
+* przenosi bitów do sąsiednich bajtów. Znaki za napisem nie są czytane.
+* @param[in] num - wskaźnik na napis długości @p n.
+* @param[in] n - liczba znaków, większa od zera.
+* @return Wartość @p true, jeśli napis jest numerem.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+static bool validSymbols(char const *num, size_t n) {
+	uint64_t const ones = 0x0101010101010101ull;
+	uint64_t const high = 0x8080808080808080ull;
 	size_t i = 0;
-	
-	while (num[i] != '\0')
-		i++;
-	
-	return i;
+
+	for (; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+		uint64_t x;
+		memcpy(&x, num + i, sizeof(x));
+		uint64_t above = x + (0x80 - '0') * ones;
+		uint64_t below = x + (0x80 - '0' - ALPHABET_SIZE) * ones;
+
+		if (((above & ~below & ~x) & high) != high)
+			return false;
+	}
+
+	for (; i < n; i++)
+		if (num[i] < '0' || num[i] >= '0' + ALPHABET_SIZE)
+			return false;
+
+	return true;
+}
+
+/** @brief Sprawdza numer podany wraz z długością.
+* @param[in] num - wskaźnik na napis długości @p n lub NULL.
+* @param[in] n - długość napisu.
+* @return Długość numeru lub @p 0, gdy napis nie jest numerem.
+*/
+static size_t spanLength(char const *num, size_t n) {
+	return num != NULL && n > 0 && validSymbols(num, n) ? n : 0;
+}
+
+/** @brief Wyznacza długość numeru.
+* Szuka końca napisu i sprawdza jego znaki w jednym przejściu.
+* @param[in] num - wskaźnik na napis lub NULL.
+* @return Długość numeru lub @p 0, gdy napis nie jest numerem.
+*/
+static size_t numberLength(char const *num) {
+	if (num == NULL)
+		return 0;
+
+	size_t n = 0;
+
+	while ((unsigned char)(num[n] - '0') < ALPHABET_SIZE)
+		n++;
+
+	return num[n] == '\0' ? n : 0;
 }
 
 /** @brief Sprawdza czy napis jest numerem.
@@ -95,220 +242,943 @@ size_t size(char const *num) {
 * 		  Wartość @p false w przeciwnym przypadku.
 */
 bool isNumber(char const *num) {
-	if (strcmp("", num) == 0)
-		return false;
+	return numberLength(num) > 0;
+}
 
-	bool wyn = true;
-	int i = 0;
-	
-	while (num[i] != '\0') {
-		int k = num[i];
-		if (k < '0' || k >= ALPHABET_SIZE + '0')
-			wyn = false;
-		i++;
+/** @brief Rezerwuje bufor kluczy indeksu odwrotnego.
+* Zapewnia, że bufor kluczy pomieści klucz indeksu odwrotnego dowolnego
+* przekierowania, gdy do struktury dodawane jest przekierowanie z numeru
+* długości @p n1 na numer długości @p n2.
+* @param[in] pf - wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] n1 - długość przekierowywanego numeru.
+* @param[in] n2 - długość numeru, na który wykonywane jest przekierowanie.
+* @return Wartość @p true, jeśli bufor ma wystarczający rozmiar.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+bool reserveKey(struct PhoneForward *pf, size_t n1, size_t n2) {
+	size_t maxSource = n1 > pf->maxSource ? n1 : pf->maxSource;
+	size_t maxTarget = n2 > pf->maxTarget ? n2 : pf->maxTarget;
+	size_t capacity = maxTarget + 1 + maxSource;
+
+	if (capacity > pf->keyCapacity) {
+		char *key = (char*)realloc(pf->key, sizeof(char) * capacity);
+
+		if (key == NULL)
+			return false;
+
+		pf->key = key;
+		pf->keyCapacity = capacity;
 	}
-	
-	return wyn;
+
+	pf->maxSource = maxSource;
+	pf->maxTarget = maxTarget;
+
+	return true;
 }
 
-/** @brief Sprawdza czy pierwszy z numerów jest prefixem drugiego.
-* @param[in] num1 - wskaźnik na pierwszy z numerów.
-* @param[in] num2 - wskaźnik na drugi z numerów.
-* return Wartość @p true jeśli @p num1 jest prefixem @p num2.
-* 		 Wartość @p false w przeciwnym przypadku.
+/** @brief Buduje klucz indeksu odwrotnego.
+* Zapisuje w buforze kluczy klucz postaci @p num2 SEPARATOR @p num1. Numer
+* @p num1 zajmuje w buforze miejsce zaczynające się na pozycji
+* @p maxTarget + 1, dzięki czemu klucze przekierowań z numerów o wspólnym
+* prefixie można budować bez przepisywania tego prefixu.
+* @param[in] pf - wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] num1 - wskaźnik na przekierowywany numer lub NULL, gdy jest on
+*                   już zapisany w buforze.
+* @param[in] n1 - długość przekierowywanego numeru.
+* @param[in] num2 - wskaźnik na numer, na który wykonywane jest przekierowanie.
+* @param[in] n2 - długość numeru @p num2.
+* @return Wskaźnik na początek klucza w buforze.
 */
-bool isPrefix (char const *num1, char const *num2) {
-	bool wyn = true;
-	int i = 0;
-	
-	while (num1[i] != '\0') {
-		if (num2[i] == '\0') 
-			return false;
-		
-		if (num2[i] != num1[i])
-			wyn = false;
-		
-		i++;
+char * makeKey(struct PhoneForward *pf, char const *num1, size_t n1,
+			   char const *num2, size_t n2) {
+	char *source = pf->key + pf->maxTarget + 1;
+
+	if (num1 != NULL)
+		memcpy(source, num1, n1);
+
+	source[-1] = SEPARATOR;
+	memcpy(source - 1 - n2, num2, n2);
+
+	return source - 1 - n2;
+}
+
+/** @brief Zapisuje liczbę pominiętych nieaktualnych kluczy.
+* @param[in,out] pf - wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] n - liczba kluczy pominiętych przez odczyt.
+*/
+static void addSkipped(struct PhoneForward *pf, size_t n) {
+	if (n > 0)
+		atomic_fetch_add_explicit(&pf->skipped, n, memory_order_relaxed);
+}
+
+/** @brief Wykonuje część odłożonego usuwania.
+* Usuwa z indeksu odwrotnego klucze przekierowań z odłączonych poddrzew
+* i zwalnia bloki puli oczekujące na zwolnienie. Budżet jest zwiększany
+* o liczbę kluczy pominiętych od poprzedniego kroku, więc usuwanie postępuje
+* co najmniej tak szybko, jak odczyty płacą za nieaktualne klucze.
+* @param[in,out] pf - wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] budget - przybliżona liczba węzłów, które można odwiedzić.
+* @return Wartość @p true, jeśli pozostało odłożone usuwanie.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+static bool reclaimStep(struct PhoneForward *pf, size_t budget) {
+	budget += atomic_exchange_explicit(&pf->skipped, 0, memory_order_relaxed);
+	bool pending = reclaimSlice(pf->reclaim, pf->pool, pf->root, pf->reverse,
+								budget);
+	pending = reclaimPool(pf->pool, budget) || pending;
+	compactNumbers(pf->pool);
+
+	return pending;
+}
+
+struct PhoneForward * phfwdCopy(struct PhoneForward const *pf) {
+	if (pf == NULL)
+		return NULL;
+
+	struct PhoneForward *copy = (struct PhoneForward*)malloc(sizeof(struct PhoneForward));
+
+	if (copy == NULL)
+		return NULL;
+
+	initStats(&copy->stats);
+	atomic_init(&copy->skipped, 0);
+	copy->stride = NULL;
+	copy->cache = NULL;
+	copy->reclaim = NULL;
+
+	NodePool *pool = pf->pool;
+	copy->pool = pool;
+	copy->key = NULL;
+	copy->keyCapacity = 0;
+	copy->maxSource = 0;
+	copy->maxTarget = 0;
+
+	if (!reserveKey(copy, pf->maxSource, pf->maxTarget) || !sharePool(pool)) {
+		free(copy->key);
+		free(copy);
+		return NULL;
 	}
-	
-	return wyn;
+
+	// Kopia sama usuwa klucze poddrzew odłączonych przed skopiowaniem.
+	if (reclaimPending(pf->reclaim)
+		&& (copy->reclaim = copyReclaimer(pf->reclaim, pool)) == NULL) {
+		free(copy->key);
+		free(copy);
+		return NULL;
+	}
+
+	copy->root = cloneRoot(pool, pf->root);
+	copy->reverse = cloneRoot(pool, pf->reverse);
+
+	if (copy->root == NO_NODE || copy->reverse == NO_NODE) {
+		if (copy->root != NO_NODE)
+			releaseTree(pool, copy->root, false);
+
+		if (copy->reverse != NO_NODE)
+			releaseTree(pool, copy->reverse, false);
+
+		clearReclaimer(copy->reclaim, pool);
+		free(copy->key);
+		free(copy);
+		return NULL;
+	}
+
+	pool->users++;
+	copy->generation = pf->generation;
+	memcpy(copy->memo, pf->memo, sizeof(copy->memo));
+
+	return copy;
 }
 
-bool phfwdAdd(struct PhoneForward *pf, char const *num1, char const *num2) {
-	if (!isNumber(num1) || !isNumber(num2))
+/** @brief Usuwa z kopii nieaktualne klucze indeksu odwrotnego.
+* Przegląda poddrzewo indeksu odwrotnego struktury @p pf i usuwa z indeksu
+* odwrotnego jej kopii @p copy klucze y SEPARATOR x, dla których x nie jest
+* przekierowany na y. Poddrzewa odłączone w @p pf nie trafiają do kopii,
+* więc kopia nie mogłaby tych kluczy usunąć później.
+* @param[in,out] copy - wskaźnik na kopię struktury @p pf.
+* @param[in] pf - wskaźnik na kopiowaną strukturę.
+* @param[in] idx - indeks węzła indeksu odwrotnego struktury @p pf.
+* @param[in] depth - długość klucza odpowiadającego węzłowi @p idx.
+* @param[in] target - długość numeru y lub @p 0, gdy klucz nie zawiera
+*                     jeszcze separatora.
+*/
+static void dropStale(struct PhoneForward *copy, struct PhoneForward const *pf,
+					  NodeIdx idx, size_t depth, size_t target) {
+	NodePool const *pool = pf->pool;
+	Node const *node = getNode(pool, idx);
+	char *key = copy->key;
+
+	if (node->value != 0
+		&& !liveKey(pool, pf->root, key + target + 1, depth - target - 1,
+					key, target))
+		eraseKey(copy->pool, copy->reverse, key, depth, false);
+
+	NodeIdx kids = node->kids;
+
+	for (int i = 0; i < SYMBOLS; i++) {
+		if ((node->mask & (1u << i)) != 0) {
+			uint16_t length = getNode(pool, kids)->length;
+			key[depth] = '0' + i;
+			memcpy(key + depth + 1, getLabel(pool, kids), length);
+			dropStale(copy, pf, kids++, depth + 1 + length,
+					  i == ALPHABET_SIZE ? depth : target);
+		}
+	}
+}
+
+struct PhoneForward * phfwdDuplicate(struct PhoneForward const *pf) {
+	if (pf == NULL)
+		return NULL;
+
+	struct PhoneForward *copy = (struct PhoneForward*)malloc(sizeof(struct PhoneForward));
+
+	if (copy == NULL)
+		return NULL;
+
+	initStats(&copy->stats);
+	atomic_init(&copy->skipped, 0);
+	copy->stride = NULL;
+	copy->cache = NULL;
+	copy->reclaim = NULL;
+
+	copy->pool = (NodePool*)malloc(sizeof(NodePool));
+	NodeIdx roots[SNAPSHOT_TREES] = {pf->root, pf->reverse};
+
+	if (copy->pool == NULL || !copyTrees(pf->pool, roots, copy->pool)) {
+		free(copy->pool);
+		free(copy);
+		return NULL;
+	}
+
+	copy->root = roots[0];
+	copy->reverse = roots[1];
+	copy->key = NULL;
+	copy->keyCapacity = 0;
+	copy->maxSource = 0;
+	copy->maxTarget = 0;
+	copy->generation = 1;
+
+	for (size_t i = 0; i < MEMO_SIZE; i++)
+		copy->memo[i].generation = 0;
+
+	if (!reserveKey(copy, pf->maxSource, pf->maxTarget)) {
+		phfwdDelete(copy);
+		return NULL;
+	}
+
+	if (reclaimPending(pf->reclaim))
+		dropStale(copy, pf, pf->reverse, 0, 0);
+
+	return copy;
+}
+
+bool phfwdSave(struct PhoneForward const *pf, char const *path) {
+	if (pf == NULL || path == NULL)
 		return false;
 
-	if (strcmp(num1, num2) == 0)
+	// Nieaktualnych kluczy indeksu odwrotnego nie zapisujemy.
+	if (reclaimPending(pf->reclaim)) {
+		struct PhoneForward *copy = phfwdDuplicate(pf);
+		bool result = phfwdSave(copy, path);
+		phfwdDelete(copy);
+
+		return result;
+	}
+
+	NodeIdx roots[SNAPSHOT_TREES] = {pf->root, pf->reverse};
+	uint64_t params[SNAPSHOT_PARAMS] = {pf->maxSource, pf->maxTarget};
+
+	return saveTrees(pf->pool, roots, params, path);
+}
+
+/// Węzeł czekający na sprawdzenie przez funkcję validTree.
+typedef struct Unchecked {
+	/// Indeks węzła.
+	NodeIdx idx;
+	/// Długość klucza kończącego się przed etykietą węzła.
+	size_t depth;
+	/// Długość numeru y klucza indeksu odwrotnego lub @p 0, gdy klucz nie
+	/// zawiera jeszcze separatora.
+	size_t target;
+} Unchecked;
+
+/** @brief Sprawdza klucze drzewa wczytanego z pliku.
+* Sprawdza, że drzewo przekierowań zawiera jedynie numery nie dłuższe niż
+* @p maxSource przekierowane na numery nie dłuższe niż @p maxTarget, a indeks
+* odwrotny jedynie klucze y SEPARATOR x dla takich numerów. Od tych długości
+* zależą rozmiary buforów struktury. Drzewo jest przeglądane bez rekurencji,
+* bo ścieżki w uszkodzonym pliku mogą być dowolnie długie.
+* @param[in] pool - wskaźnik na pulę wczytaną funkcją loadTrees.
+* @param[in] root - indeks korzenia drzewa.
+* @param[in] reverse - czy drzewo jest indeksem odwrotnym.
+* @param[in] maxSource - długość najdłuższego numeru przekierowywanego.
+* @param[in] maxTarget - długość najdłuższego numeru docelowego.
+* @return Wartość @p true, jeśli drzewo jest poprawne.
+*         Wartość @p false, gdy nie jest lub nie udało się zaalokować pamięci.
+*/
+static bool validTree(NodePool const *pool, NodeIdx root, bool reverse,
+					  size_t maxSource, size_t maxTarget) {
+	size_t capacity = SYMBOLS;
+	size_t size = 1;
+	Unchecked *stack = (Unchecked*)malloc(sizeof(Unchecked) * capacity);
+
+	if (stack == NULL)
 		return false;
 
-	int n = size(num1);
-	int i = 0;
+	stack[0] = (Unchecked){root, 0, 0};
+	bool ok = true;
+
+	while (ok && size > 0) {
+		Unchecked u = stack[--size];
+		Node const *node = getNode(pool, u.idx);
+		size_t depth = u.depth + node->length;
+		bool separator = (node->mask >> ALPHABET_SIZE) != 0;
+
+		if (!reverse)
+			ok = depth <= maxSource && !separator && node->value != PRESENT
+				 && (node->value == 0 || numberSize(pool, node->value) <= maxTarget);
+		else if (u.target == 0)
+			ok = depth <= maxTarget && node->value == 0 && (!separator || depth > 0);
+		else
+			ok = depth - u.target - 1 <= maxSource && !separator
+				 && (node->value == 0 || (node->value == PRESENT && depth > u.target + 1));
+
+		if (!ok || node->mask == 0)
+			continue;
 
-	while (i < n) {
-		if (pf->children == NULL) {
-			pf->children = (struct PhoneForward**)malloc
-				(sizeof(struct PhoneForward*) * ALPHABET_SIZE);
-			
-			if (pf->children == NULL)
-				return false;
+		if (capacity - size < SYMBOLS) {
+			capacity *= 2;
+			Unchecked *grown = (Unchecked*)realloc(stack, sizeof(Unchecked) * capacity);
 
-			for(int j = 0; j < ALPHABET_SIZE; j++) 
-				pf->children[j] = NULL;
+			if (grown == NULL) {
+				ok = false;
+				continue;
+			}
+
+			stack = grown;
 		}
-		
-		char c = num1[i];
-		int k = c - '0';
-		
-		if (k < 0 || k > ALPHABET_SIZE - 1)
-			return false;
 
-		if (pf->children[k] == NULL) {
-			pf->children[k] = (struct PhoneForward*)malloc(sizeof(struct PhoneForward));
+		NodeIdx kids = node->kids;
 
-			if (pf->children[k] == NULL)
-				return false;
+		for (uint16_t mask = node->mask; mask != 0; mask &= mask - 1) {
+			int symbol = __builtin_ctz(mask);
+			size_t target = symbol == ALPHABET_SIZE ? depth : u.target;
+			stack[size++] = (Unchecked){kids++, depth + 1, target};
+		}
+	}
+
+	free(stack);
+
+	return ok;
+}
+
+struct PhoneForward * phfwdLoad(char const *path) {
+	if (path == NULL)
+		return NULL;
+
+	struct PhoneForward *pf = (struct PhoneForward*)malloc(sizeof(struct PhoneForward));
+
+	if (pf == NULL)
+		return NULL;
+
+	initStats(&pf->stats);
+	atomic_init(&pf->skipped, 0);
+	pf->stride = NULL;
+	pf->cache = NULL;
+	pf->reclaim = NULL;
+	pf->pool = (NodePool*)malloc(sizeof(NodePool));
+	NodeIdx roots[SNAPSHOT_TREES];
+	uint64_t params[SNAPSHOT_PARAMS];
+
+	if (pf->pool == NULL || !loadTrees(pf->pool, roots, params, path)) {
+		free(pf->pool);
+		free(pf);
+		return NULL;
+	}
+
+	pf->root = roots[0];
+	pf->reverse = roots[1];
+	pf->key = NULL;
+	pf->keyCapacity = 0;
+	pf->maxSource = 0;
+	pf->maxTarget = 0;
+	pf->generation = 1;
+
+	for (size_t i = 0; i < MEMO_SIZE; i++)
+		pf->memo[i].generation = 0;
+
+	if (params[0] > UINT32_MAX || params[1] > UINT32_MAX
+		|| !validTree(pf->pool, pf->root, false, params[0], params[1])
+		|| !validTree(pf->pool, pf->reverse, true, params[0], params[1])
+		|| !reserveKey(pf, params[0], params[1])) {
+		phfwdDelete(pf);
+		return NULL;
+	}
+
+	return pf;
+}
+
+/** @brief Buduje indeks odwrotny z listy przekierowań.
+* Zastępuje klucze drzewa przekierowań w tablicy @p entries kluczami indeksu
+* odwrotnego i buduje z nich indeks. Numery docelowe przekierowań pominiętych
+* jako powtórzenia są zwalniane.
+* @param[in, out] pf - wskaźnik na strukturę z pustym indeksem odwrotnym.
+* @param[in, out] entries - tablica kluczy, z której zbudowano drzewo
+*                           przekierowań funkcją buildTree.
+* @param[in] n - liczba kluczy.
+* @return Wartość @p true, jeśli udało się zbudować indeks.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool buildReverse(struct PhoneForward *pf, Entry *entries, size_t n) {
+	NodePool *pool = pf->pool;
+	size_t keysSize = 0;
+
+	for (size_t i = 0; i < n; i++)
+		if (entries[i].len > 0)
+			keysSize += numberSize(pool, entries[i].value) + 1 + entries[i].len;
+
+	char *keys = (char*)malloc(sizeof(char) * (keysSize > 0 ? keysSize : 1));
+
+	if (keys == NULL)
+		return false;
 
-			(pf->children[k])->fstNum = NULL;
-			(pf->children[k])->sndNum = NULL;
-			(pf->children[k])->children = NULL;
+	char *key = keys;
+	size_t m = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		if (entries[i].len == 0) {
+			freeNumber(pool, entries[i].value);
+			continue;
 		}
-		i++;
-		pf = pf->children[k];
+
+		char const *target = getNumber(pool, entries[i].value);
+		size_t len = numberSize(pool, entries[i].value);
+		memcpy(key, target, len);
+		key[len] = SEPARATOR;
+		memcpy(key + len + 1, entries[i].key, entries[i].len);
+		entries[m].key = key;
+		entries[m].len = len + 1 + entries[i].len;
+		entries[m].value = PRESENT;
+		key += entries[m++].len;
+	}
+
+	bool ok = buildTree(pool, pf->reverse, entries, m);
+	free(keys);
+
+	return ok;
+}
+
+struct PhoneForward * phfwdBuild(char const * const *num1, char const * const *num2,
+								 size_t n) {
+	struct PhoneForward *pf = phfwdNew();
+
+	if (pf == NULL || num1 == NULL || num2 == NULL || n == 0)
+		return pf;
+
+	NodePool *pool = pf->pool;
+	Entry *entries = (Entry*)malloc(sizeof(Entry) * n);
+	bool ok = entries != NULL;
+	size_t maxSource = 0;
+	size_t maxTarget = 0;
+	size_t m = 0;
+
+	// Pomijamy przekierowania, których nie dodałaby funkcja phfwdAdd.
+	for (size_t i = 0; ok && i < n; i++) {
+		size_t n1 = numberLength(num1[i]);
+		size_t n2 = numberLength(num2[i]);
+
+		if (n1 == 0 || n2 == 0 || (n1 == n2 && memcmp(num1[i], num2[i], n1) == 0))
+			continue;
+
+		entries[m].key = num1[i];
+		entries[m].len = n1;
+		entries[m].value = newNumber(pool, num2[i], n2);
+		ok = entries[m++].value != 0;
+		maxSource = n1 > maxSource ? n1 : maxSource;
+		maxTarget = n2 > maxTarget ? n2 : maxTarget;
+	}
+
+	ok = ok && reserveKey(pf, maxSource, maxTarget)
+		 && buildTree(pool, pf->root, entries, m)
+		 && buildReverse(pf, entries, m);
+	free(entries);
+
+	if (!ok) {
+		phfwdDelete(pf);
+		return NULL;
+	}
+
+	return pf;
+}
+
+/** @brief Wstawia przekierowanie do drzew.
+* @param[in,out] pf - wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num1 - wskaźnik na numer przekierowywany;
+* @param[in] n1 - długość numeru @p num1;
+* @param[in] num2 - wskaźnik na numer, na który jest wykonywane przekierowanie;
+* @param[in] n2 - długość numeru @p num2.
+* @return Wartość @p true, jeśli przekierowanie zostało dodane.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool insertForward(struct PhoneForward *pf, char const *num1, size_t n1,
+						  char const *num2, size_t n2) {
+	NodePool *pool = pf->pool;
+	NodeIdx node = insertKey(pool, pf->root, num1, n1);
+
+	if (node == NO_NODE)
+		return false;
+
+	uint32_t old = getNode(pool, node)->value;
+
+	if (old != 0 && numberSize(pool, old) == n2
+		&& memcmp(getNumber(pool, old), num2, n2) == 0)
+		return true;
+
+	uint32_t value = newNumber(pool, num2, n2);
+	NodeIdx target = NO_NODE;
+
+	if (value != 0) {
+		char *key = makeKey(pf, num1, n1, num2, n2);
+		target = insertKey(pool, pf->reverse, key, n2 + 1 + n1);
 	}
-	
-	if (pf->fstNum == NULL) {
-		pf->fstNum = (char*)malloc(sizeof(char) * (n + 1));
 
-		if (pf->fstNum == NULL)
+	if (target == NO_NODE) {
+		if (value != 0)
+			freeNumber(pool, value);
+
+		if (old == 0)
+			eraseKey(pool, pf->root, num1, n1, false);
+
+		return false;
+	}
+
+	getNode(pool, target)->value = PRESENT;
+
+	if (old != 0) {
+		char const *oldNum = getNumber(pool, old);
+		size_t n = numberSize(pool, old);
+		char *key = makeKey(pf, NULL, n1, oldNum, n);
+
+		// Ścieżki świeżo wstawionych kluczy nie są dzielone, więc ich
+		// usunięcie nie wymaga pamięci.
+		if (!eraseKey(pool, pf->reverse, key, n + 1 + n1, false)) {
+			key = makeKey(pf, NULL, n1, num2, n2);
+			eraseKey(pool, pf->reverse, key, n2 + 1 + n1, false);
+			freeNumber(pool, value);
 			return false;
+		}
 
-		strcpy(pf->fstNum, num1);
+		freeNumber(pool, old);
 	}
 
-	if (pf->sndNum != NULL)
-		free (pf->sndNum);
+	getNode(pool, node)->value = value;
+	compactNumbers(pool);
+
+	return true;
+}
+
+/** @brief Dodaje przekierowanie.
+* Wykonuje operację funkcji @ref phfwdAdd bez zapisywania jej czasu.
+* @param[in,out] pf - wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num1 - wskaźnik na napis reprezentujący prefix numerów
+*                   przekierowywanych;
+* @param[in] n1 - długość numeru @p num1 lub @p 0, gdy nie jest on numerem;
+* @param[in] num2 - wskaźnik na napis reprezentujący prefix numerów,
+*                   na które jest wykonywane przekierowanie;
+* @param[in] n2 - długość numeru @p num2 lub @p 0, gdy nie jest on numerem.
+* @return Wartość @p true, jeśli przekierowanie zostało dodane.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+static bool addForward(struct PhoneForward *pf, char const *num1, size_t n1,
+					   char const *num2, size_t n2) {
+	if (n1 == 0 || n2 == 0)
+		return false;
+
+	if (n1 == n2 && memcmp(num1, num2, n1) == 0)
+		return false;
 
-	pf->sndNum = (char*)malloc(sizeof(char) * (size(num2) + 1));
+	pf->generation++;
 
-	if (pf->sndNum == NULL)
+	if (!reserveKey(pf, n1, n2))
 		return false;
 
-	strcpy(pf->sndNum, num2);
+	if (pf->cache != NULL)
+		invalidateCached(pf->cache, num1, n1);
+
+	if (pf->stride == NULL)
+		return insertForward(pf, num1, n1, num2, n2);
+
+	// Wycofanie nieudanego wstawienia może scalić krawędzie powyżej
+	// ostatniego węzła ścieżki, więc wtedy odświeżamy cały indeks.
+	size_t region = strideRegion(pf->pool, pf->root, num1, n1, false);
+	bool result = insertForward(pf, num1, n1, num2, n2);
+	refreshStrideIndex(pf->stride, pf->pool, pf->root, num1, result ? region : 0);
+
+	return result;
+}
+
+/** @brief Usuwa poddrzewo przekierowań z indeksu odwrotnego.
+* Usuwa z indeksu odwrotnego wszystkie przekierowania znajdujące się
+* w poddrzewie o korzeniu @p idx i zwalnia ich numery docelowe. Numer
+* odpowiadający węzłowi @p idx musi być zapisany w buforze kluczy tak,
+* jak robi to funkcja makeKey.
+* @param[in] pf - wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] idx - indeks korzenia poddrzewa drzewa przekierowań.
+* @param[in] depth - długość numeru odpowiadającego węzłowi @p idx.
+*/
+void unlinkSubtree(struct PhoneForward *pf, NodeIdx idx, size_t depth) {
+	NodePool *pool = pf->pool;
+	uint32_t value = getNode(pool, idx)->value;
+
+	if (value != 0) {
+		char const *target = getNumber(pool, value);
+		size_t n = numberSize(pool, value);
+		char *key = makeKey(pf, NULL, depth, target, n);
+		eraseKey(pool, pf->reverse, key, n + 1 + depth, false);
+		freeNumber(pool, value);
+	}
+
+	char *source = pf->key + pf->maxTarget + 1;
+	Node const *node = getNode(pool, idx);
+	uint16_t mask = node->mask;
+	NodeIdx kids = node->kids;
+
+	for (int i = 0; i < ALPHABET_SIZE; i++) {
+		if ((mask & (1u << i)) != 0) {
+			uint16_t length = getNode(pool, kids)->length;
+			source[depth] = '0' + i;
+			memcpy(source + depth + 1, getLabel(pool, kids), length);
+			unlinkSubtree(pf, kids++, depth + 1 + length);
+		}
+	}
+}
+
+bool phfwdAdd(struct PhoneForward *pf, char const *num1, char const *num2) {
+	if (pf == NULL)
+		return false;
+
+	uint64_t start = startCall(&pf->stats, PHFWD_ADD);
+	bool result = addForward(pf, num1, numberLength(num1), num2,
+							 numberLength(num2));
+	reclaimStep(pf, RECLAIM_SLICE);
+	endCall(&pf->stats, PHFWD_ADD, start);
+
+	return result;
+}
+
+bool phfwdAddN(struct PhoneForward *pf, char const *num1, size_t n1,
+			   char const *num2, size_t n2) {
+	if (pf == NULL)
+		return false;
+
+	uint64_t start = startCall(&pf->stats, PHFWD_ADD);
+	bool result = addForward(pf, num1, spanLength(num1, n1), num2,
+							 spanLength(num2, n2));
+	reclaimStep(pf, RECLAIM_SLICE);
+	endCall(&pf->stats, PHFWD_ADD, start);
+
+	return result;
+}
+
+/** @brief Odłącza poddrzewo przekierowań.
+* Usuwa z drzewa przekierowań poddrzewo o korzeniu @p idx w czasie zależnym
+* tylko od długości numeru @p num. Z indeksu odwrotnego usuwa od razu tylko
+* przekierowanie samego węzła @p idx, a pozostałe odkłada do stopniowego
+* usunięcia. Numer odpowiadający węzłowi @p idx musi być zapisany w buforze
+* kluczy tak, jak robi to funkcja makeKey.
+* @param[in,out] pf - wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] idx - indeks korzenia poddrzewa drzewa przekierowań.
+* @param[in] num - wskaźnik na prefix numerów usuwanych przekierowań.
+* @param[in] n - długość prefixu.
+* @param[in] depth - długość numeru odpowiadającego węzłowi @p idx.
+* @return Wartość @p true, jeśli poddrzewo zostało odłączone.
+*         Wartość @p false, gdy węzeł @p idx nie ma dzieci lub nie udało się
+*         zaalokować pamięci; struktura nie jest wtedy zmieniana.
+*/
+static bool detachForward(struct PhoneForward *pf, NodeIdx idx, char const *num,
+						  size_t n, size_t depth) {
+	NodePool *pool = pf->pool;
+
+	// Poddrzewa bez dzieci usuwamy od razu w tym samym czasie.
+	if (getNode(pool, idx)->mask == 0)
+		return false;
+
+	if (pf->reclaim == NULL && (pf->reclaim = newReclaimer()) == NULL)
+		return false;
+
+	Node detached;
+
+	if (!reserveReclaimer(pf->reclaim, depth, pf->maxSource, pf->maxTarget)
+		|| !detachKey(pool, pf->root, num, n, &detached))
+		return false;
+
+	if (detached.value != 0) {
+		char const *target = getNumber(pool, detached.value);
+		size_t length = numberSize(pool, detached.value);
+		char *key = makeKey(pf, NULL, depth, target, length);
+		eraseKey(pool, pf->reverse, key, length + 1 + depth, false);
+		freeNumber(pool, detached.value);
+	}
+
+	pushDetached(pf->reclaim, detached.kids, detached.mask,
+				 pf->key + pf->maxTarget + 1, depth);
 
 	return true;
 }
 
-void phfwdRemove(struct PhoneForward *pf, char const *num) {
-	if (num == NULL || strcmp(num, " ") == 0)
+/** @brief Usuwa przekierowania.
+* Wykonuje operację funkcji @ref phfwdRemove bez zapisywania jej czasu.
+* @param[in,out] pf - wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num - wskaźnik na napis reprezentujący prefix numerów;
+* @param[in] n - długość numeru @p num lub @p 0, gdy nie jest on numerem.
+*/
+static void removeForward(struct PhoneForward *pf, char const *num, size_t n) {
+	if (n == 0)
 		return;
 
-	int n = size(num);
-	int i = 0;
+	NodePool *pool = pf->pool;
+	size_t depth;
+	NodeIdx node = locateKey(pool, pf->root, num, n, &depth);
 
-	while (i < n - 1) {
-		if (pf->children == NULL)
-			return;
+	if (node == NO_NODE)
+		return;
 
-		char c = num[i];
-		int k = c - '0';
+	pf->generation++;
 
-		if (k < 0 || k > ALPHABET_SIZE - 1)
-			return;
+	if (pf->cache != NULL)
+		invalidateCached(pf->cache, num, n);
 
-		if (pf->children[k] == NULL)
-			return;
+	// Numer może kończyć się wewnątrz etykiety krawędzi prowadzącej do
+	// węzła, więc dopisujemy pozostałą część etykiety.
+	char *source = pf->key + pf->maxTarget + 1;
+	size_t length = getNode(pool, node)->length;
+	memcpy(source, num, n);
+	memcpy(source + n, getLabel(pool, node) + length - (depth - n), depth - n);
+	size_t region = pf->stride != NULL ? strideRegion(pool, pf->root, num, n, true) : 0;
 
-		pf = pf->children[k];
-		i++;
+	if (!detachForward(pf, node, num, n, depth)) {
+		unlinkSubtree(pf, node, depth);
+		eraseKey(pool, pf->root, num, n, true);
 	}
-	
-	if (pf->children == NULL)
-			return;
 
-	char c = num[i];
-	int k = c - '0';
+	compactNumbers(pool);
 
-	if (k < 0 || k > ALPHABET_SIZE - 1)
-		return;
+	if (pf->stride != NULL)
+		refreshStrideIndex(pf->stride, pool, pf->root, num, region);
+}
 
-	if (pf->children[k] == NULL)
+void phfwdRemove(struct PhoneForward *pf, char const *num) {
+	if (pf == NULL)
 		return;
 
-	phfwdDelete(pf->children[k]);
-	pf->children[k] = NULL;	
-}
-
-/** @brief Wyznacza numer na podstawie przekierowania.
-* Wyznacza numer, na który przekeierowany zostanie @p number
-* gdy jego prefix @p num1 zostanie zamieniony na @p num2. O danych 
-* wejściowych zakłada się że @p num1 jest prefixem @p number.
-* @param[in] number - wskaźnik na numer, którego przekierowanie mamy wyznaczyć
-* @param[in] num1 - wskaźnik na prefix, który zostanie przekierowany na @p num2.
-* @param[in] num2 - wskaźnik na numer, na który zostanie przekierowany @p num1.
-* return Wskaźnik na powstały w wyniku operacji numer lub NULL, gdy nie uda
-* 		 się zaalokować pamięci.
-*/
-char * redirect(char const *number, char const *num1, char const *num2) {
-	int n = size(number);
-	int n1 = size(num1);
-	int n2 = size(num2);
-	int c = n + n2 - n1 + 1;
-	
-	char *wyn = (char*)malloc(sizeof(char) * c);
-	
-	if (wyn == NULL)
-		return NULL;
-	
-	strcpy(wyn, num2);
-	strcpy(wyn + n2, number + n1);
-	
+	uint64_t start = startCall(&pf->stats, PHFWD_REMOVE);
+	removeForward(pf, num, numberLength(num));
+	reclaimStep(pf, RECLAIM_SLICE);
+	endCall(&pf->stats, PHFWD_REMOVE, start);
+}
+
+/** @brief Kontynuuje wyszukiwanie przekierowania z najdłuższym prefixem.
+* Schodzi w drzewie od węzła @p root odpowiadającego pierwszym @p i
+* symbolom numeru @p num, poprawiając dotychczasowy wynik @p wyn.
+* @param[in] pool - wskaźnik na pulę węzłów drzewa.
+* @param[in] root - indeks węzła, od którego zaczynamy.
+* @param[in] num - wskaźnik na numer, którego najdłuższy prefix jest poszukiwany.
+* @param[in] n - długość numeru @p num.
+* @param[in] i - długość prefixu odpowiadającego węzłowi @p root.
+* @param[in] wyn - dotychczasowy wynik.
+* @param[in,out] len - długość prefixu odpowiadającego wynikowi.
+* @return Wartość identyfikująca numer docelowy znalezionego przekierowania
+*         lub @p 0, gdy w drzewie nie ma żadnego prefixu liczby @p num.
+*/
+static uint32_t continueBest(NodePool const *pool, NodeIdx root, char const *num,
+							 size_t n, size_t i, uint32_t wyn, size_t *len) {
+	while (i < n) {
+		root = getChild(pool, root, num[i]);
+
+		if (root == NO_NODE || !matchLabel(pool, root, num + i + 1, n - i - 1))
+			break;
+
+		Node const *node = getNode(pool, root);
+		i += 1 + node->length;
+
+		if (node->value != 0) {
+			wyn = node->value;
+			*len = i;
+		}
+	}
+
 	return wyn;
-} 
+}
 
 /** @brief Znajduje przekierowanie z najdłuższym pasującym prefixem.
-* Zwraca przekierowanie, którego pierwszy numer jest najdłuższym
-* prefixem numeru @p num spośród tych, które znajdują się w drzewie
-* przekierowań @p pf (jako pierwsze numery przekierowań)
-* @param[in] pf - wskażnik na korzeń dzewa przekierowań,
-*				  z którego wybieramy przekierowanie
+* Zwraca numer docelowy przekierowania, którego pierwszy numer jest
+* najdłuższym prefixem numeru @p num spośród tych, które znajdują się
+* w drzewie przekierowań (jako pierwsze numery przekierowań).
+* @param[in] pool - wskaźnik na pulę węzłów drzewa.
+* @param[in] root - indeks korzenia drzewa przekierowań.
 * @param[in] num - wskaźnik na numer, którego najdłuższy prefix jest poszukiwany.
-* @return Wskaźnik na szukane przekierowanie, korzeń drzewa gdy w drzewie nie
-* 		  ma żadnego prefixu liczby @p num lub NULL, gdy napis nie reprezentue
-*         numeru albo @p pf jest NULLem.
+* @param[in] n - długość numeru @p num.
+* @param[out] len - długość znalezionego prefixu.
+* @return Wartość identyfikująca numer docelowy znalezionego przekierowania
+*         lub @p 0, gdy w drzewie nie ma żadnego prefixu liczby @p num.
 */
-struct PhoneForward * findBest (struct PhoneForward *pf, char const *num) {
-	if (pf == NULL)
-		return NULL;
+uint32_t findBest (NodePool const *pool, NodeIdx root, char const *num, size_t n,
+				   size_t *len) {
+	*len = 0;
 
-	struct PhoneForward *wyn = pf;
-	int n = size(num);
-	int i = 0;
+	return continueBest(pool, root, num, n, 0, 0, len);
+}
 
-	while (i < n) {
-		if (pf->children == NULL)
-			return wyn;
+/** @brief Znajduje przekierowanie z najdłuższym pasującym prefixem.
+* Działa tak jak funkcja @ref findBest, ale zaczyna od pozycji
+* wielokrokowego indeksu drzewa struktury @p pf.
+* @param[in] pf  - wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num - wskaźnik na numer, którego najdłuższy prefix jest poszukiwany.
+* @param[in] n - długość numeru @p num.
+* @param[out] len - długość znalezionego prefixu.
+* @return Wartość identyfikująca numer docelowy znalezionego przekierowania
+*         lub @p 0, gdy w drzewie nie ma żadnego prefixu liczby @p num.
+*/
+static uint32_t strideBest(struct PhoneForward *pf, char const *num, size_t n,
+						   size_t *len) {
+	StrideEntry const *e = strideEntry(pf->stride, num, n);
 
-		char c = num[i];
-		int k = c - '0';
-		
-		if (k < 0 || k > ALPHABET_SIZE - 1)
-			return NULL;
+	if (e == NULL)
+		return findBest(pf->pool, pf->root, num, n, len);
+
+	uint32_t wyn = e->best == NO_NODE ? 0 : getNode(pf->pool, e->best)->value;
+	*len = e->bestDepth;
 
-		if (pf->children[k] == NULL)
-			return wyn;
+	if (e->node == NO_NODE)
+		return wyn;
 
-		pf = pf->children[k];
+	return continueBest(pf->pool, e->node, num, n, e->depth, wyn, len);
+}
+
+/** @brief Wyznacza przekierowanie numeru bez jego zapisywania.
+* Znajduje przekierowanie z najdłuższym pasującym prefixem numeru @p num.
+* @param[in] pf  - wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num - wskaźnik na numer.
+* @param[in] n - długość numeru.
+* @param[out] num2 - wskaźnik na numer, na który zamieniany jest prefix,
+*                    lub na pusty napis, gdy żaden prefix nie pasuje;
+*                    numer nie musi być zakończony znakiem '\0'.
+* @param[out] n2 - długość numeru @p num2.
+* @param[out] len - długość zamienianego prefixu.
+* @return Długość wyniku przekierowania.
+*/
+static size_t resolve(struct PhoneForward *pf, char const *num, size_t n,
+					  char const **num2, size_t *n2, size_t *len) {
+	CacheEntry const *e = pf->cache != NULL ? findCached(pf->cache, num, n) : NULL;
 
-		if (pf->fstNum != NULL)
-			wyn = pf;
+	// Zapamiętany wynik zastępuje cały numer.
+	if (e != NULL) {
+		*num2 = e->result;
+		*n2 = e->resultLength;
+		*len = e->length;
 
-		i++;
+		return *n2;
 	}
 
-	return wyn;
+	uint32_t best = pf->stride != NULL ? strideBest(pf, num, n, len)
+					: findBest(pf->pool, pf->root, num, n, len);
+
+	*num2 = best == 0 ? "" : getNumber(pf->pool, best);
+	*n2 = best == 0 ? 0 : numberSize(pf->pool, best);
+
+	if (pf->cache != NULL)
+		storeCached(pf->cache, num, n, *len, *num2, *n2);
+
+	return *n2 + n - *len;
 }
 
-struct PhoneNumbers const * phfwdGet(struct PhoneForward *pf, char const *num) {
+/** @brief Zapisuje wynik przekierowania.
+* Zapisuje do bufora @p buf numer powstały przez zamianę prefixu numeru
+* @p num długości @p len na numer @p num2 i kończy go znakiem '\0'.
+* @param[in] num - wskaźnik na przekierowywany numer.
+* @param[in] n - długość numeru @p num.
+* @param[in] len - długość zamienianego prefixu.
+* @param[in] num2 - wskaźnik na numer, na który zamieniany jest prefix.
+* @param[in] n2 - długość numeru @p num2.
+* @param[out] buf - bufor, w którym zapisywany jest wynik.
+*/
+static void writeRedirect(char const *num, size_t n, size_t len,
+						  char const *num2, size_t n2, char *buf) {
+	memcpy(buf, num2, n2);
+	memcpy(buf + n2, num + len, n - len);
+	buf[n2 + n - len] = '\0';
+}
+
+/** @brief Wyznacza przekierowanie numeru do bufora.
+* Wykonuje operację funkcji @ref phfwdGetInto bez zapisywania jej czasu.
+* @param[in] pf  - wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num - wskaźnik na napis reprezentujący numer;
+* @param[in] n - długość numeru @p num lub @p 0, gdy nie jest on numerem;
+* @param[out] buf - bufor, w którym zapisywany jest wynik;
+* @param[in] bufSize - rozmiar bufora @p buf.
+* @return Długość wyniku przekierowania lub @p 0, gdy @p num nie jest numerem.
+*/
+static size_t getInto(struct PhoneForward *pf, char const *num, size_t n,
+					  char *buf, size_t bufSize) {
+	if (n == 0) {
+		if (bufSize > 0)
+			buf[0] = '\0';
+
+		return 0;
+	}
+
+	char const *num2;
+	size_t n2, len;
+	size_t m = resolve(pf, num, n, &num2, &n2, &len);
+
+	if (m < bufSize)
+		writeRedirect(num, n, len, num2, n2, buf);
+
+	return m;
+}
+
+size_t phfwdGetInto(struct PhoneForward *pf, char const *num, char *buf,
+					size_t bufSize) {
+	if (pf == NULL) {
+		if (bufSize > 0)
+			buf[0] = '\0';
+
+		return 0;
+	}
+
+	uint64_t start = startCall(&pf->stats, PHFWD_GET);
+	size_t m = getInto(pf, num, numberLength(num), buf, bufSize);
+	endCall(&pf->stats, PHFWD_GET, start);
+
+	return m;
+}
+
+size_t phfwdGetIntoN(struct PhoneForward *pf, char const *num, size_t n,
+					 char *buf, size_t bufSize) {
+	if (pf == NULL) {
+		if (bufSize > 0)
+			buf[0] = '\0';
+
+		return 0;
+	}
+
+	uint64_t start = startCall(&pf->stats, PHFWD_GET);
+	size_t m = getInto(pf, num, spanLength(num, n), buf, bufSize);
+	endCall(&pf->stats, PHFWD_GET, start);
+
+	return m;
+}
+
+/** @brief Wyznacza przekierowanie numeru.
+* Wykonuje operację funkcji @ref phfwdGet bez zapisywania jej czasu.
+* @param[in] pf  - wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num - wskaźnik na napis reprezentujący numer;
+* @param[in] n - długość numeru @p num lub @p 0, gdy nie jest on numerem.
+* @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+*         udało się zaalokować pamięci.
+*/
+static struct PhoneNumbers const * getForward(struct PhoneForward *pf,
+											  char const *num, size_t n) {
 	struct PhoneNumbers *ph = (struct PhoneNumbers*)malloc(sizeof(struct PhoneNumbers));
 	
 	if (ph == NULL)
@@ -321,260 +1191,1186 @@ struct PhoneNumbers const * phfwdGet(struct PhoneForward *pf, char const *num) {
 		return NULL;
 	}
 	
-	struct PhoneForward *best = findBest(pf, num); //znajdujemy najlepsze
-												   // przekierowanie
-	
-	if (best == NULL || !isNumber(num)) { // jeżeli napis nie reprezentuje numeru
+	if (pf == NULL || n == 0) { // jeżeli napis nie reprezentuje numeru
 		ph->size = 0;
 		
 		return ph;
 	} 
 	
-	if (best->fstNum == NULL) { //jeżeli żaden prefix nie pasuje zwracamy null
-		int n = size(num);
-		ph->numbers[0] = (char*)malloc(sizeof(char) * (n + 1));
-		
-		if (ph->numbers[0] == NULL) {
-			free (ph->numbers);
-			free (ph);
-			return NULL;
+	// wynik zapisujemy od razu w zwracanej strukturze
+	char const *num2;
+	size_t n2, len;
+	size_t m = resolve(pf, num, n, &num2, &n2, &len);
+	ph->numbers[0] = (char*)malloc(sizeof(char) * (m + 1));
+
+	if (ph->numbers[0] == NULL) {
+		free(ph->numbers);
+		free(ph);
+		return NULL;
+	}
+
+	writeRedirect(num, n, len, num2, n2, ph->numbers[0]);
+	ph->size = 1;
+	
+	return ph;
+}
+
+struct PhoneNumbers const * phfwdGet(struct PhoneForward *pf, char const *num) {
+	if (pf == NULL)
+		return getForward(pf, num, 0);
+
+	uint64_t start = startCall(&pf->stats, PHFWD_GET);
+	struct PhoneNumbers const *ph = getForward(pf, num, numberLength(num));
+	endCall(&pf->stats, PHFWD_GET, start);
+
+	return ph;
+}
+
+struct PhoneNumbers const * phfwdGetN(struct PhoneForward *pf, char const *num,
+									  size_t n) {
+	if (pf == NULL)
+		return getForward(pf, num, 0);
+
+	uint64_t start = startCall(&pf->stats, PHFWD_GET);
+	struct PhoneNumbers const *ph = getForward(pf, num, spanLength(num, n));
+	endCall(&pf->stats, PHFWD_GET, start);
+
+	return ph;
+}
+
+/** @brief Stan wyszukiwania przekierowania numeru.
+* Wyszukiwania przekierowań kolejnych numerów partii przeplatają się: każdy
+* krok kończy się pobraniem z wyprzedzeniem danych potrzebnych w następnym
+* kroku, a zanim zostanie on wykonany, kroki wykonują pozostałe wyszukiwania.
+*/
+typedef struct Walk {
+	/// Indeks numeru w partii.
+	size_t idx;
+	/// Długość numeru.
+	size_t n;
+	/// Liczba przetworzonych cyfr numeru.
+	size_t pos;
+	/// Indeks węzła, który zostanie odwiedzony w następnym kroku.
+	NodeIdx node;
+	/// Czy etykieta krawędzi prowadzącej do węzła została już pobrana.
+	bool label;
+	/// Numer docelowy najlepszego dotychczas przekierowania lub @p 0.
+	uint32_t best;
+	/// Długość prefixu najlepszego dotychczas przekierowania.
+	size_t len;
+} Walk;
+
+/** @brief Wykonuje krok wyszukiwania przekierowania.
+* Odwiedza węzeł @p w->node tak jak funkcja @ref findBest, a następnie
+* przechodzi do kolejnego węzła ścieżki, pobierając go z wyprzedzeniem.
+* Jeśli krawędź prowadząca do węzła ma etykietę, najpierw pobiera ją
+* i przerywa krok.
+* @param[in] pool - wskaźnik na pulę węzłów drzewa.
+* @param[in] num - wskaźnik na numer, którego przekierowania szukamy.
+* @param[in,out] w - wskaźnik na stan wyszukiwania.
+* @return Wartość @p true, jeśli wyszukiwanie nie zostało zakończone.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+static bool walkStep(NodePool const *pool, char const *num, Walk *w) {
+	Node const *node = getNode(pool, w->node);
+
+	if (node->length > 0 && !w->label) {
+		__builtin_prefetch(getLabel(pool, w->node));
+		w->label = true;
+		return true;
+	}
+
+	if (!matchLabel(pool, w->node, num + w->pos, w->n - w->pos))
+		return false;
+
+	w->pos += node->length;
+
+	if (node->value != 0) {
+		w->best = node->value;
+		w->len = w->pos;
+		__builtin_prefetch(getNumber(pool, w->best));
+	}
+
+	if (w->pos == w->n)
+		return false;
+
+	NodeIdx child = getChild(pool, w->node, num[w->pos]);
+
+	if (child == NO_NODE)
+		return false;
+
+	w->node = child;
+	w->pos++;
+	w->label = false;
+	__builtin_prefetch(getNode(pool, child));
+
+	return true;
+}
+
+/** @brief Rozpoczyna wyszukiwanie przekierowania numeru.
+* Jeśli struktura ma wielokrokowy indeks drzewa, wyszukiwanie zaczyna się
+* od jego pozycji tak jak w funkcji @ref strideBest.
+* @param[in] pf - wskaźnik na strukturę przechowującą przekierowania numerów.
+* @param[in] idx - indeks numeru w partii.
+* @param[in] num - wskaźnik na numer.
+* @param[in] n - długość numeru.
+* @param[out] w - wskaźnik na inicjowany stan wyszukiwania.
+* @return Wartość @p true, jeśli wyszukiwanie wymaga wykonania kroków.
+*         Wartość @p false, jeśli jego wynik jest już znany.
+*/
+static bool walkStart(struct PhoneForward *pf, size_t idx, char const *num,
+					  size_t n, Walk *w) {
+	w->idx = idx;
+	w->n = n;
+	w->pos = 0;
+	w->node = pf->root;
+	w->label = false;
+	w->best = 0;
+	w->len = 0;
+
+	StrideEntry const *e = pf->stride != NULL ? strideEntry(pf->stride, num, n) : NULL;
+
+	if (e == NULL)
+		return true;
+
+	w->best = e->best == NO_NODE ? 0 : getNode(pf->pool, e->best)->value;
+	w->len = e->bestDepth;
+
+	if (e->node == NO_NODE)
+		return false;
+
+	// Etykieta węzła pozycji jest już dopasowana, więc krok nie pobiera jej
+	// ponownie, tylko przechodzi do kolejnego węzła.
+	w->node = e->node;
+	w->pos = e->depth - getNode(pf->pool, e->node)->length;
+	w->label = true;
+
+	return true;
+}
+
+/** @brief Zapisuje wynik przekierowania w nowym napisie.
+* @param[in] num - wskaźnik na przekierowywany numer.
+* @param[in] n - długość numeru @p num.
+* @param[in] len - długość zamienianego prefixu.
+* @param[in] num2 - wskaźnik na numer, na który zamieniany jest prefix.
+* @param[in] n2 - długość numeru @p num2.
+* @return Wskaźnik na zaalokowany wynik lub NULL, gdy nie udało się
+*         zaalokować pamięci.
+*/
+static char * newRedirect(char const *num, size_t n, size_t len,
+						  char const *num2, size_t n2) {
+	char *result = (char*)malloc(sizeof(char) * (n2 + n - len + 1));
+
+	if (result != NULL)
+		writeRedirect(num, n, len, num2, n2, result);
+
+	return result;
+}
+
+/** @brief Zapisuje wynik zakończonego wyszukiwania przekierowania.
+* Zapamiętuje go też w pamięci podręcznej struktury, jeśli jest włączona.
+* @param[in] pf - wskaźnik na strukturę przechowującą przekierowania numerów.
+* @param[in] num - wskaźnik na numer, którego przekierowania szukano.
+* @param[in] w - wskaźnik na stan zakończonego wyszukiwania.
+* @return Wskaźnik na zaalokowany wynik lub NULL, gdy nie udało się
+*         zaalokować pamięci.
+*/
+static char * walkResult(struct PhoneForward *pf, char const *num, Walk const *w) {
+	char const *num2 = w->best == 0 ? "" : getNumber(pf->pool, w->best);
+	size_t n2 = w->best == 0 ? 0 : numberSize(pf->pool, w->best);
+
+	if (pf->cache != NULL)
+		storeCached(pf->cache, num, w->n, w->len, num2, n2);
+
+	return newRedirect(num, w->n, w->len, num2, n2);
+}
+
+/** @brief Wyznacza przekierowania ciągu numerów.
+* Wykonuje operację funkcji @ref phfwdGetBatch bez zapisywania jej czasu.
+* @param[in] pf   - wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] nums - wskaźnik na tablicę napisów reprezentujących numery;
+* @param[in] n    - liczba numerów.
+* @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+*         udało się zaalokować pamięci.
+*/
+static struct PhoneNumbers const * getBatch(struct PhoneForward *pf,
+											char const * const *nums, size_t n) {
+	struct PhoneNumbers *ph = (struct PhoneNumbers*)malloc(sizeof(struct PhoneNumbers));
+
+	if (ph == NULL)
+		return NULL;
+
+	ph->size = pf == NULL || nums == NULL ? 0 : n;
+	ph->numbers = (char**)malloc(sizeof(char*) * (ph->size > 0 ? ph->size : 1));
+
+	if (ph->numbers == NULL) {
+		free(ph);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < ph->size; i++)
+		ph->numbers[i] = NULL;
+
+	Walk walks[BATCH_WIDTH];
+	size_t active = 0;
+	size_t next = 0;
+
+	while (next < ph->size || active > 0) {
+		// Zwolnione miejsca zajmują wyszukiwania dla kolejnych numerów.
+		while (active < BATCH_WIDTH && next < ph->size) {
+			char const *num = nums[next];
+			size_t length = numberLength(num);
+			CacheEntry const *e = length > 0 && pf->cache != NULL
+								  ? findCached(pf->cache, num, length) : NULL;
+			Walk *w = walks + active;
+
+			// Wyszukiwanie jest potrzebne tylko dla numerów, których wyniku
+			// nie ma w pamięci podręcznej ani w wielokrokowym indeksie.
+			if (length > 0 && e == NULL && walkStart(pf, next, num, length, w)) {
+				active++;
+				next++;
+				continue;
+			}
+
+			if (length == 0)
+				ph->numbers[next] = (char*)calloc(1, sizeof(char));
+			else if (e != NULL)
+				ph->numbers[next] = newRedirect(num, length, e->length, e->result,
+												e->resultLength);
+			else
+				ph->numbers[next] = walkResult(pf, num, w);
+
+			if (ph->numbers[next] == NULL) {
+				phnumDelete(ph);
+				return NULL;
+			}
+
+			next++;
 		}
-		
-		strcpy(ph->numbers[0], num);
+
+		for (size_t i = 0; i < active; ) {
+			Walk *w = walks + i;
+
+			if (walkStep(pf->pool, nums[w->idx], w)) {
+				i++;
+				continue;
+			}
+
+			ph->numbers[w->idx] = walkResult(pf, nums[w->idx], w);
+
+			if (ph->numbers[w->idx] == NULL) {
+				phnumDelete(ph);
+				return NULL;
+			}
+
+			*w = walks[--active];
+		}
+	}
+
+	return ph;
+}
+
+struct PhoneNumbers const * phfwdGetBatch(struct PhoneForward *pf,
+										  char const * const *nums, size_t n) {
+	if (pf == NULL)
+		return getBatch(pf, nums, n);
+
+	uint64_t start = startCall(&pf->stats, PHFWD_GET_BATCH);
+	struct PhoneNumbers const *ph = getBatch(pf, nums, n);
+	endCall(&pf->stats, PHFWD_GET_BATCH, start);
+
+	return ph;
+}
+
+/** @brief Zlicza wartości w poddrzewie.
+* @param[in] pool - wskaźnik na pulę węzłów drzewa.
+* @param[in] idx - indeks korzenia poddrzewa.
+* @return Liczba węzłów poddrzewa mających wartość.
+*/
+size_t countValues(NodePool const *pool, NodeIdx idx) {
+	Node const *node = getNode(pool, idx);
+	size_t n = node->value != 0 ? 1 : 0;
+	uint32_t kids = __builtin_popcount(node->mask);
+
+	for (uint32_t i = 0; i < kids; i++)
+		n += countValues(pool, node->kids + i);
+
+	return n;
+}
+
+/** @brief Znajduje liczbę przekierowań.
+* Znajduje liczbę przekierowań na liczbę @p num, przechodząc indeks odwrotny
+* wzdłuż numeru @p num. Odwiedzane są jedynie poddrzewa przekierowań na
+* prefixy numeru @p num. Liczone są też nieaktualne klucze poddrzew
+* odłączonych, więc wynik jest tylko górnym ograniczeniem.
+* @param[in] pool - wskaźnik na pulę węzłów drzewa.
+* @param[in] idx - indeks korzenia indeksu odwrotnego.
+* @param[in] num - wskaźnik na numer, na który przekierowań szukamy.
+* @param[in] length - długość numeru @p num.
+* @return Liczba przekierowań na numer num.
+*/
+size_t findSize(NodePool const *pool, NodeIdx idx, char const *num, size_t length) {
+	size_t n = 0;
+
+	size_t i = 0;
+
+	while (i < length) {
+		idx = getChild(pool, idx, num[i]);
+
+		if (idx == NO_NODE || !matchLabel(pool, idx, num + i + 1, length - i - 1))
+			break;
+
+		i += 1 + getNode(pool, idx)->length;
+		NodeIdx sources = getChild(pool, idx, SEPARATOR);
+
+		if (sources != NO_NODE)
+			n += countValues(pool, sources);
+	}
+
+	return n;
+}
+
+/** @brief Węzeł ścieżki przeglądanej przez strumień numerów.
+* Przechowuje węzeł indeksu odwrotnego leżący na ścieżce od korzenia
+* poddrzewa do aktualnie odwiedzanego węzła oraz dzieci tego węzła, które
+* nie zostały jeszcze odwiedzone.
+*/
+typedef struct PathEntry {
+	/// Indeks pierwszego nieodwiedzonego dziecka.
+	NodeIdx kid;
+	/// Maska symboli nieodwiedzonych dzieci.
+	uint16_t mask;
+	/// Długość numeru odpowiadającego węzłowi.
+	size_t depth;
+} PathEntry;
+
+/** @brief Strumień numerów przekierowanych na dany numer.
+* Strumień wyznacza w porządku leksykograficznym napisy x @p suffix dla
+* wszystkich numerów x z poddrzewa indeksu odwrotnego, przeglądając to
+* poddrzewo w głąb. Przeglądane numery x są kolejnymi prefixami bufora
+* @p path. Napis x @p suffix dla odwiedzonego numeru x czeka na liście
+* oczekujących, dopóki dalsza część poddrzewa może zawierać mniejsze napisy.
+* Oczekujące numery są przodkami aktualnie odwiedzanego węzła, więc
+* wystarczy pamiętać ich długości.
+*/
+typedef struct Stream {
+	/// Sufiks dopisywany do numerów.
+	char const *suffix;
+	/// Bufor, w którym znajduje się aktualnie przeglądany numer.
+	char *path;
+	/// Stos węzłów ścieżki od korzenia poddrzewa.
+	PathEntry *stack;
+	/// Liczba elementów stosu.
+	size_t stackSize;
+	/// Rozmiar tablicy @p stack.
+	size_t stackCapacity;
+	/// Długości oczekujących numerów.
+	size_t *pending;
+	/// Liczba oczekujących numerów.
+	size_t pendingSize;
+	/// Rozmiar tablicy @p pending.
+	size_t pendingCapacity;
+	/// Węzeł, który zostanie odwiedzony jako następny lub @p NO_NODE.
+	NodeIdx next;
+	/// Symbol krawędzi prowadzącej do węzła @p next.
+	char symbol;
+	/// Długość numeru odpowiadającego rodzicowi węzła @p next.
+	size_t parent;
+	/// Czy numer odpowiadający węzłowi @p next został zapisany w @p path.
+	bool written;
+	/// Długość numeru x, dla którego x @p suffix jest bieżącym napisem.
+	size_t head;
+	/// Czy strumień się wyczerpał.
+	bool done;
+} Stream;
+
+/** @brief Iterator po przekierowaniach na dany numer.
+* Scala strumienie numerów wyznaczone dla wszystkich prefixów numeru, na
+* które istnieją przekierowania, oraz strumień złożony z samego numeru.
+*/
+struct ReverseIterator {
+	/// Wskaźnik na pulę węzłów indeksu odwrotnego.
+	NodePool const *pool;
+	/// Kopia numeru, na który szukamy przekierowań.
+	char *num;
+	/// Długość numeru @p num.
+	size_t length;
+	/// Tablica strumieni.
+	Stream *streams;
+	/// Liczba strumieni.
+	size_t count;
+	/// Strumienie, których bieżący napis jest równy zwracanemu numerowi.
+	Stream **ties;
+	/// Bufory @p path wszystkich strumieni.
+	char *paths;
+	/// Bufor, w którym zapisywany jest zwracany numer.
+	char *result;
+	/// Korzeń drzewa przekierowań, gdy zwracane są tylko numery, których
+	/// przekierowaniem jest numer @p num, lub @p NO_NODE.
+	NodeIdx exact;
+	/// Korzeń drzewa przekierowań, gdy indeks odwrotny może zawierać
+	/// nieaktualne klucze, lub @p NO_NODE.
+	NodeIdx live;
+	/// Licznik pominiętych kluczy struktury, gdy indeks odwrotny może
+	/// zawierać nieaktualne klucze, lub NULL.
+	atomic_size_t *skipped;
+	/// Statystyki, w których zapisywany jest czas iteracji, lub NULL, gdy
+	/// czas nie jest mierzony.
+	Stats *stats;
+	/// Rodzaj operacji, jako który liczona jest iteracja.
+	enum PhoneForwardOperation op;
+	/// Łączny czas dotychczasowej iteracji w nanosekundach.
+	uint64_t elapsed;
+};
+
+/** @brief Porównuje dwa napisy złożone z dwóch części.
+* Porównuje leksykograficznie napis złożony z @p n pierwszych znaków @p a
+* oraz napisu @p s z napisem złożonym z @p m pierwszych znaków @p b oraz
+* napisu @p t. Gdy oba napisy zaczynają się w tym samym buforze, ich
+* wspólny początek jest pomijany.
+* @param[in] a - wskaźnik na początek pierwszego napisu.
+* @param[in] n - długość początku pierwszego napisu.
+* @param[in] s - wskaźnik na koniec pierwszego napisu.
+* @param[in] b - wskaźnik na początek drugiego napisu.
+* @param[in] m - długość początku drugiego napisu.
+* @param[in] t - wskaźnik na koniec drugiego napisu.
+* @return Wartość ujemna, zero lub dodatnia, gdy pierwszy napis jest
+*         odpowiednio mniejszy, równy lub większy od drugiego.
+*/
+static int compareParts(char const *a, size_t n, char const *s,
+						char const *b, size_t m, char const *t) {
+	for (size_t i = a == b ? (n < m ? n : m) : 0; ; i++) {
+		char x = i < n ? a[i] : s[i - n];
+		char y = i < m ? b[i] : t[i - m];
+
+		if (x != y || x == '\0')
+			return x - y;
+	}
+}
+
+/** @brief Porównuje dwa oczekujące numery strumienia.
+* @param[in] st - wskaźnik na strumień.
+* @param[in] d1 - długość pierwszego numeru.
+* @param[in] d2 - długość drugiego numeru.
+* @return Wartość ujemna, zero lub dodatnia, gdy napis utworzony z pierwszego
+*         numeru jest odpowiednio mniejszy, równy lub większy od napisu
+*         utworzonego z drugiego.
+*/
+static int comparePending(Stream const *st, size_t d1, size_t d2) {
+	return compareParts(st->path, d1, st->suffix, st->path, d2, st->suffix);
+}
+
+/** @brief Znajduje najmniejszy oczekujący numer strumienia.
+* @param[in] st - wskaźnik na strumień mający oczekujące numery.
+* @return Pozycja najmniejszego numeru w tablicy oczekujących.
+*/
+static size_t minPending(Stream const *st) {
+	size_t best = 0;
+
+	for (size_t i = 1; i < st->pendingSize; i++)
+		if (comparePending(st, st->pending[i], st->pending[best]) < 0)
+			best = i;
+
+	return best;
+}
+
+/** @brief Ustawia bieżący napis strumienia.
+* Usuwa z listy oczekujących numer na pozycji @p i i czyni go bieżącym.
+* @param[in] st - wskaźnik na strumień.
+* @param[in] i - pozycja numeru w tablicy oczekujących.
+*/
+static void emitPending(Stream *st, size_t i) {
+	st->head = st->pending[i];
+	st->pending[i] = st->pending[--st->pendingSize];
+}
+
+/** @brief Odwiedza węzeł poddrzewa strumienia.
+* Dopisuje numer odpowiadający węzłowi do oczekujących, jeśli węzeł ma
+* wartość, i wkłada węzeł na stos, jeśli ma dzieci.
+* @param[in] pool - wskaźnik na pulę węzłów indeksu odwrotnego.
+* @param[in] st - wskaźnik na strumień.
+* @param[in] idx - indeks odwiedzanego węzła.
+* @param[in] depth - długość numeru odpowiadającego węzłowi.
+* @return Wartość @p true, jeśli odwiedzenie się powiodło.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool visitNode(NodePool const *pool, Stream *st, NodeIdx idx, size_t depth) {
+	Node const *node = getNode(pool, idx);
+
+	if (node->value != 0) {
+		if (st->pendingSize == st->pendingCapacity) {
+			size_t capacity = 2 * st->pendingCapacity + 1;
+			size_t *pending = (size_t*)realloc(st->pending, sizeof(size_t) * capacity);
+
+			if (pending == NULL)
+				return false;
+
+			st->pending = pending;
+			st->pendingCapacity = capacity;
+		}
+
+		st->pending[st->pendingSize++] = depth;
+	}
+
+	if (node->mask != 0) {
+		if (st->stackSize == st->stackCapacity) {
+			size_t capacity = 2 * st->stackCapacity + 1;
+			PathEntry *stack = (PathEntry*)realloc(st->stack, sizeof(PathEntry) * capacity);
+
+			if (stack == NULL)
+				return false;
+
+			st->stack = stack;
+			st->stackCapacity = capacity;
+		}
+
+		PathEntry *top = st->stack + st->stackSize++;
+		top->kid = node->kids;
+		top->mask = node->mask;
+		top->depth = depth;
+	}
+
+	return true;
+}
+
+/** @brief Przesuwa strumień do następnego napisu.
+* Przegląda poddrzewo strumienia tak długo, aż najmniejszy z oczekujących
+* napisów nie będzie większy od żadnego z napisów, które może zawierać
+* nieprzejrzana część poddrzewa. Numer, który przestałby być prefixem
+* bufora @p path po zapisaniu w nim następnego węzła, jest zwracany
+* wcześniej: jego napis jest mniejszy od napisów tego węzła.
+* @param[in] pool - wskaźnik na pulę węzłów indeksu odwrotnego.
+* @param[in] st - wskaźnik na strumień.
+* @return Wartość @p true, jeśli udało się wyznaczyć następny napis lub
+*         strumień się wyczerpał.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool advanceStream(NodePool const *pool, Stream *st) {
+	while (true) {
+		if (st->next == NO_NODE) {
+			while (st->stackSize > 0 && st->stack[st->stackSize - 1].mask == 0)
+				st->stackSize--;
+
+			if (st->stackSize == 0) {
+				if (st->pendingSize == 0)
+					st->done = true;
+				else
+					emitPending(st, minPending(st));
+
+				return true;
+			}
+
+			PathEntry *top = st->stack + st->stackSize - 1;
+			st->symbol = '0' + __builtin_ctz(top->mask);
+			st->next = top->kid++;
+			st->parent = top->depth;
+			st->written = false;
+			top->mask &= top->mask - 1;
+		}
+
+		for (size_t i = 0; i < st->pendingSize; i++) {
+			if (st->pending[i] > st->parent) {
+				emitPending(st, minPending(st));
+				return true;
+			}
+		}
+
+		Node const *node = getNode(pool, st->next);
+		size_t depth = st->parent + 1 + node->length;
+
+		if (!st->written) {
+			st->path[st->parent] = st->symbol;
+			memcpy(st->path + st->parent + 1, getLabel(pool, st->next), node->length);
+			st->written = true;
+		}
+
+		if (st->pendingSize > 0) {
+			size_t i = minPending(st);
+
+			if (compareParts(st->path, st->pending[i], st->suffix,
+							 st->path, depth, "") <= 0) {
+				emitPending(st, i);
+				return true;
+			}
+		}
+
+		NodeIdx idx = st->next;
+		st->next = NO_NODE;
+
+		if (!visitNode(pool, st, idx, depth))
+			return false;
+	}
+}
+
+/** @brief Porównuje bieżące napisy dwóch strumieni.
+* @param[in] a - wskaźnik na pierwszy strumień.
+* @param[in] b - wskaźnik na drugi strumień.
+* @return Wartość ujemna, zero lub dodatnia, gdy bieżący napis pierwszego
+*         strumienia jest odpowiednio mniejszy, równy lub większy od
+*         bieżącego napisu drugiego.
+*/
+static int compareStreams(Stream const *a, Stream const *b) {
+	return compareParts(a->path, a->head, a->suffix, b->path, b->head, b->suffix);
+}
+
+/** @brief Sprawdza, czy numer jest przekierowywany na dany numer.
+* Wyznacza przekierowanie numeru @p num tak jak funkcja @ref resolve
+* i porównuje je z numerem @p target bez zapisywania wyniku.
+* @param[in] pool - wskaźnik na pulę węzłów drzewa.
+* @param[in] root - indeks korzenia drzewa przekierowań.
+* @param[in] num - wskaźnik na numer.
+* @param[in] n - długość numeru @p num.
+* @param[in] target - wskaźnik na numer, z którym porównujemy wynik.
+* @param[in] m - długość numeru @p target.
+* @return Wartość @p true, jeśli przekierowaniem numeru @p num jest @p target.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+static bool forwardsTo(NodePool const *pool, NodeIdx root, char const *num,
+					   size_t n, char const *target, size_t m) {
+	size_t len;
+	uint32_t best = findBest(pool, root, num, n, &len);
+	size_t n2 = best == 0 ? 0 : numberSize(pool, best);
+
+	return n2 + n - len == m && memcmp(target, getNumber(pool, best), n2) == 0
+		   && memcmp(target + n2, num + len, n - len) == 0;
+}
+
+/** @brief Tworzy iterator po przekierowaniach na dany numer.
+* @param[in] pf  - wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num - wskaźnik na napis reprezentujący numer.
+* @param[in] n - długość numeru @p num lub @p 0, gdy nie jest on numerem.
+* @param[in] exact - przyjmuje wartość @p true, jeśli iterator ma zwracać
+*                    tylko numery, których przekierowaniem jest @p num.
+* @return Wskaźnik na utworzony iterator lub NULL, gdy nie udało się
+*         zaalokować pamięci.
+*/
+static struct ReverseIterator * reverseIterator(struct PhoneForward *pf,
+												char const *num, size_t n,
+												bool exact) {
+	struct ReverseIterator *it = (struct ReverseIterator*)malloc(sizeof(struct ReverseIterator));
+
+	if (it == NULL)
+		return NULL;
+
+	it->pool = NULL;
+	it->exact = NO_NODE;
+	it->live = NO_NODE;
+	it->skipped = NULL;
+	it->stats = NULL;
+	it->elapsed = 0;
+	it->count = 0;
+	it->num = NULL;
+	it->length = n;
+	it->streams = NULL;
+	it->ties = NULL;
+	it->paths = NULL;
+	it->result = NULL;
+
+	// gdy num nie jest numerem, indeksu odwrotnego nie przeglądamy.
+	if (pf == NULL || n == 0)
+		return it;
+
+	// Nieaktualne klucze odrzuca też sprawdzanie przekierowań.
+	it->pool = pf->pool;
+	it->exact = exact ? pf->root : NO_NODE;
+	it->live = !exact && reclaimPending(pf->reclaim) ? pf->root : NO_NODE;
+	it->skipped = reclaimPending(pf->reclaim) ? &pf->skipped : NULL;
+	NodePool const *pool = it->pool;
+	size_t pathSize = pf->maxSource + 1;
+	size_t count = 1;
+	NodeIdx idx = pf->reverse;
+
+	for (size_t i = 0; i < n; ) {
+		idx = getChild(pool, idx, num[i]);
+
+		if (idx == NO_NODE || !matchLabel(pool, idx, num + i + 1, n - i - 1))
+			break;
+
+		i += 1 + getNode(pool, idx)->length;
+
+		if (getChild(pool, idx, SEPARATOR) != NO_NODE)
+			count++;
+	}
+
+	it->num = (char*)malloc(sizeof(char) * (n + 1));
+	it->streams = (Stream*)malloc(sizeof(Stream) * count);
+	it->ties = (Stream**)malloc(sizeof(Stream*) * count);
+	it->paths = (char*)malloc(sizeof(char) * pathSize * count);
+	it->result = (char*)malloc(sizeof(char) * (pathSize + n));
+
+	if (it->num == NULL || it->streams == NULL || it->ties == NULL
+		|| it->paths == NULL || it->result == NULL) {
+		phrevDelete(it);
+		return NULL;
+	}
+
+	memcpy(it->num, num, n);
+	it->num[n] = '\0';
+
+	// Pierwszy strumień składa się z samego numeru num.
+	for (size_t k = 0; k < count; k++) {
+		Stream *st = it->streams + k;
+		st->suffix = it->num;
+		st->path = it->paths + k * pathSize;
+		st->stack = NULL;
+		st->stackSize = 0;
+		st->stackCapacity = 0;
+		st->pending = NULL;
+		st->pendingSize = 0;
+		st->pendingCapacity = 0;
+		st->next = NO_NODE;
+		st->done = false;
 	}
-	
-	else { //w przeciwnym wypadku wyznaczamy przekierowanie
-		char const *num1 = best->fstNum;
-		char const *num2 = best->sndNum;
-		
-		char *wyn = redirect(num, num1, num2);
-		
-		if (wyn == NULL) {
-			free(ph->numbers);
-			free(ph);
-			return NULL;
+
+	it->count = count;
+	it->streams[0].pending = (size_t*)malloc(sizeof(size_t));
+
+	if (it->streams[0].pending == NULL) {
+		phrevDelete(it);
+		return NULL;
+	}
+
+	it->streams[0].pending[0] = 0;
+	it->streams[0].pendingSize = 1;
+	it->streams[0].pendingCapacity = 1;
+	idx = pf->reverse;
+	count = 1;
+
+	for (size_t i = 0; i < n; ) {
+		idx = getChild(pool, idx, num[i]);
+
+		if (idx == NO_NODE || !matchLabel(pool, idx, num + i + 1, n - i - 1))
+			break;
+
+		i += 1 + getNode(pool, idx)->length;
+		NodeIdx sources = getChild(pool, idx, SEPARATOR);
+
+		if (sources != NO_NODE) {
+			Stream *st = it->streams + count++;
+			Node const *node = getNode(pool, sources);
+			st->suffix = it->num + i;
+			memcpy(st->path, getLabel(pool, sources), node->length);
+
+			if (!visitNode(pool, st, sources, node->length)) {
+				phrevDelete(it);
+				return NULL;
+			}
 		}
-		
-		int n = size(wyn);
-		ph->numbers[0] = (char*)malloc(sizeof(char) * (n + 1));
-		
-		if (ph->numbers[0] == NULL) {
-			free(wyn);
-			free(ph->numbers);
-			free(ph);
+	}
+
+	for (size_t k = 0; k < count; k++) {
+		if (!advanceStream(pool, it->streams + k)) {
+			phrevDelete(it);
 			return NULL;
 		}
-		
-		strcpy(ph->numbers[0], wyn);
-		free(wyn);
 	}
-	
-	ph->size = 1;
-	
-	return ph;
+
+	return it;
 }
 
-/** @brief Znajduje liczbę przekierowań.
-* Znajduje liczbę przekierowań na liczbę @p num w drzewie przekierowań @p pf.
-* @param[in] pf - wskaźnik na korzeń drzewa przekierowań.
-* @param[in] num - wskaźnik na numer, na który przekierowań szukamy.
-* @return Liczba przekierowań na numer num.
+/** @brief Tworzy iterator zapisujący czas iteracji.
+* Iteracja jest liczona w statystykach struktury @p pf jako jedno
+* wywołanie przy tworzeniu iteratora, a jej czas, jeśli jest mierzony,
+* zostaje zapisany, gdy iterator się wyczerpie.
+* @param[in] pf  - wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num - wskaźnik na napis reprezentujący numer.
+* @param[in] exact - przyjmuje wartość @p true, jeśli iterator ma zwracać
+*                    tylko numery, których przekierowaniem jest @p num.
+* @return Wskaźnik na utworzony iterator lub NULL, gdy nie udało się
+*         zaalokować pamięci.
 */
-int findSize(struct PhoneForward *pf, char const *num) {
+static struct ReverseIterator * timedIterator(struct PhoneForward *pf,
+											  char const *num, bool exact) {
 	if (pf == NULL)
-		return 0;
+		return reverseIterator(pf, num, 0, exact);
 
-	int n = 0;
-	if (pf->sndNum != NULL && isPrefix(pf->sndNum, num))
-		n++;
+	enum PhoneForwardOperation op = exact ? PHFWD_GET_REVERSE : PHFWD_REVERSE;
+	uint64_t start = startCall(&pf->stats, op);
+	struct ReverseIterator *it = reverseIterator(pf, num, numberLength(num), exact);
 
-	if (pf->children == NULL)
-		return n;
+	if (it != NULL && start != 0) {
+		it->stats = &pf->stats;
+		it->op = op;
+		it->elapsed = statsClock() - start;
+	}
 
-	for (int i = 0; i < ALPHABET_SIZE; i++) 
-		n += findSize(pf->children[i], num);
+	return it;
+}
 
-	return n;
+struct ReverseIterator * phfwdReverseIterator(struct PhoneForward *pf,
+												char const *num) {
+	return timedIterator(pf, num, false);
 }
 
-/** @brief Wypełnia strukturę przekierowaniami na dany numer.
-* Wypełnia strukturę @p pnum numerami z drzewa przekierowań @p pf, które 
-* zostaną przekierowane na @p num oraz aktualizuje rozmiar struktury.
-* Numery w tablicy struktury @p pnum mogą się powtarzać.
-* @param[in] pf - wskaźnik na korzeń drzewa przekierowań.
-* @param[in] num - wskaźnik na numer, na który zostaną przekierowane elementy
-* 		     wrzucane do tablicy.
-* @param[in] pnum - struktura do której wpisywane są numery spełniające wyżej
-*			 opisane warunki.
-* @return Wartość @p true jeżeli wypełnianie struktury się powiodło lub 
-* 		  Wartość @p false gdy nie udało się zaalokować pamięci.
+struct ReverseIterator * phfwdGetReverseIterator(struct PhoneForward *pf,
+												   char const *num) {
+	return timedIterator(pf, num, true);
+}
+
+/** @brief Podaje kolejny numer z iteratora.
+* Wykonuje operację funkcji @ref phrevNext bez zapisywania jej czasu.
+* @param[in,out] it - wskaźnik na iterator;
+* @param[out] num   - wskaźnik na kolejny numer lub NULL.
+* @return Wartość @p false, gdy nie udało się zaalokować pamięci.
+*         Wartość @p true w przeciwnym przypadku.
 */
-bool fill(struct PhoneForward *pf, char const *num, struct PhoneNumbers *pnum) {
-	if (pf == NULL)
-		return true;
+static bool nextReverse(struct ReverseIterator *it, char const **num) {
+	*num = NULL;
+	size_t skipped = 0;
+	bool result = true;
 
-	if (pf->children != NULL) {
-		for (int i = 0; i < ALPHABET_SIZE; i++) {
-			bool b = fill(pf->children[i], num, pnum);
+	while (result && *num == NULL) {
+		Stream *best = NULL;
+		size_t ties = 0;
 
-			if (!b)
-				return false;
+		// Ten sam numer może występować w kilku strumieniach.
+		for (size_t k = 0; k < it->count; k++) {
+			Stream *st = it->streams + k;
+
+			if (st->done)
+				continue;
+
+			int cmp = best == NULL ? -1 : compareStreams(st, best);
+
+			if (cmp < 0) {
+				best = st;
+				ties = 0;
+			}
+
+			if (cmp <= 0)
+				it->ties[ties++] = st;
+		}
+
+		if (best == NULL)
+			break;
+
+		size_t tail = it->length - (best->suffix - it->num);
+		size_t length = best->head + tail;
+		memcpy(it->result, best->path, best->head);
+		memcpy(it->result + best->head, best->suffix, tail + 1);
+		bool live = it->live == NO_NODE;
+
+		// Numer jest zwracany, jeśli pochodzi z aktualnego klucza któregoś
+		// strumienia; pierwszy strumień nie pochodzi z indeksu odwrotnego.
+		for (size_t k = 0; !live && k < ties; k++) {
+			Stream const *st = it->ties[k];
+			live = st == it->streams
+				   || liveKey(it->pool, it->live, st->path, st->head, it->num,
+							  st->suffix - it->num);
 		}
+
+		for (size_t k = 0; result && k < ties; k++)
+			result = advanceStream(it->pool, it->ties[k]);
+
+		// Numer x przekierowany na prefix p numeru num = p t daje numer x t,
+		// ale dłuższy prefix x t może mieć własne przekierowanie.
+		if (result && live
+			&& (it->exact == NO_NODE
+				|| forwardsTo(it->pool, it->exact, it->result, length, it->num,
+							  it->length)))
+			*num = it->result;
+		else
+			skipped++;
 	}
 
-	if (pf->sndNum != NULL && isPrefix(pf->sndNum, num)) {
-		int c = size(num) + size(pf->fstNum) - size(pf->sndNum) + 1;
-		pnum->numbers[pnum->size] = (char*)malloc(sizeof(char) * c);
-		
-		if (pnum->numbers[pnum->size] == NULL)
-			return false;
-		
-		char *redirection = redirect(num, pf->sndNum, pf->fstNum);
+	if (it->skipped != NULL && skipped > 0)
+		atomic_fetch_add_explicit(it->skipped, skipped, memory_order_relaxed);
 
-		if (redirection == NULL)
-			return false;
+	return result;
+}
+
+bool phrevNext(struct ReverseIterator *it, char const **num) {
+	if (it->stats == NULL)
+		return nextReverse(it, num);
+
+	uint64_t start = statsClock();
+	bool result = nextReverse(it, num);
+	it->elapsed += statsClock() - start;
 
-		strcpy(pnum->numbers[pnum->size], redirection);
-		free(redirection);
-		pnum->size++;
+	if (!result || *num == NULL) {
+		recordTime(it->stats, it->op, it->elapsed);
+		it->stats = NULL;
 	}
-	
-	return true;
+
+	return result;
 }
 
+void phrevDelete(struct ReverseIterator *it) {
+	if (it == NULL)
+		return;
 
-/** @brief Komparator.
-* Funkcja porównuąca dwa napisy, użyta dalej jako parametr funkcji qsort.
-* @param[in] a - wskaźnik na wskaźnik reprezentujący pierwszy napis.
-* @param[in] b - wskaźnik na wskaźnik reprezentujący drugi napis.
-* @return Wartość @p -1, gdy @p a jest przed @p b w porządku leksykograficznym,
-*         Wartość @p 1, gdy @p a jest po @p b w porządku leksykograficznym,
-*		  Wartość @p 0, gdy napisy są identyczne.
-*/
-int cmpfunc (const void *a, const void *b) {
-	char **xs = (char **)a;
-	char **ys = (char **)b;
-	char *as = xs[0];
-	char *bs = ys[0];
-	
-	for (; *as == *bs; as++, bs++)
-		if (*as == '\0')
-			return 0;
-	
-	return *as - *bs;
+	if (it->streams != NULL) {
+		for (size_t k = 0; k < it->count; k++) {
+			free(it->streams[k].stack);
+			free(it->streams[k].pending);
+		}
+	}
+
+	free(it->streams);
+	free(it->ties);
+	free(it->paths);
+	free(it->result);
+	free(it->num);
+	free(it);
 }
 
-struct PhoneNumbers const * phfwdReverse(struct PhoneForward *pf, char const *num) {
-	int n = findSize(pf, num);
+/** @brief Wyznacza numery z iteratora po przekierowaniach na dany numer.
+* @param[in] pf  - wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num - wskaźnik na napis reprezentujący numer.
+* @param[in] n - długość numeru @p num lub @p 0, gdy nie jest on numerem.
+* @param[in] exact - przyjmuje wartość @p true, jeśli wynik ma zawierać
+*                    tylko numery, których przekierowaniem jest @p num.
+* @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+*         udało się zaalokować pamięci.
+*/
+static struct PhoneNumbers const * reverseNumbers(struct PhoneForward *pf,
+												  char const *num, size_t n,
+												  bool exact) {
+	// gdy num nie jest numerem, indeksu odwrotnego nie przeglądamy.
+	bool number = pf != NULL && n > 0;
+	size_t count = number ? findSize(pf->pool, pf->reverse, num, n) : 0;
 	struct PhoneNumbers *ph = (struct PhoneNumbers*)malloc(sizeof(struct PhoneNumbers));
 	
 	if (ph == NULL)
 		return NULL;
 	
-	ph->numbers = (char**)malloc(sizeof(char *) * (n + 1));
+	ph->numbers = (char**)malloc(sizeof(char *) * (count + 1));
 	
 	if (ph->numbers == NULL) {
 		free(ph);
 		return NULL;
 	}
 	
-	if (!isNumber(num)) { // gdy num nie jest numerem.
-		ph->size = 0;
+	ph->size = 0;
+
+	if (!number) // gdy num nie jest numerem.
 		return ph;
-	}
-	
-	//wypełniamy ph żądanymi numerami.
-	ph->numbers[0] = (char*)malloc(sizeof(char) * (size(num) + 1));
-	
-	if (ph->numbers[0] == NULL) {
-		free(ph->numbers);
-		free(ph);
-		return NULL;
-	}
 	
-	strcpy(ph->numbers[0], (char *)num);
-	ph->size = 1;
-	bool b = fill(pf, num, ph);
-	
-	if (b == false) {
+	struct ReverseIterator *it = reverseIterator(pf, num, n, exact);
+
+	if (it == NULL) {
 		phnumDelete(ph);
 		return NULL;
 	}
-	
-	//posortowanie tablicy i usunięcie powtórzeń.
-	qsort(ph->numbers, ph->size, sizeof(char*), cmpfunc);
-	
-	char **result = (char**)malloc(sizeof(char*) * ph->size);
-	
-	if (result == NULL) {
+
+	// numery przychodzą posortowane i bez powtórzeń.
+	char const *number2;
+	bool b;
+
+	while ((b = nextReverse(it, &number2)) && number2 != NULL) {
+		char *copy = (char*)malloc(sizeof(char) * (size(number2) + 1));
+
+		if (copy == NULL) {
+			b = false;
+			break;
+		}
+
+		strcpy(copy, number2);
+		ph->numbers[ph->size++] = copy;
+	}
+
+	phrevDelete(it);
+
+	if (!b) {
 		phnumDelete(ph);
 		return NULL;
 	}
 	
-	int a = ph->size;
-	int minus = 0;
-	
-	for (int i = 0; i < a; i++) {
-		if (i > 0 && strcmp(ph->numbers[i], ph->numbers[i - 1]) == 0) {
-			minus ++;
-			
+	return ph;
+}
+
+/** @brief Wyznacza przekierowania na dany numer, zapisując czas operacji.
+* @param[in] pf  - wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num - wskaźnik na napis reprezentujący numer.
+* @param[in] n - długość numeru @p num lub @p 0, gdy nie jest on numerem.
+* @param[in] exact - przyjmuje wartość @p true, jeśli wynik ma zawierać
+*                    tylko numery, których przekierowaniem jest @p num.
+* @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+*         udało się zaalokować pamięci.
+*/
+static struct PhoneNumbers const * timedReverse(struct PhoneForward *pf,
+												char const *num, size_t n,
+												bool exact) {
+	if (pf == NULL)
+		return reverseNumbers(pf, num, 0, exact);
+
+	enum PhoneForwardOperation op = exact ? PHFWD_GET_REVERSE : PHFWD_REVERSE;
+	uint64_t start = startCall(&pf->stats, op);
+	struct PhoneNumbers const *ph = reverseNumbers(pf, num, n, exact);
+	endCall(&pf->stats, op, start);
+
+	return ph;
+}
+
+struct PhoneNumbers const * phfwdReverse(struct PhoneForward *pf, char const *num) {
+	return timedReverse(pf, num, numberLength(num), false);
+}
+
+struct PhoneNumbers const * phfwdReverseN(struct PhoneForward *pf,
+										  char const *num, size_t n) {
+	return timedReverse(pf, num, spanLength(num, n), false);
+}
+
+struct PhoneNumbers const * phfwdGetReverse(struct PhoneForward *pf, char const *num) {
+	return timedReverse(pf, num, numberLength(num), true);
+}
+
+/** @brief Prefix numeru, na który istnieją przekierowania.
+* Dla numeru zapytania przechowuje węzeł indeksu odwrotnego odpowiadający
+* jego prefixowi, który ma poddrzewo numerów przekierowanych na ten prefix.
+*/
+typedef struct Prefix {
+	/// Indeks węzła indeksu odwrotnego.
+	NodeIdx node;
+	/// Długość prefixu.
+	size_t end;
+} Prefix;
+
+/** @brief Sprawdza, czy numer był już liczony dla krótszego prefixu.
+* Numer x przekierowany na prefix @p prefixes[k] daje ten sam wynik co numer
+* y przekierowany na krótszy prefix @p prefixes[j] wtedy i tylko wtedy, gdy
+* x = y t, gdzie t jest częścią numeru @p num między końcami tych prefixów.
+* @param[in] pool - wskaźnik na pulę węzłów indeksu odwrotnego.
+* @param[in] key - bufor zawierający separator i numer x.
+* @param[in] len - długość zawartości bufora.
+* @param[in] prefixes - tablica prefixów numeru @p num.
+* @param[in] k - pozycja prefixu, na który przekierowany jest x.
+* @param[in] num - wskaźnik na numer zapytania.
+* @param[in] live - indeks korzenia drzewa przekierowań, gdy indeks odwrotny
+*                   może zawierać nieaktualne klucze, lub @p NO_NODE.
+* @return Wartość @p true, jeśli numer y istnieje.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+static bool countedBefore(NodePool const *pool, char const *key, size_t len,
+						  Prefix const *prefixes, size_t k, char const *num,
+						  NodeIdx live) {
+	for (size_t j = 0; j < k; j++) {
+		size_t t = prefixes[k].end - prefixes[j].end;
+
+		if (len <= t + 1 || memcmp(key + len - t, num + prefixes[j].end, t) != 0)
 			continue;
+
+		NodeIdx idx = findKey(pool, prefixes[j].node, key, len - t);
+
+		if (idx != NO_NODE && getNode(pool, idx)->value != 0
+			&& (live == NO_NODE || liveKey(pool, live, key + 1, len - t - 1,
+										   num, prefixes[j].end)))
+			return true;
+	}
+
+	return false;
+}
+
+/** @brief Zlicza różne numery przekierowane na dany numer.
+* Zlicza numery z poddrzewa indeksu odwrotnego o korzeniu @p idx, pomijając
+* te, których wynik został już policzony dla krótszego prefixu.
+* @param[in] pool - wskaźnik na pulę węzłów indeksu odwrotnego.
+* @param[in] idx - indeks korzenia poddrzewa.
+* @param[in] key - bufor zawierający separator i początek numerów
+*                  poprzedzający etykietę krawędzi do węzła @p idx.
+* @param[in] depth - długość zawartości bufora.
+* @param[in] prefixes - tablica prefixów numeru @p num.
+* @param[in] k - pozycja prefixu, na który przekierowane są numery poddrzewa.
+* @param[in] num - wskaźnik na numer zapytania.
+* @param[in] live - indeks korzenia drzewa przekierowań, gdy indeks odwrotny
+*                   może zawierać nieaktualne klucze, lub @p NO_NODE.
+* @param[in,out] skipped - licznik pominiętych nieaktualnych kluczy.
+* @return Liczba zliczonych numerów.
+*/
+static size_t countDistinct(NodePool const *pool, NodeIdx idx, char *key,
+							size_t depth, Prefix const *prefixes, size_t k,
+							char const *num, NodeIdx live, size_t *skipped) {
+	Node const *node = getNode(pool, idx);
+	memcpy(key + depth, getLabel(pool, idx), node->length);
+	depth += node->length;
+	size_t n = 0;
+	bool stale = node->value != 0 && live != NO_NODE
+				 && !liveKey(pool, live, key + 1, depth - 1, num,
+							 prefixes[k].end);
+
+	if (stale)
+		(*skipped)++;
+	else if (node->value != 0
+			 && !countedBefore(pool, key, depth, prefixes, k, num, live))
+		n++;
+
+	NodeIdx kids = node->kids;
+
+	for (int i = 0; i < ALPHABET_SIZE; i++) {
+		if ((node->mask & (1u << i)) != 0) {
+			key[depth] = '0' + i;
+			n += countDistinct(pool, kids++, key, depth + 1, prefixes, k, num,
+							   live, skipped);
 		}
-		
-		result[i - minus] = (char*)malloc(sizeof(char) * (size(ph->numbers[i]) + 1));
-		
-		if (result[i - minus] == NULL) {
-			phnumDelete(ph);
-			
-			for (int j = 0; j < i - minus; i++)
-				free(result[j]);
-			free (result);
-			return NULL;
-		}
-		
-		strcpy(result[i - minus], ph->numbers[i]);
 	}
-	
-	for (size_t i = 0; i < ph->size; i++)
-		free(ph->numbers[i]);
-	
-	free(ph->numbers);
-	ph->size -= minus;
-	ph->numbers = (char**)malloc(sizeof(char*) * ph->size);
-	
-	if (ph->numbers == NULL) {
-		for (size_t i = 0; i < ph->size; i++)
-			free(result[i]);
-		free(result);
-		free(ph);
-		return NULL;
+
+	return n;
+}
+
+/** @brief Zlicza przekierowania na dany numer.
+* Wykonuje operację funkcji @ref phfwdReverseCount bez zapisywania jej czasu.
+* @param[in] pf  - wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num - wskaźnik na napis reprezentujący numer.
+* @return Liczba numerów, które zwróciłaby funkcja @ref phfwdReverse.
+*/
+static size_t countReverse(struct PhoneForward *pf, char const *num) {
+	size_t length = numberLength(num);
+
+	if (length == 0)
+		return 0;
+
+	NodePool const *pool = pf->pool;
+	NodeIdx live = reclaimPending(pf->reclaim) ? pf->root : NO_NODE;
+	Prefix *prefixes = (Prefix*)malloc(sizeof(Prefix) * length);
+	char *key = (char*)malloc(sizeof(char) * (pf->maxSource + 2));
+
+	if (prefixes == NULL || key == NULL) {
+		free(prefixes);
+		free(key);
+		return 0;
 	}
-	
-	for (size_t i = 0; i < ph->size; i++) {
-		ph->numbers[i] = (char*)malloc(sizeof(char) * (size(result[i]) + 1));
-		
-		if (ph->numbers[i] == NULL) {
-			for (size_t j = 0; j < ph->size; j++)
-				free(result[i]);
-			free(result);
 
-			for (size_t j = 0; j < i; j++)
-				free(ph->numbers[i]);
+	// sam numer num nie jest przekierowany na żaden swój prefix.
+	size_t n = 1;
+	size_t count = 0;
+	size_t skipped = 0;
+	NodeIdx idx = pf->reverse;
+	key[0] = SEPARATOR;
 
-			free(ph->numbers);
-			free(ph);
-			return NULL;
+	for (size_t i = 0; i < length; ) {
+		idx = getChild(pool, idx, num[i]);
+
+		if (idx == NO_NODE || !matchLabel(pool, idx, num + i + 1, length - i - 1))
+			break;
+
+		i += 1 + getNode(pool, idx)->length;
+		NodeIdx sources = getChild(pool, idx, SEPARATOR);
+
+		if (sources != NO_NODE) {
+			prefixes[count].node = idx;
+			prefixes[count].end = i;
+			n += countDistinct(pool, sources, key, 1, prefixes, count, num,
+							   live, &skipped);
+			count++;
 		}
-		
-		strcpy(ph->numbers[i], result[i]);
 	}
-	
-	for (size_t i = 0; i < ph->size; i++)
-		free(result[i]);
-	
-	free(result);
-	
-	return ph;
+
+	free(prefixes);
+	free(key);
+	addSkipped(pf, skipped);
+
+	return n;
+}
+
+size_t phfwdReverseCount(struct PhoneForward *pf, char const *num) {
+	if (pf == NULL)
+		return 0;
+
+	uint64_t start = startCall(&pf->stats, PHFWD_REVERSE_COUNT);
+	size_t n = countReverse(pf, num);
+	endCall(&pf->stats, PHFWD_REVERSE_COUNT, start);
+
+	return n;
 }
 
 char const * phnumGet(struct PhoneNumbers const *pnum, size_t idx) {
@@ -596,202 +2392,277 @@ void phnumDelete(struct PhoneNumbers const *pnum){
 	free((void*)pnum);
 }
 
-/** @brief Znajduje cyfry w napisie.
-* Dla podanego napisu @p set wyznacza cyfry, które należą do tego napisu.
+/** @brief Wyznacza maskę cyfr napisu.
 * @param[in] set - wskaźnik na zbiór, w którym szukamy cyfr.
-* @return Wskaźnik na tablicę booli długości ALPHABET_SIZE, w której na 
-* 		  i-tym miejscu jest wartość @p true wtedy i tylko wtedy, gdy @p set 
-*		  zawiera cyfrę i (lub : dla i = 10, lub ; dla i = 11). 		
+* @return Maska, w której i-ty bit jest zapalony wtedy i tylko wtedy, gdy
+*         @p set zawiera cyfrę i (lub : dla i = 10, lub ; dla i = 11).
 */
-bool * getDigits(char const *set) {
-	bool *present = (bool*)malloc(sizeof(bool) * ALPHABET_SIZE);
-
-	if (present == NULL)
-		return NULL;
+uint16_t getDigits(char const *set) {
+	uint16_t mask = 0;
 
-	for (size_t i = 0; i < ALPHABET_SIZE; i++)
-		present[i] = false;
-
-	for (size_t i = 0; i < size(set); i++) 
+	for (size_t i = 0; set[i] != '\0'; i++)
 		if (set[i] >= '0' && set[i] < '0' + ALPHABET_SIZE)
-			present[set[i] - '0'] = true;
+			mask |= 1u << (set[i] - '0');
 
-	return present;
+	return mask;
 }
 
-/** @brief Znajduje liczbę wartości @p true.
-* Dla tablicy booli długości ALPHABET_SIZE znajduje liczbę 
-* wartości @p true.
-* @param[in] present - wskaźnik na tablicę booli.
-* @return Liczba wartości @p true w tablicy.
+/** @brief Potęgowanie.
+* Podnosi liczbę @p x do potęgi @p n.
+* @param[in] x - liczba potęgowana.
+* @param[in] n - wykładnik.
+* @return Wynik działania.
 */
-size_t digitsNumber (bool const *present) {
-	size_t result = 0;
+size_t power (size_t x, size_t n) {
+	if (n == 0)
+		return 1;
+
+	if (n % 2 != 0)
+		return x * power(x, n - 1);
 
-	for (size_t i = 0; i < ALPHABET_SIZE; i++)
-		if (present[i])
-			result++;
+	size_t a = power(x, n / 2);
 
-	return result;
+	return a * a;
 }
 
-/** @brief Sprawdza czy liczba składa się z podanych cyfr.
-* Sprawdza, czy liczba zawiera tylko takie cyfry i, dla których
-* @p present[i] = true
-* @param[in] number - wskaźnik na liczbę
-* @param[in] present - wskaźnik na tablicę booli.
-* @return Wartość @p true, jeśli @p number zawiera tylko cyfry zakodowane
-*  		  w tablicy @p present lub wartość @p false w przeciwnym przypadku.
+/** @brief Sprawdza, czy na numer jest przekierowany jakiś numer.
+* Szuka w poddrzewie numerów przekierowanych na numer y aktualnego klucza
+* indeksu odwrotnego.
+* @param[in] pool - wskaźnik na pulę węzłów drzewa.
+* @param[in] idx - indeks węzła poddrzewa.
+* @param[in] live - indeks korzenia drzewa przekierowań.
+* @param[in,out] key - bufor zawierający numer y, separator i początek numeru
+*                      x poprzedzający etykietę krawędzi do węzła @p idx.
+* @param[in] target - długość numeru y.
+* @param[in] depth - długość zawartości bufora.
+* @param[in,out] skipped - licznik pominiętych nieaktualnych kluczy.
+* @return Wartość @p true, jeśli poddrzewo zawiera aktualny klucz.
+*         Wartość @p false w przeciwnym przypadku.
 */
-bool isOk (char const *number, bool const *present) {
-	size_t n = size(number);
+static bool anyLive(NodePool const *pool, NodeIdx idx, NodeIdx live, char *key,
+					size_t target, size_t depth, size_t *skipped) {
+	Node const *node = getNode(pool, idx);
+	memcpy(key + depth, getLabel(pool, idx), node->length);
+	depth += node->length;
+
+	if (node->value != 0) {
+		if (liveKey(pool, live, key + target + 1, depth - target - 1, key,
+					target))
+			return true;
+
+		(*skipped)++;
+	}
 
-	for (size_t i = 0; i < n; i++) 
-		if (!present[number[i] - '0'])
-			return false;
+	NodeIdx kids = node->kids;
 
-	return true;
+	for (int i = 0; i < ALPHABET_SIZE; i++) {
+		if ((node->mask & (1u << i)) != 0) {
+			key[depth] = '0' + i;
+
+			if (anyLive(pool, kids++, live, key, target, depth + 1, skipped))
+				return true;
+		}
+	}
+
+	return false;
 }
 
-/** @brief Znajduje liczbę prefixów zawierających tylko określone znaki.
-* Znajduje w drzewie @p pf liczbę prefixów długości niewiększej niż @p len, 
-* na które istnieje przekierowanie i których zapis składa się wyłącznie z cyfr 
-* i takich, że present[i] = true.
-* @param [in] pf - Wskaźnik na drzewo z przekierowaniami.
-* @param [in] present - tablica booli, koduje dozwolone znaki.
-* @param [in] len - maksymalna dozwolona długość prefixu.
-* @return liczba prefixów spełniających powyższe warunki.
+/** @brief Zlicza nietrywialne numery w poddrzewie indeksu odwrotnego.
+* Przegląda poddrzewo indeksu odwrotnego o korzeniu @p idx, schodząc tylko
+* krawędziami etykietowanymi dozwolonymi cyframi, i zatrzymuje się na
+* numerach docelowych, które są minimalne ze względu na relację prefixu.
+* Każdy taki numer t jest prefixem @p digits^(len - |t|) nietrywialnych
+* numerów.
+* @param[in] pool - wskaźnik na pulę węzłów indeksu odwrotnego.
+* @param[in] idx - indeks korzenia poddrzewa.
+* @param[in] allowed - maska dozwolonych cyfr.
+* @param[in] digits - liczba dozwolonych cyfr.
+* @param[in] depth - długość numeru odpowiadającego węzłowi @p idx.
+* @param[in] len - długość zliczanych numerów.
+* @param[in] live - indeks korzenia drzewa przekierowań, gdy indeks odwrotny
+*                   może zawierać nieaktualne klucze, lub @p NO_NODE.
+* @param[in,out] key - bufor zawierający numer odpowiadający węzłowi @p idx
+*                      lub NULL, gdy @p live jest równe @p NO_NODE.
+* @param[in,out] skipped - licznik pominiętych nieaktualnych kluczy.
+* @return Liczba nietrywialnych numerów o prefixach z poddrzewa.
 */
-size_t findNonTrivialPrefixNumber (struct PhoneForward *pf, bool *present, size_t len) {
-	if (pf == NULL)
-		return 0;
+static size_t countNonTrivial(NodePool const *pool, NodeIdx idx, uint16_t allowed,
+							  size_t digits, size_t depth, size_t len,
+							  NodeIdx live, char *key, size_t *skipped) {
+	NodeIdx sources = getChild(pool, idx, SEPARATOR);
+
+	if (sources != NO_NODE && live != NO_NODE) {
+		key[depth] = SEPARATOR;
+
+		if (!anyLive(pool, sources, live, key, depth, depth + 1, skipped))
+			sources = NO_NODE;
+	}
 
+	if (sources != NO_NODE)
+		return power(digits, len - depth);
+
+	Node const *node = getNode(pool, idx);
+	uint16_t mask = node->mask & allowed;
 	size_t result = 0;
 
-	if (pf->sndNum != NULL && size(pf->sndNum) <= len && isOk(pf->sndNum, present))
-		result++;
+	while (mask != 0) {
+		uint16_t bit = mask & -mask;
+		NodeIdx kid = node->kids + __builtin_popcount(node->mask & (bit - 1));
+		Node const *child = getNode(pool, kid);
+		char const *label = getLabel(pool, kid);
+		bool ok = depth + 1 + child->length <= len;
 
-	if (pf->children == NULL)
-		return result;
-	
-	for (size_t i = 0; i < ALPHABET_SIZE; i++) 
-		result += findNonTrivialPrefixNumber(pf->children[i], present, len);
+		for (uint16_t i = 0; ok && i < child->length; i++)
+			ok = (allowed & (1u << (label[i] - '0'))) != 0;
+
+		if (ok && key != NULL) {
+			key[depth] = '0' + __builtin_ctz(bit);
+			memcpy(key + depth + 1, label, child->length);
+		}
+
+		if (ok)
+			result += countNonTrivial(pool, kid, allowed, digits,
+									  depth + 1 + child->length, len, live, key,
+									  skipped);
+
+		mask &= mask - 1;
+	}
 
 	return result;
 }
 
-/** @brief Wypełnia strukturę PhoneNumbers numerami.
-* Wypełnia @p pnum prefixami długości nieprzekraczajączej @p len będącymi 
-* przekierowaniami z pewnego numeru w drzewie @p pf, które zawierają cyfrę
-* i tylko wtedy, gdy @p present[i] = true.
-* @param[in] pf - wskaźnik na drzewo przekierowań.
-* @param[in] present - tablica booli określająca dozwolone znaki.
-* @param [in] len - maksymalna dozwolona długość prefixu.
-* @param [in] pnum - struktura, do której wpisujemy dobre prefixy.
-* @return Wartość @p true, jeśli udało się wypełnić @p pnum numerami, lub
-* 		  wartość @p false, gdy nie udało się zaalokować pamięci.   
+/** @brief Zlicza nietrywialne numery.
+* Wykonuje operację funkcji @ref phfwdNonTrivialCount bez zapisywania jej
+* czasu.
+* @param[in] pf  - wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] set - wskaźnik na napis reprezentujący zbiór cyfr;
+* @param[in] len - długość numerów.
+* @return Liczba nietrywialnych numerów.
 */
-bool fillNonTrivial(struct PhoneForward *pf, bool *present,
-							 size_t len, struct PhoneNumbers *pnum) {
-	if (pf == NULL)
-		return true;
+static size_t nonTrivialCount(struct PhoneForward *pf, char const *set, size_t len) {
+	if (set == NULL || len == 0)
+		return 0;
 
-	if (pf->children != NULL) {
-		for (size_t i = 0; i < ALPHABET_SIZE; i++) {
-			bool b = fillNonTrivial(pf->children[i], present, len, pnum);
+	uint16_t allowed = getDigits(set);
 
-			if (!b)
-				return false;
-		}
-	}
+	if (allowed == 0)
+		return 0;
 
-	if (pf->sndNum != NULL && size(pf->sndNum) <= len && isOk(pf->sndNum, present)) {
-		size_t l = size(pf->sndNum) + 1;
-		pnum->numbers[pnum->size] = (char*)malloc(sizeof(char) * l);
+	Memo *memo = pf->memo + (allowed * 31 + len) % MEMO_SIZE;
 
-		if (pnum->numbers[pnum->size] == NULL)
-			return false;
+	if (memo->generation == pf->generation && memo->mask == allowed
+		&& memo->len == len)
+		return memo->result;
 
-		strcpy(pnum->numbers[pnum->size], pf->sndNum);
-		pnum->size++;
-	}
+	NodeIdx live = NO_NODE;
+	char *key = NULL;
 
-	return true;
-}
+	// Bufor mieści numer docelowy, separator i numer przekierowywany.
+	if (reclaimPending(pf->reclaim)) {
+		key = (char*)malloc(sizeof(char) * (pf->maxTarget + 1 + pf->maxSource));
 
-/** @brief Potęgowanie.
-* Podnosi liczbę @p x do potęgi @p n.
-* @param[in] x - liczba potęgowana.
-* @param[in] n - wykładnik.
-* @return Wynik działania.
-*/
-size_t power (size_t x, size_t n) {
-	if (n == 0)
-		return 1;
+		if (key == NULL)
+			return 0;
 
-	if (n % 2 != 0)
-		return x * power(x, n - 1);
+		live = pf->root;
+	}
 
-	size_t a = power(x, n / 2);
+	size_t skipped = 0;
+	size_t result = countNonTrivial(pf->pool, pf->reverse, allowed,
+									__builtin_popcount(allowed), 0, len, live, key,
+									&skipped);
+	free(key);
+	addSkipped(pf, skipped);
+	memo->generation = pf->generation;
+	memo->mask = allowed;
+	memo->len = len;
+	memo->result = result;
 
-	return a * a;
+	return result;
 }
 
 size_t phfwdNonTrivialCount(struct PhoneForward *pf, char const *set, size_t len) {
-	if (pf == NULL || set == NULL || len == 0)
+	if (pf == NULL)
 		return 0;
 
-	bool *present = getDigits(set);
+	uint64_t start = startCall(&pf->stats, PHFWD_NON_TRIVIAL_COUNT);
+	size_t n = nonTrivialCount(pf, set, len);
+	endCall(&pf->stats, PHFWD_NON_TRIVIAL_COUNT, start);
 
-	if (present == NULL)
-		exit(1);
+	return n;
+}
 
-	size_t goodDigits = digitsNumber(present);
+/** @brief Wyznacza rozmiar poddrzewa.
+* Zwiększa @p nodes o liczbę węzłów poddrzewa, a @p maxDepth podnosi do
+* długości najdłuższego klucza w poddrzewie.
+* @param[in] pool - wskaźnik na pulę węzłów drzewa.
+* @param[in] idx - indeks korzenia poddrzewa.
+* @param[in] depth - długość klucza odpowiadającego korzeniowi poddrzewa.
+* @param[in,out] nodes - liczba węzłów.
+* @param[in,out] maxDepth - długość najdłuższego klucza.
+*/
+static void measureTree(NodePool const *pool, NodeIdx idx, size_t depth,
+						size_t *nodes, size_t *maxDepth) {
+	Node const *node = getNode(pool, idx);
+	uint32_t kids = __builtin_popcount(node->mask);
+	(*nodes)++;
+
+	if (depth > *maxDepth)
+		*maxDepth = depth;
+
+	for (uint32_t i = 0; i < kids; i++)
+		measureTree(pool, node->kids + i,
+					depth + 1 + getNode(pool, node->kids + i)->length,
+					nodes, maxDepth);
+}
 
-	if (goodDigits == 0)
-		return 0;
+bool phfwdStats(struct PhoneForward *pf, struct PhoneForwardStats *stats) {
+	if (pf == NULL || stats == NULL)
+		return false;
 
-	size_t n = findNonTrivialPrefixNumber(pf, present, len);
-	struct PhoneNumbers *pnum = (struct PhoneNumbers*)malloc(sizeof(struct PhoneNumbers));
+	NodePool const *pool = pf->pool;
+	size_t reverseDepth = 0;
+	collectStats(&pf->stats, stats);
+	stats->nodes = 0;
+	stats->maxDepth = 0;
+	measureTree(pool, pf->root, 0, &stats->nodes, &stats->maxDepth);
+	measureTree(pool, pf->reverse, 0, &stats->nodes, &reverseDepth);
+	stats->nodeBytes = pool->capacity * sizeof(Node);
+	stats->stringBytes = pool->charsCapacity + pool->labelsCapacity;
 
-	if (pnum == NULL) {
-		free(present);
-		exit(1);
-	}
+	return true;
+}
 
-	pnum->numbers = (char**)malloc(sizeof(char*) * n);
+bool phfwdStrideIndex(struct PhoneForward *pf, bool enable) {
+	if (pf == NULL)
+		return false;
 
-	if(pnum->numbers == NULL) {
-		free(present);
-		free(pnum);
-		exit(1);
+	if (!enable) {
+		clearStrideIndex(pf->stride);
+		pf->stride = NULL;
 	}
-
-	pnum->size = 0;
-
-	bool b = fillNonTrivial(pf, present, len, pnum);
-
-	if (!b) {
-		phnumDelete(pnum);
-		free(present);
-		exit(1);
+	else if (pf->stride == NULL) {
+		pf->stride = newStrideIndex(pf->pool, pf->root);
 	}
 
-	free(present);
-	qsort(pnum->numbers, pnum->size, sizeof(char*), cmpfunc);
-	size_t result = 0;
+	return !enable || pf->stride != NULL;
+}
 
-	size_t j = pnum->size;
+bool phfwdCache(struct PhoneForward *pf, bool enable) {
+	if (pf == NULL)
+		return false;
 
-	for (size_t i = 0; i < pnum->size; i++) { 
-		if ((j == pnum->size || !isPrefix(pnum->numbers[j], pnum->numbers[i]))) {
-			result += 
-			power(goodDigits, (size_t)(len - size(pnum->numbers[i])));
-			j = i;
-		}
+	if (!enable) {
+		clearNumberCache(pf->cache);
+		pf->cache = NULL;
+	}
+	else if (pf->cache == NULL) {
+		pf->cache = newNumberCache();
 	}
 
-	phnumDelete(pnum);
+	return !enable || pf->cache != NULL;
+}
 
-	return result;
-}	
+bool phfwdReclaim(struct PhoneForward *pf) {
+	return pf != NULL && reclaimStep(pf, RECLAIM_SLICE);
+}
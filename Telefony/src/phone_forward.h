@@ -11,6 +11,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 /// Liczba dostępnych cyfr.
@@ -23,6 +24,51 @@ struct PhoneForward;
 /// Struktura przechowująca ciąg numerów telefonów.
 struct PhoneNumbers;
 
+/// Iterator po przekierowaniach na dany numer.
+struct ReverseIterator;
+
+/// Rodzaje operacji, dla których zbierane są statystyki.
+enum PhoneForwardOperation {
+	PHFWD_ADD,               ///< funkcje phfwdAdd i phfwdAddN
+	PHFWD_REMOVE,            ///< funkcja phfwdRemove
+	PHFWD_GET,               ///< funkcje phfwdGet, phfwdGetInto i ich wersje z długością
+	PHFWD_GET_BATCH,         ///< funkcja phfwdGetBatch
+	PHFWD_REVERSE,           ///< funkcje phfwdReverse, phfwdReverseN i iterator
+	PHFWD_GET_REVERSE,       ///< funkcja phfwdGetReverse i jej iterator
+	PHFWD_REVERSE_COUNT,     ///< funkcja phfwdReverseCount
+	PHFWD_NON_TRIVIAL_COUNT, ///< funkcja phfwdNonTrivialCount
+	PHFWD_OPERATIONS         ///< liczba rodzajów operacji
+};
+
+/// Liczba przedziałów histogramu przypadających na jedną potęgę dwójki.
+#define PHFWD_SUB_BUCKETS 4
+
+/// Liczba przedziałów histogramu czasów operacji.
+#define PHFWD_BUCKETS 160
+
+/** @brief Statystyki struktury przechowującej przekierowania.
+* Histogramy mają przedziały logarytmiczno-liniowe: każda potęga dwójki
+* nanosekund jest dzielona na @p PHFWD_SUB_BUCKETS równych przedziałów,
+* więc granice przedziałów różnią się od zmierzonych czasów o mniej niż
+* 25%. Górne granice przedziałów podaje funkcja @ref phstatsBucketLimit.
+* Liczby wywołań są dokładne, ale histogramy obejmują tylko próbkę wywołań,
+* gdyż odczyt zegara kosztuje więcej niż wiele operacji.
+*/
+struct PhoneForwardStats {
+	/// Liczba wywołań operacji każdego rodzaju.
+	uint64_t calls[PHFWD_OPERATIONS];
+	/// Liczby mierzonych wywołań, których czas należy do kolejnych przedziałów.
+	uint64_t histogram[PHFWD_OPERATIONS][PHFWD_BUCKETS];
+	/// Liczba węzłów drzewa przekierowań i indeksu odwrotnego.
+	size_t nodes;
+	/// Liczba bajtów zaalokowanych na węzły puli.
+	size_t nodeBytes;
+	/// Liczba bajtów zaalokowanych na numery i etykiety krawędzi puli.
+	size_t stringBytes;
+	/// Długość najdłuższego numeru w drzewie przekierowań.
+	size_t maxDepth;
+};
+
 /** @brief Tworzy nową strukturę.
 * Tworzy nową strukturę niezawierającą żadnych przekierowań.
 * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
@@ -32,11 +78,80 @@ struct PhoneForward * phfwdNew(void);
 
 /** @brief Usuwa strukturę.
 * Usuwa strukturę wskazywaną przez @p pf. Nic nie robi, jeśli wskaźnik ten ma
-* wartość NULL.
+* wartość NULL. Węzły i numery struktury leżą w kilku tablicach puli, więc
+* czas usuwania nie zależy od liczby przekierowań. Gdy pulę dzielą kopie
+* struktury, jej drzewa zwalniają stopniowo pozostałe struktury, jak opisano
+* przy funkcji @ref phfwdReclaim.
 * @param[in] pf – wskaźnik na usuwaną strukturę.
 */
 void phfwdDelete(struct PhoneForward *pf);
 
+/** @brief Kopiuje strukturę.
+* Tworzy kopię struktury wskazywanej przez @p pf w czasie stałym. Kopia
+* dzieli z oryginałem węzły drzew, a zmiany jednej ze struktur kopiują tylko
+* zmieniane ścieżki, więc nie są widoczne w drugiej. Kopia przejmuje też
+* listę przekierowań oczekujących na usunięcie z indeksu odwrotnego (zob.
+* @ref phfwdReclaim), której długość zależy tylko od liczby wywołań funkcji
+* @ref phfwdRemove.
+* @param[in] pf – wskaźnik na kopiowaną strukturę.
+* @return Wskaźnik na utworzoną kopię lub NULL, gdy nie udało się
+*         zaalokować pamięci lub wskaźnik @p pf ma wartość NULL.
+*/
+struct PhoneForward * phfwdCopy(struct PhoneForward const *pf);
+
+/** @brief Kopiuje strukturę do osobnej pamięci.
+* Tworzy kopię struktury wskazywanej przez @p pf, która nie dzieli z nią
+* żadnej pamięci, więc obie struktury mogą być używane przez różne wątki.
+* Czas kopiowania jest liniowy względem rozmiaru struktury. Przekierowania
+* oczekujące na usunięcie z indeksu odwrotnego nie trafiają do kopii.
+* @param[in] pf – wskaźnik na kopiowaną strukturę.
+* @return Wskaźnik na utworzoną kopię lub NULL, gdy nie udało się
+*         zaalokować pamięci lub wskaźnik @p pf ma wartość NULL.
+*/
+struct PhoneForward * phfwdDuplicate(struct PhoneForward const *pf);
+
+/** @brief Zapisuje strukturę do pliku.
+* Zapisuje przekierowania struktury wskazywanej przez @p pf do pliku
+* @p path w zwartej postaci binarnej, którą można wczytać funkcją
+* @ref phfwdLoad.
+* @param[in] pf – wskaźnik na zapisywaną strukturę.
+* @param[in] path – wskaźnik na ścieżkę do pliku.
+* @return Wartość @p true, jeśli udało się zapisać plik.
+*         Wartość @p false, gdy któryś z parametrów ma wartość NULL, nie
+*         udało się zaalokować pamięci lub zapisać pliku.
+*/
+bool phfwdSave(struct PhoneForward const *pf, char const *path);
+
+/** @brief Wczytuje strukturę z pliku.
+* Tworzy strukturę zawierającą przekierowania zapisane w pliku @p path
+* funkcją @ref phfwdSave. Plik jest odwzorowywany w pamięci, więc
+* przekierowania nie są kopiowane, a jedynie sprawdzane jednym przejściem,
+* a zmiany struktury nie trafiają do pliku. Uszkodzony plik jest odrzucany.
+* Plik nie może być modyfikowany w czasie korzystania ze struktury, ale
+* można go podmienić, zapisując nową wersję funkcją @ref phfwdSave.
+* @param[in] path – wskaźnik na ścieżkę do pliku.
+* @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
+*         wczytać pliku lub zaalokować pamięci.
+*/
+struct PhoneForward * phfwdLoad(char const *path);
+
+/** @brief Tworzy strukturę z listy przekierowań.
+* Tworzy strukturę zawierającą przekierowania numerów @p num1[i] na numery
+* @p num2[i] dla i od 0 do @p n - 1. Wynik jest taki sam jak po kolejnych
+* wywołaniach funkcji @ref phfwdAdd na nowej strukturze, w szczególności
+* pary, których nie dodałaby ta funkcja, są pomijane. Drzewa są budowane
+* w jednym przejściu, sortowaniem pozycyjnym, więc czas działania jest
+* liniowy względem łącznej długości numerów.
+* @param[in] num1 – tablica wskaźników na numery przekierowywane.
+* @param[in] num2 – tablica wskaźników na numery, na które wykonywane są
+*                   przekierowania.
+* @param[in] n – liczba przekierowań.
+* @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
+*         zaalokować pamięci.
+*/
+struct PhoneForward * phfwdBuild(char const * const *num1, char const * const *num2,
+								 size_t n);
+
 /** @brief Dodaje przekierowanie.
 * Dodaje przekierowanie wszystkich numerów mających prefiks @p num1, na numery,
 * w których ten prefiks zamieniono odpowiednio na prefiks @p num2. Każdy numer
@@ -54,6 +169,24 @@ void phfwdDelete(struct PhoneForward *pf);
 */
 bool phfwdAdd(struct PhoneForward *pf, char const *num1, char const *num2);
 
+/** @brief Dodaje przekierowanie numerów o znanych długościach.
+* Działa tak jak funkcja @ref phfwdAdd, ale nie wyznacza długości numerów,
+* a każdy z nich sprawdza jednym przejściem. Numerami są pierwsze @p n1
+* znaków napisu @p num1 i pierwsze @p n2 znaków napisu @p num2; napisy nie
+* muszą być zakończone znakiem '\0', a dalsze znaki nie są czytane.
+* @param[in] pf   – wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num1 – wskaźnik na napis reprezentujący prefiks numerów
+*                   przekierowywanych;
+* @param[in] n1   – długość numeru @p num1;
+* @param[in] num2 – wskaźnik na napis reprezentujący prefiks numerów, na które
+*                   jest wykonywane przekierowanie;
+* @param[in] n2   – długość numeru @p num2.
+* @return Wartość @p true, jeśli przekierowanie zostało dodane.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+bool phfwdAddN(struct PhoneForward *pf, char const *num1, size_t n1,
+			   char const *num2, size_t n2);
+
 /** @brief Usuwa przekierowania.
 * Usuwa wszystkie przekierowania, w których parametr @p num jest prefiksem
 * parametru @p num1 użytego przy dodawaniu. Jeśli nie ma takich przekierowań
@@ -77,6 +210,72 @@ void phfwdRemove(struct PhoneForward *pf, char const *num);
 */
 struct PhoneNumbers const * phfwdGet(struct PhoneForward *pf, char const *num);
 
+/** @brief Wyznacza przekierowanie numeru o znanej długości.
+* Działa tak jak funkcja @ref phfwdGet, ale nie wyznacza długości numeru.
+* Numerem jest pierwszych @p n znaków napisu @p num, który nie musi być
+* zakończony znakiem '\0'.
+* @param[in] pf  – wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num – wskaźnik na napis reprezentujący numer;
+* @param[in] n   – długość numeru @p num.
+* @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, jeżeli nie
+*         udało się zaalokować pamięci.
+*/
+struct PhoneNumbers const * phfwdGetN(struct PhoneForward *pf, char const *num,
+									  size_t n);
+
+/** @brief Wyznacza przekierowanie numeru do bufora.
+* Wyznacza przekierowanie podanego numeru tak jak funkcja @ref phfwdGet, ale
+* nie alokuje pamięci: wynik zakończony znakiem '\0' zapisuje w buforze
+* @p buf podanym przez wywołującego. Jeśli podany napis nie reprezentuje
+* numeru, wynikiem jest pusty napis. Gdy wynik nie mieści się w buforze,
+* bufor pozostaje niezmieniony.
+* @param[in] pf      – wskaźnik na strukturę przechowującą przekierowania
+*                      numerów;
+* @param[in] num     – wskaźnik na napis reprezentujący numer;
+* @param[out] buf    – wskaźnik na bufor, w którym zapisywany jest wynik;
+* @param[in] bufSize – rozmiar bufora @p buf.
+* @return Długość wyniku (bez znaku '\0'). Wynik został zapisany wtedy
+*         i tylko wtedy, gdy jest ona mniejsza od @p bufSize.
+*/
+size_t phfwdGetInto(struct PhoneForward *pf, char const *num, char *buf,
+					size_t bufSize);
+
+/** @brief Wyznacza przekierowanie numeru o znanej długości do bufora.
+* Działa tak jak funkcja @ref phfwdGetInto, ale nie wyznacza długości
+* numeru. Numerem jest pierwszych @p n znaków napisu @p num, który nie musi
+* być zakończony znakiem '\0'.
+* @param[in] pf      – wskaźnik na strukturę przechowującą przekierowania
+*                      numerów;
+* @param[in] num     – wskaźnik na napis reprezentujący numer;
+* @param[in] n       – długość numeru @p num;
+* @param[out] buf    – wskaźnik na bufor, w którym zapisywany jest wynik;
+* @param[in] bufSize – rozmiar bufora @p buf.
+* @return Długość wyniku (bez znaku '\0'). Wynik został zapisany wtedy
+*         i tylko wtedy, gdy jest ona mniejsza od @p bufSize.
+*/
+size_t phfwdGetIntoN(struct PhoneForward *pf, char const *num, size_t n,
+					 char *buf, size_t bufSize);
+
+/** @brief Wyznacza przekierowania wielu numerów.
+* Wyznacza przekierowania numerów z tablicy @p nums tak jak funkcja
+* @ref phfwdGet, przeplatając wyszukiwania dla różnych numerów, aby ukryć
+* opóźnienia dostępów do pamięci. Tak jak ona korzysta z pamięci podręcznej
+* i wielokrokowego indeksu drzewa, jeśli są włączone. Wynikowy ciąg ma
+* @p n elementów, @p i-ty z nich jest przekierowaniem numeru @p nums[i] lub
+* pustym napisem, jeśli @p nums[i] nie reprezentuje numeru. Jeśli @p pf lub
+* @p nums ma wartość NULL, wynikiem jest pusty ciąg. Alokuje strukturę
+* @p PhoneNumbers, która musi być zwolniona za pomocą funkcji
+* @ref phnumDelete.
+* @param[in] pf   – wskaźnik na strukturę przechowującą przekierowania
+*                   numerów;
+* @param[in] nums – wskaźnik na tablicę napisów reprezentujących numery;
+* @param[in] n    – liczba numerów.
+* @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+*         udało się zaalokować pamięci.
+*/
+struct PhoneNumbers const * phfwdGetBatch(struct PhoneForward *pf,
+										  char const * const *nums, size_t n);
+
 /** @brief Wyznacza przekierowania na dany numer.
 * Wyznacza wszystkie przekierowania na podany numer. Wynikowy ciąg zawiera też
 * dany numer. Wynikowe numery są posortowane leksykograficznie i nie mogą się
@@ -90,6 +289,87 @@ struct PhoneNumbers const * phfwdGet(struct PhoneForward *pf, char const *num);
 */
 struct PhoneNumbers const * phfwdReverse(struct PhoneForward *pf, char const *num);
 
+/** @brief Wyznacza przekierowania na numer o znanej długości.
+* Działa tak jak funkcja @ref phfwdReverse, ale nie wyznacza długości
+* numeru. Numerem jest pierwszych @p n znaków napisu @p num, który nie musi
+* być zakończony znakiem '\0'.
+* @param[in] pf  – wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num – wskaźnik na napis reprezentujący numer;
+* @param[in] n   – długość numeru @p num.
+* @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+*         udało się zaalokować pamięci.
+*/
+struct PhoneNumbers const * phfwdReverseN(struct PhoneForward *pf,
+										  char const *num, size_t n);
+
+/** @brief Wyznacza numery przekierowywane na dany numer.
+* Wyznacza te numery z wyniku funkcji @ref phfwdReverse, których
+* przekierowaniem wyznaczonym funkcją @ref phfwdGet jest podany numer.
+* Wynikowe numery są posortowane leksykograficznie i nie mogą się powtarzać.
+* Jeśli podany napis nie reprezentuje numeru, wynikiem jest pusty ciąg.
+* Alokuje strukturę @p PhoneNumbers, która musi być zwolniona za pomocą
+* funkcji @ref phnumDelete.
+* @param[in] pf  – wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num – wskaźnik na napis reprezentujący numer.
+* @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+*         udało się zaalokować pamięci.
+*/
+struct PhoneNumbers const * phfwdGetReverse(struct PhoneForward *pf, char const *num);
+
+/** @brief Zlicza przekierowania na dany numer.
+* Wyznacza liczbę numerów, które zawierałby wynik funkcji @ref phfwdReverse,
+* bez wyznaczania samych numerów.
+* @param[in] pf  – wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num – wskaźnik na napis reprezentujący numer.
+* @return Liczba przekierowań na numer @p num lub wartość @p 0, gdy @p pf ma
+*         wartość NULL, napis @p num nie reprezentuje numeru lub nie udało
+*         się zaalokować pamięci.
+*/
+size_t phfwdReverseCount(struct PhoneForward *pf, char const *num);
+
+/** @brief Tworzy iterator po przekierowaniach na dany numer.
+* Tworzy iterator zwracający kolejno te same numery, które zawierałby wynik
+* funkcji @ref phfwdReverse, w porządku leksykograficznym i bez powtórzeń.
+* Numery wyznaczane są dopiero przy ich pobieraniu. Iterator jest ważny
+* do najbliższej modyfikacji struktury @p pf i musi być zwolniony za pomocą
+* funkcji @ref phrevDelete.
+* @param[in] pf  – wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num – wskaźnik na napis reprezentujący numer.
+* @return Wskaźnik na utworzony iterator lub NULL, gdy nie udało się
+*         zaalokować pamięci.
+*/
+struct ReverseIterator * phfwdReverseIterator(struct PhoneForward *pf,
+											  char const *num);
+
+/** @brief Tworzy iterator po numerach przekierowywanych na dany numer.
+* Działa jak funkcja @ref phfwdReverseIterator, ale iterator zwraca tylko
+* numery, które zawierałby wynik funkcji @ref phfwdGetReverse.
+* @param[in] pf  – wskaźnik na strukturę przechowującą przekierowania numerów;
+* @param[in] num – wskaźnik na napis reprezentujący numer.
+* @return Wskaźnik na utworzony iterator lub NULL, gdy nie udało się
+*         zaalokować pamięci.
+*/
+struct ReverseIterator * phfwdGetReverseIterator(struct PhoneForward *pf,
+												 char const *num);
+
+/** @brief Pobiera następny numer z iteratora.
+* Pobiera kolejny numer przekierowywany na numer iteratora @p it. Wskaźnik
+* na numer jest ważny do najbliższego wywołania tej funkcji.
+* @param[in] it   – wskaźnik na iterator;
+* @param[out] num – wskaźnik, pod którym zapisywany jest wskaźnik na pobrany
+*                   numer lub NULL, gdy numery się wyczerpały.
+* @return Wartość @p true, jeśli pobranie się powiodło.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+bool phrevNext(struct ReverseIterator *it, char const **num);
+
+/** @brief Usuwa iterator.
+* Usuwa iterator wskazywany przez @p it. Nic nie robi, jeśli wskaźnik ten ma
+* wartość NULL.
+* @param[in] it – wskaźnik na usuwany iterator.
+*/
+void phrevDelete(struct ReverseIterator *it);
+
 /** @brief Usuwa strukturę.
 * Usuwa strukturę wskazywaną przez @p pnum. Nic nie robi, jeśli wskaźnik ten ma
 * wartość NULL.
@@ -109,10 +389,10 @@ char const * phnumGet(struct PhoneNumbers const *pnum, size_t idx);
 
 /** @brief Wyznacza liczbę nietrywialnych numerów.
 * Oblicza liczbę nietrywialnych numerów długości @p len, zawierających tylko 
-* cyfry znajdujące się w napisie set. Algorytm najpierw znadjuje prefixy 
-* nietrywialnych numerów, znajdujące się w drzewie przekierowań, następnie 
-* spisuje je do struktury PhoneForward, sortuje ją i zlicza numery 
-* w taki sposób by uniknąć powtórzeń.
+* cyfry znajdujące się w napisie set. Algorytm przegląda indeks numerów
+* docelowych przekierowań jedynie do numerów, które nie mają wśród nich
+* krótszego prefixu, dzięki czemu numery nie są liczone wielokrotnie. Wyniki
+* są zapamiętywane do najbliższej modyfikacji struktury @p pf.
 * @param[in] pf - wskaźnik na strukturę z przekierowaniami.
 * @param[in] set - wskaźnik na zbiór znaków zawierający cyfry, które muszą
 *                zawierać zliczane nietrywialne numery.
@@ -123,4 +403,94 @@ char const * phnumGet(struct PhoneNumbers const *pnum, size_t idx);
 */
 size_t phfwdNonTrivialCount(struct PhoneForward *pf, char const *set, size_t len);
 
+/** @brief Wyznacza statystyki struktury.
+* Zapisuje w @p stats liczby wywołań i histogramy czasów operacji
+* wykonanych na strukturze @p pf od jej utworzenia przez wszystkie wątki
+* oraz rozmiar jej drzew. Pamięć puli węzłów jest wspólna dla kopii
+* utworzonych funkcją @ref phfwdCopy, więc wliczana jest do każdej z nich.
+* Liczniki operacji można odczytywać w trakcie ich wykonywania przez inne
+* wątki, ale rozmiar drzew tylko wtedy, gdy nikt nie modyfikuje struktury.
+* @param[in] pf    – wskaźnik na strukturę przechowującą przekierowania;
+* @param[out] stats – wskaźnik na wypełniane statystyki.
+* @return Wartość @p true, jeśli wyznaczono statystyki.
+*         Wartość @p false, gdy @p pf lub @p stats ma wartość NULL.
+*/
+bool phfwdStats(struct PhoneForward *pf, struct PhoneForwardStats *stats);
+
+/** @brief Włącza lub wyłącza wielokrokowy indeks przekierowań.
+* Indeks to tablica bezpośrednio adresowana pierwszymi czterema cyframi
+* numeru, zawierająca przekierowanie najdłuższego z ich prefixów i miejsce
+* w drzewie, od którego trzeba szukać dłuższych. Przyspiesza funkcje
+* @ref phfwdGet i @ref phfwdGetInto, gdy przekierowywane są głównie krótkie
+* prefixy, takie jak numery kierunkowe, kosztem około ćwierć megabajta
+* pamięci i odświeżania fragmentu indeksu przy każdej modyfikacji.
+* Kopie struktury nie dziedziczą indeksu.
+* @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania
+*                     numerów;
+* @param[in] enable – przyjmuje wartość @p true, jeśli indeks ma być
+*                     włączony.
+* @return Wartość @p true, jeśli indeks jest w żądanym stanie.
+*         Wartość @p false, gdy @p pf ma wartość NULL lub nie udało się
+*         zaalokować pamięci.
+*/
+bool phfwdStrideIndex(struct PhoneForward *pf, bool enable);
+
+/** @brief Włącza lub wyłącza pamięć podręczną wyników przekierowań.
+* Pamięć przechowuje wyniki funkcji @ref phfwdGet i @ref phfwdGetInto dla
+* około tysiąca ostatnio sprawdzanych numerów długości co najwyżej
+* 24 symboli, wybierając usuwane wyniki algorytmem zegarowym.
+* Przyspiesza wielokrotne sprawdzanie tych samych numerów kosztem około
+* 80 kilobajtów pamięci. Funkcje @ref phfwdAdd i @ref phfwdRemove
+* unieważniają tylko wyniki numerów zaczynających się zmienianym prefixem.
+* Gdy pamięć jest włączona, funkcje @ref phfwdGet i @ref phfwdGetInto
+* modyfikują strukturę, więc nie wolno ich wywoływać współbieżnie.
+* Kopie struktury nie dziedziczą pamięci podręcznej.
+* @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania
+*                     numerów;
+* @param[in] enable – przyjmuje wartość @p true, jeśli pamięć ma być
+*                     włączona.
+* @return Wartość @p true, jeśli pamięć jest w żądanym stanie.
+*         Wartość @p false, gdy @p pf ma wartość NULL lub nie udało się
+*         zaalokować pamięci.
+*/
+bool phfwdCache(struct PhoneForward *pf, bool enable);
+
+/** @brief Wykonuje część odłożonego usuwania przekierowań.
+* Funkcja @ref phfwdRemove odłącza usuwane przekierowania w czasie zależnym
+* tylko od długości numeru, a ich klucze indeksu odwrotnego i zwolnione
+* węzły (także węzły struktur usuniętych funkcją @ref phfwdDelete, które
+* dzieliły pulę z @p pf) są usuwane stopniowo, po kilkaset węzłów przy
+* każdej modyfikacji. Funkcja pozwala wykonać tę pracę, gdy struktura nie
+* jest używana. Do czasu usunięcia klucze odłączonych przekierowań są
+* pomijane przez funkcje przeglądające indeks odwrotny, co wydłuża te
+* zapytania. Funkcje te niczego nie zmieniają, więc nie wymagają
+* synchronizacji przy współbieżnym odczycie, ale zliczają pominięte klucze,
+* a kolejny krok usuwania usuwa co najmniej tyle węzłów, ile kluczy
+* pominięto. Wywoływanie funkcji między zapytaniami ogranicza więc ich
+* łączny dodatkowy koszt do rozmiaru usuniętych przekierowań.
+* @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania
+*                     numerów.
+* @return Wartość @p true, jeśli pozostało odłożone usuwanie.
+*         Wartość @p false w przeciwnym przypadku lub gdy @p pf ma wartość
+*         NULL.
+*/
+bool phfwdReclaim(struct PhoneForward *pf);
+
+/** @brief Podaje górną granicę przedziału histogramu.
+* @param[in] bucket – numer przedziału.
+* @return Największy czas w nanosekundach należący do przedziału.
+*/
+uint64_t phstatsBucketLimit(size_t bucket);
+
+/** @brief Wyznacza percentyl czasu operacji.
+* @param[in] stats – wskaźnik na statystyki;
+* @param[in] op    – rodzaj operacji;
+* @param[in] p     – percentyl, liczba z przedziału [0, 1].
+* @return Górna granica przedziału histogramu, w którym leży percentyl,
+*         w nanosekundach lub @p 0, gdy nie zmierzono czasu żadnego
+*         wywołania operacji.
+*/
+uint64_t phstatsPercentile(struct PhoneForwardStats const *stats,
+						   enum PhoneForwardOperation op, double p);
+
 #endif /* __PHONE_FORWARD_H__ */
\ No newline at end of file
@@ -5,36 +5,58 @@
  * @author Philip Smolenski-Jensen
  */
 
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "phone_forward.h"
 #include "phone_forward_base.h"
 
+/// Początkowy rozmiar tablicy mieszającej baz.
+#define INITIAL_BASES 16
+
+/** @brief Wyznacza wartość funkcji mieszającej identyfikatora.
+* @param[in] name - Wskaźnik na identyfikator bazy.
+* @return Wartość funkcji mieszającej FNV-1a.
+*/
+static size_t hashName(char const *name) {
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0; name[i] != '\0'; i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 1099511628211ull;
+	}
+
+	return (size_t)hash;
+}
+
 Head * newHead() {
 	Head *h = (Head*)malloc(sizeof(Head));
 
 	if (h == NULL)
 		return NULL;
 
-	h->base = (Base*)malloc(sizeof(Base) * MAX_BASE_SIZE);
+	h->base = (Base*)malloc(sizeof(Base) * INITIAL_BASES);
 
 	if (h->base == NULL) {
 		free(h);
 		return NULL;
 	}
 
-	for (int i = 0; i < MAX_BASE_SIZE; i++) {
+	for (int i = 0; i < INITIAL_BASES; i++) {
 		(h->base + i)->pf = NULL;
 		(h->base + i)->name = NULL;
 	}
 
+	h->capacity = INITIAL_BASES;
+	h->size = 0;
 	h->recent = NONE;
 
 	return h;
 }
 
 void clearAll(Head *h) {
-	for (int i = 0; i < MAX_BASE_SIZE; i++) 
+	for (size_t i = 0; i < h->capacity; i++)
 		if ((h->base + i)->pf != NULL) {
 			phfwdDelete((h->base + i)->pf);
 			free((h->base + i)->name);
@@ -44,52 +66,360 @@ void clearAll(Head *h) {
 	free(h);
 }
 
-bool newBase(Head *h, char const *name) {
-	for (int i = 0; i < MAX_BASE_SIZE; i++) {
-		if ((h->base + i)->pf != NULL 
-				&& strcmp((h->base + i)->name, name) == 0) {
-			h->recent = i;
+/** @brief Znajduje bazę.
+* @param[in] h - Wskaźnik na centralę.
+* @param[in] name - Wskaźnik na identyfikator bazy.
+* @return Numer bazy o identyfikatorze @p name lub @p NONE, gdy jej nie ma.
+*/
+static int findBase(Head *h, char const *name) {
+	size_t hash = hashName(name);
+	size_t mask = h->capacity - 1;
 
-			return true;
-		}
+	for (size_t i = hash & mask; (h->base + i)->pf != NULL; i = (i + 1) & mask)
+		if ((h->base + i)->hash == hash && strcmp((h->base + i)->name, name) == 0)
+			return i;
+
+	return NONE;
+}
+
+/** @brief Powiększa tablicę mieszającą baz.
+* Przenosi bazy do tablicy dwa razy większej, aktualizując numer aktualnej
+* bazy.
+* @param[in] h - Wskaźnik na centralę.
+* @return Wartość @p true, jeśli udało się powiększyć tablicę.
+* 		  Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool growHead(Head *h) {
+	if (h->capacity > INT_MAX / 2)
+		return false;
+
+	size_t capacity = 2 * h->capacity;
+	size_t mask = capacity - 1;
+	Base *base = (Base*)malloc(sizeof(Base) * capacity);
+
+	if (base == NULL)
+		return false;
+
+	for (size_t i = 0; i < capacity; i++) {
+		(base + i)->pf = NULL;
+		(base + i)->name = NULL;
 	}
 
-	for (int i = 0; i < MAX_BASE_SIZE; i ++) {
-		if ((h->base + i)->pf == NULL) {
-			(h->base + i)->pf = phfwdNew();
-			
-			if ((h->base + i)->pf == NULL)
-				return false;
+	int recent = NONE;
 
-			int n = strlen(name) + 1;
-			(h->base + i)->name = (char*)malloc(sizeof(char) * n);
+	for (size_t i = 0; i < h->capacity; i++) {
+		if ((h->base + i)->pf == NULL)
+			continue;
 
-			if ((h->base + i)->name == NULL)
-				return false; 
+		size_t j = (h->base + i)->hash & mask;
 
-			strcpy((h->base + i)->name, name);
-			h->recent = i;
+		while ((base + j)->pf != NULL)
+			j = (j + 1) & mask;
 
-			return true;
-		}
+		base[j] = h->base[i];
+
+		if (h->recent == (int)i)
+			recent = j;
+	}
+
+	free(h->base);
+	h->base = base;
+	h->capacity = capacity;
+	h->recent = recent;
+
+	return true;
+}
+
+/** @brief Dodaje bazę do tablicy mieszającej.
+* Baza o identyfikatorze @p name nie może istnieć.
+* @param[in] h - Wskaźnik na centralę.
+* @param[in] name - Wskaźnik na identyfikator bazy.
+* @param[in] pf - Wskaźnik na strukturę przekierowań bazy.
+* @return Numer dodanej bazy lub @p NONE, gdy nie udało się zaalokować
+* 		  pamięci.
+*/
+static int addBase(Head *h, char const *name, struct PhoneForward *pf) {
+	// Tablica jest zapełniona co najwyżej w trzech czwartych.
+	if (4 * (h->size + 1) > 3 * h->capacity && !growHead(h))
+		return NONE;
+
+	int n = strlen(name) + 1;
+	char *copy = (char*)malloc(sizeof(char) * n);
+
+	if (copy == NULL)
+		return NONE;
+
+	strcpy(copy, name);
+
+	size_t hash = hashName(name);
+	size_t mask = h->capacity - 1;
+	size_t i = hash & mask;
+
+	while ((h->base + i)->pf != NULL)
+		i = (i + 1) & mask;
+
+	(h->base + i)->pf = pf;
+	(h->base + i)->name = copy;
+	(h->base + i)->hash = hash;
+	h->size++;
+
+	return i;
+}
+
+bool newBase(Head *h, char const *name) {
+	int k = findBase(h, name);
+
+	if (k != NONE) {
+		h->recent = k;
+
+		return true;
+	}
+
+	struct PhoneForward *pf = phfwdNew();
+
+	if (pf == NULL)
+		return false;
+
+	k = addBase(h, name, pf);
+
+	if (k == NONE) {
+		phfwdDelete(pf);
+		return false;
 	}
-	return false;
+
+	h->recent = k;
+
+	return true;
 }
 
 bool delBase(Head *h, char const *name) {
-	for (int i = 0; i < MAX_BASE_SIZE; i++) {
-		if ((h->base + i)->pf != NULL 
-				&& strcmp((h->base + i)->name, name) == 0) {
-			
-			phfwdDelete((h->base + i)->pf);
-			free((h->base + i)->name);
-			(h->base + i)->pf = NULL;
-			(h->base + i)->name = NULL;
+	int k = findBase(h, name);
+
+	if (k == NONE)
+		return false;
+
+	phfwdDelete((h->base + k)->pf);
+	free((h->base + k)->name);
+
+	if (h->recent == k)
+		h->recent = NONE;
+
+	// Przesuwamy wstecz bazy, których ciąg próbkowania przechodził przez
+	// zwolnione miejsce, dzięki czemu tablica nie zawiera znaczników usunięcia.
+	size_t mask = h->capacity - 1;
+	size_t i = k;
 
-			if (h->recent == i)
-				h->recent = NONE;
-			return true;
+	for (size_t j = (i + 1) & mask; (h->base + j)->pf != NULL; j = (j + 1) & mask) {
+		size_t home = (h->base + j)->hash & mask;
+
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			h->base[i] = h->base[j];
+
+			if (h->recent == (int)j)
+				h->recent = i;
+
+			i = j;
 		}
 	}
-	return false;
-}
\ No newline at end of file
+
+	(h->base + i)->pf = NULL;
+	(h->base + i)->name = NULL;
+	h->size--;
+
+	return true;
+}
+
+void selectBase(Head *h, char const *name) {
+	h->recent = name == NULL ? NONE : findBase(h, name);
+}
+
+char const * recentBase(Head *h) {
+	return h->recent == NONE ? NULL : (h->base + h->recent)->name;
+}
+
+/** @brief Umieszcza strukturę przekierowań w centrali.
+* Zastępuje przekierowania bazy o identyfikatorze @p name strukturą @p pf,
+* a gdy takiej bazy nie ma, tworzy ją. Numer aktualnej bazy wskazuje dalej
+* tę samą bazę.
+* @param[in] h - Wskaźnik na centralę.
+* @param[in] name - Wskaźnik na identyfikator bazy.
+* @param[in] pf - Wskaźnik na strukturę przekierowań.
+* @return Wartość @p true, jeśli centrala przejęła strukturę @p pf.
+* 		  Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool putBase(Head *h, char const *name, struct PhoneForward *pf) {
+	int k = findBase(h, name);
+
+	if (k != NONE) {
+		phfwdDelete((h->base + k)->pf);
+		(h->base + k)->pf = pf;
+
+		return true;
+	}
+
+	return addBase(h, name, pf) != NONE;
+}
+
+bool copyBase(Head *h, char const *src, char const *dst) {
+	int k = findBase(h, src);
+
+	if (k == NONE)
+		return false;
+
+	if (strcmp(src, dst) == 0)
+		return true;
+
+	struct PhoneForward *pf = phfwdCopy((h->base + k)->pf);
+
+	if (pf == NULL)
+		return false;
+
+	if (!putBase(h, dst, pf)) {
+		phfwdDelete(pf);
+		return false;
+	}
+
+	return true;
+}
+
+bool reclaimBases(Head *h) {
+	bool pending = false;
+
+	for (size_t i = 0; i < h->capacity; i++)
+		if ((h->base + i)->pf != NULL && phfwdReclaim((h->base + i)->pf))
+			pending = true;
+
+	return pending;
+}
+
+bool reclaimRecent(Head *h) {
+	return h->recent != NONE && phfwdReclaim((h->base + h->recent)->pf);
+}
+
+bool saveBase(Head *h, char const *name, char const *path) {
+	int k = findBase(h, name);
+
+	if (k == NONE)
+		return false;
+
+	return phfwdSave((h->base + k)->pf, path);
+}
+
+bool loadBase(Head *h, char const *name, char const *path) {
+	struct PhoneForward *pf = phfwdLoad(path);
+
+	if (pf == NULL)
+		return false;
+
+	if (!putBase(h, name, pf)) {
+		phfwdDelete(pf);
+		return false;
+	}
+
+	return true;
+}
+
+/** @brief Sprawdza, czy słowo jest numerem.
+* @param[in] word - wskaźnik na słowo zakończone znakiem '\0'.
+* @return Wartość @p true, jeśli słowo składa się z cyfr.
+* 		  Wartość @p false w przeciwnym przypadku.
+*/
+static bool isNumberWord(char const *word) {
+	for (size_t i = 0; word[i] != '\0'; i++)
+		if (word[i] < '0' || word[i] >= '0' + ALPHABET_SIZE)
+			return false;
+
+	return true;
+}
+
+/** @brief Wczytuje zawartość pliku.
+* @param[in] path - Wskaźnik na ścieżkę do pliku.
+* @param[out] len - Długość zawartości pliku.
+* @return Wskaźnik na zawartość pliku zakończoną znakiem '\0' lub NULL, gdy
+* 		  nie udało się wczytać pliku lub zaalokować pamięci.
+*/
+static char * readFile(char const *path, size_t *len) {
+	FILE *file = fopen(path, "rb");
+
+	if (file == NULL)
+		return NULL;
+
+	size_t capacity = 4096;
+	size_t size = 0;
+	char *text = (char*)malloc(sizeof(char) * capacity);
+
+	while (text != NULL) {
+		size += fread(text + size, sizeof(char), capacity - size - 1, file);
+
+		if (size < capacity - 1)
+			break;
+
+		char *bigger = (char*)realloc(text, sizeof(char) * 2 * capacity);
+
+		if (bigger == NULL)
+			free(text);
+
+		text = bigger;
+		capacity *= 2;
+	}
+
+	if (text != NULL && ferror(file)) {
+		free(text);
+		text = NULL;
+	}
+
+	fclose(file);
+
+	if (text != NULL) {
+		text[size] = '\0';
+		*len = size;
+	}
+
+	return text;
+}
+
+bool importBase(Head *h, char const *name, char const *path) {
+	size_t len;
+	char *text = readFile(path, &len);
+
+	if (text == NULL)
+		return false;
+
+	// Słów jest nie więcej niż połowa znaków pliku.
+	size_t capacity = len / 2 + 1;
+	char const **words = (char const**)malloc(sizeof(char*) * capacity);
+	char const **targets = (char const**)malloc(sizeof(char*) * capacity);
+	size_t n = 0;
+	bool ok = words != NULL && targets != NULL;
+	char *c = ok ? strtok(text, " \t\n\v\f\r") : NULL;
+
+	for (; ok && c != NULL; c = strtok(NULL, " \t\n\v\f\r")) {
+		ok = isNumberWord(c);
+
+		if (n % 2 == 0)
+			words[n / 2] = c;
+		else
+			targets[n / 2] = c;
+
+		n++;
+	}
+
+	struct PhoneForward *pf = NULL;
+
+	if (ok && n % 2 == 0)
+		pf = phfwdBuild(words, targets, n / 2);
+
+	free(words);
+	free(targets);
+	free(text);
+
+	if (pf == NULL)
+		return false;
+
+	if (!putBase(h, name, pf)) {
+		phfwdDelete(pf);
+		return false;
+	}
+
+	return true;
+}
@@ -11,9 +11,6 @@
 #include <string.h>
 #include "phone_forward.h"
 
-/// Maksymalna liczba baz w centrali.
-#define MAX_BASE_SIZE 1000
-
 /// Wartość którą przyjmuje @p recent, gdy nie ma ustawionej aktualnej bazy.
 #define NONE -1
 
@@ -28,17 +25,27 @@ typedef struct Base {
 	struct PhoneForward *pf;
 	/// Identyfikator bazy.
 	char *name;
+	/// Wartość funkcji mieszającej identyfikatora.
+	size_t hash;
 }Base;
 
 /** @brief Struktura przechowująca wiele baz (Centrala).
 * Struktura służąca do obsługiwania wielu baz jednocześnie
-* Składa się z tablicy baz (rozmiaru MAX_BASE_SIZE) oraz liczby,
-* informującej o numerze aktualnie obsługiwanej bazy (liczba ta
-* jest równa NONE, gdy żadna baza nie jest aktualnie obsługiwana).
+* Składa się z tablicy mieszającej baz z adresowaniem otwartym, indeksowanej
+* identyfikatorami, oraz liczby, informującej o numerze aktualnie
+* obsługiwanej bazy (liczba ta jest równa NONE, gdy żadna baza nie jest
+* aktualnie obsługiwana). Wolne miejsca tablicy mają wskaźnik @p pf równy
+* NULL, a tablica rośnie, gdy zapełni się w trzech czwartych, więc liczba baz
+* nie jest ograniczona. Numer bazy może się zmienić przy dodawaniu
+* i usuwaniu innych baz, ale @p recent zawsze wskazuje aktualną bazę.
 */
 typedef struct Head {
-	/// Tablica zawierająca dostępne bazy.
+	/// Tablica mieszająca zawierająca dostępne bazy.
 	Base *base;
+	/// Rozmiar tablicy @p base, będący potęgą dwójki.
+	size_t capacity;
+	/// Liczba baz.
+	size_t size;
 	/// Numer aktualnie obsługiwanej bazy.
 	int recent;
 }Head;
@@ -51,7 +58,8 @@ typedef struct Head {
 Head * newHead();
 
 /** @brief Usuwa centralę.
-* Usuwa centralę wskazywaną przez @p h i zwalnia pamięć.
+* Usuwa centralę wskazywaną przez @p h i zwalnia pamięć. Czas usuwania
+* zależy od liczby baz, a nie od liczby ich przekierowań.
 * @param[in] h - wskaźnik na usuwaną centralę.
 */
 void clearAll(Head *h);
@@ -61,13 +69,13 @@ void clearAll(Head *h);
 * @param[in] name - Wskaźnik na identyfikator powstającej bazy
 * @param[in] h - Wskaźnik na centralę, do której dodana zostanie baza.
 * @return Wartość @p true jeżeli pomyślnie dodano przekierowanie.
-* 		  Wartość @p false jeśli wystąpił błąd (centrala jest już pełna,
-* 					 lub nie udało się zaalokować pamięci).
+* 		  Wartość @p false jeśli nie udało się zaalokować pamięci.
 */
 bool newBase(Head *h, char const *name);
 
 /** @brief Usuwa bazę.
-* Usuwa bazę o identyfikatorze @p name z centrali @p h.
+* Usuwa bazę o identyfikatorze @p name z centrali @p h. Czas usuwania nie
+* zależy od liczby przekierowań bazy.
 * @param[in] name - Wskaźnik na identyfikator usuwanej bazy.
 * @param[in] h - Wskaźnik na centralę, z której usuwana jest baza.
 * @return Wartość @p true, jeśli pomyślnie usunięto bazę.
@@ -75,4 +83,93 @@ bool newBase(Head *h, char const *name);
 */
 bool delBase(Head *h, char const *name);
 
+/** @brief Ustawia aktualną bazę.
+* Ustawia jako aktualną bazę o identyfikatorze @p name. Gdy takiej bazy nie
+* ma lub @p name ma wartość NULL, żadna baza nie jest aktualna.
+* @param[in] h - Wskaźnik na centralę.
+* @param[in] name - Wskaźnik na identyfikator bazy lub NULL.
+*/
+void selectBase(Head *h, char const *name);
+
+/** @brief Podaje identyfikator aktualnej bazy.
+* @param[in] h - Wskaźnik na centralę.
+* @return Wskaźnik na identyfikator aktualnej bazy lub NULL, gdy żadna baza
+* 		  nie jest aktualna. Wskaźnik jest ważny do usunięcia tej bazy.
+*/
+char const * recentBase(Head *h);
+
+/** @brief Kopiuje bazę.
+* Tworzy w centrali @p h bazę o identyfikatorze @p dst, zawierającą te same
+* przekierowania co baza o identyfikatorze @p src. Istniejąca baza
+* o identyfikatorze @p dst jest zastępowana kopią. Kopiowanie zajmuje czas
+* stały, bo kopia dzieli z oryginałem niezmienione przekierowania.
+* @param[in] h - Wskaźnik na centralę, w której kopiowana jest baza.
+* @param[in] src - Wskaźnik na identyfikator kopiowanej bazy.
+* @param[in] dst - Wskaźnik na identyfikator kopii.
+* @return Wartość @p true, jeśli pomyślnie skopiowano bazę.
+* 		  Wartość @p false, gdy baza @p src nie istnieje lub nie udało się
+* 					 zaalokować pamięci.
+*/
+bool copyBase(Head *h, char const *src, char const *dst);
+
+/** @brief Wykonuje część odłożonego usuwania przekierowań we wszystkich bazach.
+* Przeznaczona do wywoływania, gdy centrala nie ma nic innego do zrobienia.
+* @param[in] h - Wskaźnik na centralę.
+* @return Wartość @p true, jeśli w którejś bazie pozostało odłożone usuwanie.
+* 		  Wartość @p false w przeciwnym przypadku.
+*/
+bool reclaimBases(Head *h);
+
+/** @brief Wykonuje część odłożonego usuwania przekierowań w aktualnej bazie.
+* Przeznaczona do wywoływania po każdej operacji. Czas nie zależy od liczby
+* baz, a usuwana część rośnie z liczbą nieaktualnych kluczy pominiętych przez
+* zapytania od poprzedniego wywołania, zob. @ref phfwdReclaim, więc zapytania
+* nie płacą wielokrotnie za te same usunięte przekierowania.
+* @param[in] h - Wskaźnik na centralę.
+* @return Wartość @p true, jeśli w aktualnej bazie pozostało odłożone
+* 		  usuwanie.
+* 		  Wartość @p false w przeciwnym przypadku.
+*/
+bool reclaimRecent(Head *h);
+
+/** @brief Zapisuje bazę do pliku.
+* Zapisuje przekierowania bazy o identyfikatorze @p name do pliku @p path.
+* @param[in] h - Wskaźnik na centralę.
+* @param[in] name - Wskaźnik na identyfikator zapisywanej bazy.
+* @param[in] path - Wskaźnik na ścieżkę do pliku.
+* @return Wartość @p true, jeśli pomyślnie zapisano bazę.
+* 		  Wartość @p false, gdy baza nie istnieje lub nie udało się
+* 					 zapisać pliku.
+*/
+bool saveBase(Head *h, char const *name, char const *path);
+
+/** @brief Wczytuje bazę z pliku.
+* Tworzy bazę o identyfikatorze @p name zawierającą przekierowania zapisane
+* w pliku @p path, zastępując istniejącą bazę o tym identyfikatorze. Czas
+* wczytywania nie zależy od liczby przekierowań.
+* @param[in] h - Wskaźnik na centralę.
+* @param[in] name - Wskaźnik na identyfikator wczytywanej bazy.
+* @param[in] path - Wskaźnik na ścieżkę do pliku.
+* @return Wartość @p true, jeśli pomyślnie wczytano bazę.
+* 		  Wartość @p false, gdy nie udało się wczytać pliku lub zaalokować
+* 					 pamięci.
+*/
+bool loadBase(Head *h, char const *name, char const *path);
+
+/** @brief Importuje bazę z listy przekierowań.
+* Tworzy bazę o identyfikatorze @p name zawierającą przekierowania z pliku
+* tekstowego @p path, zastępując istniejącą bazę o tym identyfikatorze.
+* Plik zawiera pary numerów @p num1 @p num2 oddzielone białymi znakami,
+* a wynik jest taki sam jak po kolejnych operacjach @p num1 > @p num2,
+* z pominięciem par jednakowych numerów.
+* @param[in] h - Wskaźnik na centralę.
+* @param[in] name - Wskaźnik na identyfikator tworzonej bazy.
+* @param[in] path - Wskaźnik na ścieżkę do pliku.
+* @return Wartość @p true, jeśli pomyślnie zaimportowano bazę.
+* 		  Wartość @p false, gdy nie udało się wczytać pliku, zawiera on
+* 					 słowa niebędące numerami lub nieparzystą liczbę
+* 					 numerów lub nie udało się zaalokować pamięci.
+*/
+bool importBase(Head *h, char const *name, char const *path);
+
 #endif /* __PHONE_FORWARD_BASE_H__ */
\ No newline at end of file
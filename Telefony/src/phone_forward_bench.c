@@ -0,0 +1,506 @@
+/** @file
+ * Test wydajności przekierowań numerów telefonicznych. Dla kilku
+ * deterministycznie generowanych rodzajów drzew mierzy przepustowość oraz
+ * medianę i 99. percentyl czasu pojedynczego wywołania funkcji phfwdAdd,
+ * phfwdGet (bez i z indeksem wielokrokowym oraz dla często powtarzanych
+ * numerów bez i z pamięcią podręczną), phfwdReverse,
+ * phfwdNonTrivialCount i phfwdRemove, phfwdReverse tuż po usunięciu
+ * dużego poddrzewa i w serii zapytań po takim usunięciu oraz
+ * maksymalne zużycie pamięci. Każdy rodzaj drzewa mierzony jest w osobnym
+ * procesie potomnym, więc zużycie pamięci dotyczy tylko jego pomiarów.
+ * Wyniki wypisywane są w formacie CSV, by można je było porównywać między
+ * uruchomieniami.
+ *
+ * Użycie: phone_forward_bench [przekierowania] [ziarno]
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "phone_forward.h"
+
+/// Domyślna liczba przekierowań w strukturze.
+#define DEFAULT_FORWARDS 100000
+
+/// Domyślne ziarno generatora liczb losowych.
+#define DEFAULT_SEED 88172645463325252ull
+
+/// Maksymalna długość generowanego numeru.
+#define NUMBER_LENGTH 200
+
+/// Liczba wspólnych początków numerów w głębokim drzewie.
+#define STEMS 8
+
+/// Ile razy rzadziej od pozostałych wywoływane są funkcje przeglądające poddrzewa.
+#define SLOW_RATIO 100
+
+/// Liczba często powtarzanych numerów zapytań.
+#define HOT_NUMBERS 128
+
+/// Co który numer zapytań o często powtarzane numery jest nowy.
+#define COLD_RATIO 8
+
+/// Liczba mierzonych funkcji.
+#define OPERATIONS 10
+
+/// Nazwy mierzonych funkcji.
+static char const * const operationNames[OPERATIONS] = {
+	"phfwdAdd", "phfwdGet", "phfwdGet+stride", "phfwdGet/hot",
+	"phfwdGet/hot+cache", "phfwdReverse", "phfwdNonTrivialCount", "phfwdRemove",
+	"phfwdReverse/after-remove", "phfwdReverse/sustained-after-remove"
+};
+
+/**
+ * Generator numerów jednego rodzaju drzewa.
+ */
+typedef struct {
+	char const *name;        ///< nazwa rodzaju drzewa
+	size_t sourceMin;        ///< minimalna długość numeru przekierowywanego
+	size_t sourceMax;        ///< maksymalna długość numeru przekierowywanego
+	size_t targetMin;        ///< minimalna długość numeru docelowego
+	size_t targetMax;        ///< maksymalna długość numeru docelowego
+	bool deep;               ///< czy numery przekierowywane mają wspólne początki
+	size_t queryExtra;       ///< liczba cyfr dopisywanych do numerów zapytań
+} Workload;
+
+/// Rodzaje drzew: głębokie, szerokie, z długimi numerami oraz z numerami
+/// kierunkowymi, o które pytają pełne numery.
+static Workload const workloads[] = {
+	{"deep", 20, 80, 3, 8, true, 0},
+	{"wide", 1, 8, 1, 8, false, 0},
+	{"long", 100, NUMBER_LENGTH, 100, NUMBER_LENGTH, false, 0},
+	{"codes", 1, 4, 3, 8, false, 7}
+};
+
+/**
+ * Wyniki pomiaru jednej funkcji.
+ */
+typedef struct {
+	uint64_t *times; ///< czasy kolejnych wywołań w nanosekundach
+	size_t count;    ///< liczba wywołań
+	double total;    ///< łączny czas wywołań w sekundach
+} Samples;
+
+/** @brief Losuje liczbę.
+* @param[in, out] state – stan generatora xorshift.
+* @return Wylosowana liczba.
+*/
+static uint64_t nextRandom(uint64_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+
+	return *state;
+}
+
+/** @brief Losuje cyfry.
+* @param[in, out] state – stan generatora liczb losowych.
+* @param[out] buf – bufor na cyfry.
+* @param[in] n – liczba cyfr.
+*/
+static void randomDigits(uint64_t *state, char *buf, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		buf[i] = '0' + nextRandom(state) % ALPHABET_SIZE;
+}
+
+/** @brief Losuje długość numeru.
+* @param[in, out] state – stan generatora liczb losowych.
+* @param[in] min – minimalna długość.
+* @param[in] max – maksymalna długość.
+* @return Wylosowana długość.
+*/
+static size_t randomLength(uint64_t *state, size_t min, size_t max) {
+	return min + nextRandom(state) % (max - min + 1);
+}
+
+/** @brief Losuje numer przekierowywany.
+* W głębokim drzewie numer jest początkiem jednego z ustalonych numerów
+* @p stems, co daje długie wspólne ścieżki.
+* @param[in] w – rodzaj drzewa.
+* @param[in, out] state – stan generatora liczb losowych.
+* @param[in] stems – wspólne początki numerów.
+* @param[out] buf – bufor na numer mieszczący @p NUMBER_LENGTH + 1 znaków.
+*/
+static void randomSource(Workload const *w, uint64_t *state,
+						 char stems[STEMS][NUMBER_LENGTH + 1], char *buf) {
+	size_t n = randomLength(state, w->sourceMin, w->sourceMax);
+
+	if (w->deep) {
+		memcpy(buf, stems[nextRandom(state) % STEMS], n);
+		randomDigits(state, buf + n - 1, 1);
+	}
+	else {
+		randomDigits(state, buf, n);
+	}
+
+	buf[n] = '\0';
+}
+
+/** @brief Losuje numer docelowy.
+* @param[in] w – rodzaj drzewa.
+* @param[in, out] state – stan generatora liczb losowych.
+* @param[out] buf – bufor na numer mieszczący @p NUMBER_LENGTH + 1 znaków.
+*/
+static void randomTarget(Workload const *w, uint64_t *state, char *buf) {
+	size_t n = randomLength(state, w->targetMin, w->targetMax);
+	randomDigits(state, buf, n);
+	buf[n] = '\0';
+}
+
+/** @brief Losuje numer zapytania.
+* Numer zapytania to numer przekierowywany z dopisanymi cyframi.
+* @param[in] w – rodzaj drzewa.
+* @param[in, out] state – stan generatora liczb losowych.
+* @param[in] stems – wspólne początki numerów.
+* @param[out] buf – bufor na numer mieszczący @p NUMBER_LENGTH + 1 znaków.
+*/
+static void randomQuery(Workload const *w, uint64_t *state,
+						char stems[STEMS][NUMBER_LENGTH + 1], char *buf) {
+	randomSource(w, state, stems, buf);
+	size_t n = strlen(buf);
+	size_t extra = n + w->queryExtra > NUMBER_LENGTH ? NUMBER_LENGTH - n
+				   : w->queryExtra;
+	randomDigits(state, buf + n, extra);
+	buf[n + extra] = '\0';
+}
+
+/** @brief Losuje numer zapytania o przekierowania na niego.
+* Numer zapytania to numer docelowy z dopisanymi cyframi, by trafiać
+* w istniejące poddrzewa indeksu odwrotnego.
+* @param[in] w – rodzaj drzewa.
+* @param[in, out] state – stan generatora liczb losowych.
+* @param[out] buf – bufor na numer mieszczący @p NUMBER_LENGTH + 1 znaków.
+*/
+static void randomReverseQuery(Workload const *w, uint64_t *state, char *buf) {
+	randomTarget(w, state, buf);
+	size_t n = strlen(buf);
+	size_t extra = randomLength(state, 0, 4);
+
+	if (n + extra > NUMBER_LENGTH)
+		extra = NUMBER_LENGTH - n;
+
+	randomDigits(state, buf + n, extra);
+	buf[n + extra] = '\0';
+}
+
+/** @brief Podaje bieżący czas.
+* @return Czas w nanosekundach od ustalonej chwili.
+*/
+static uint64_t now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (uint64_t)t.tv_sec * 1000000000u + t.tv_nsec;
+}
+
+/** @brief Zapamiętuje czas wywołania.
+* @param[in, out] s – wyniki pomiaru.
+* @param[in] start – chwila rozpoczęcia wywołania.
+*/
+static void record(Samples *s, uint64_t start) {
+	uint64_t t = now() - start;
+	s->times[s->count++] = t;
+	s->total += t * 1e-9;
+}
+
+/** @brief Porównuje czasy.
+* @param[in] a – wskaźnik na pierwszy czas.
+* @param[in] b – wskaźnik na drugi czas.
+* @return Wartość ujemna, zero lub dodatnia, gdy pierwszy czas jest
+*         odpowiednio mniejszy, równy lub większy od drugiego.
+*/
+static int compareTimes(void const *a, void const *b) {
+	uint64_t x = *(uint64_t const *)a, y = *(uint64_t const *)b;
+
+	return (x > y) - (x < y);
+}
+
+/** @brief Wypisuje wyniki pomiaru.
+* @param[in] workload – nazwa rodzaju drzewa.
+* @param[in] operation – nazwa funkcji.
+* @param[in, out] s – wyniki pomiaru; czasy są sortowane.
+* @param[in] rss – maksymalne zużycie pamięci procesu w kilobajtach.
+*/
+static void report(char const *workload, char const *operation, Samples *s,
+				   long rss) {
+	if (s->count == 0)
+		return;
+
+	qsort(s->times, s->count, sizeof(uint64_t), compareTimes);
+	printf("%s,%s,%zu,%.6f,%.0f,%llu,%llu,%ld\n", workload, operation, s->count,
+		   s->total, s->total > 0 ? s->count / s->total : 0.0,
+		   (unsigned long long)s->times[s->count / 2],
+		   (unsigned long long)s->times[s->count * 99 / 100], rss);
+}
+
+/** @brief Mierzy funkcje na jednym rodzaju drzewa.
+* Dodaje @p forwards przekierowań, wyznacza przekierowania tylu samo
+* numerów bez indeksu wielokrokowego i z nim oraz tylu samo zapytań,
+* z których większość dotyczy @p HOT_NUMBERS numerów, bez pamięci
+* podręcznej i z nią, przekierowania na co
+* @p SLOW_RATIO numer i liczby nietrywialnych numerów, przekierowania na te
+* same numery w kopiach, z których właśnie usunięto przekierowania numerów
+* o wspólnej pierwszej cyfrze, przekierowania na te same numery w jednej
+* takiej kopii, a następnie usuwa przekierowania.
+* @param[in] w – rodzaj drzewa.
+* @param[in] forwards – liczba przekierowań.
+* @param[in] seed – ziarno generatora liczb losowych.
+* @param[in, out] samples – tablica @p OPERATIONS wyników pomiarów.
+* @return Wartość @p true, jeśli pomiar się powiódł.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool measure(Workload const *w, size_t forwards, uint64_t seed,
+					Samples *samples) {
+	struct PhoneForward *pf = phfwdNew();
+
+	if (pf == NULL)
+		return false;
+
+	uint64_t state = seed;
+	char stems[STEMS][NUMBER_LENGTH + 1];
+	char num1[NUMBER_LENGTH + 1], num2[NUMBER_LENGTH + 1];
+
+	for (int i = 0; i < STEMS; i++)
+		randomDigits(&state, stems[i], NUMBER_LENGTH);
+
+	// Generator dla dodawania i usuwania startuje z tego samego stanu, więc
+	// usuwane są dokładnie dodane wcześniej numery.
+	uint64_t first = state;
+	uint64_t sources = first;
+	uint64_t targets = nextRandom(&state);
+	uint64_t queries = nextRandom(&state);
+	bool ok = true;
+
+	for (size_t i = 0; ok && i < forwards; i++) {
+		randomSource(w, &sources, stems, num1);
+		randomTarget(w, &targets, num2);
+		uint64_t start = now();
+		ok = phfwdAdd(pf, num1, num2) || strcmp(num1, num2) == 0;
+		record(&samples[0], start);
+	}
+
+	// Z indeksem wyznaczamy przekierowania tych samych numerów.
+	uint64_t lookups = queries;
+
+	for (int k = 1; k <= 2; k++) {
+		queries = lookups;
+		ok = ok && phfwdStrideIndex(pf, k == 2);
+
+		for (size_t i = 0; ok && i < forwards; i++) {
+			randomQuery(w, &queries, stems, num1);
+			uint64_t start = now();
+			struct PhoneNumbers const *ph = phfwdGet(pf, num1);
+			record(&samples[k], start);
+			ok = ph != NULL;
+			phnumDelete(ph);
+		}
+	}
+
+	phfwdStrideIndex(pf, false);
+
+	// Poza co COLD_RATIO zapytaniem pytamy o jeden z tych samych numerów.
+	char hot[HOT_NUMBERS][NUMBER_LENGTH + 1];
+
+	for (int i = 0; i < HOT_NUMBERS; i++)
+		randomQuery(w, &queries, stems, hot[i]);
+
+	lookups = queries;
+
+	for (int k = 3; k <= 4; k++) {
+		queries = lookups;
+		ok = ok && phfwdCache(pf, k == 4);
+
+		for (size_t i = 0; ok && i < forwards; i++) {
+			char const *num = num1;
+
+			if (nextRandom(&queries) % COLD_RATIO != 0)
+				num = hot[nextRandom(&queries) % HOT_NUMBERS];
+			else
+				randomQuery(w, &queries, stems, num1);
+
+			uint64_t start = now();
+			struct PhoneNumbers const *ph = phfwdGet(pf, num);
+			record(&samples[k], start);
+			ok = ph != NULL;
+			phnumDelete(ph);
+		}
+	}
+
+	phfwdCache(pf, false);
+
+	uint64_t reverses = queries;
+
+	for (size_t i = 0; ok && i < forwards / SLOW_RATIO; i++) {
+		randomReverseQuery(w, &queries, num1);
+		uint64_t start = now();
+		struct PhoneNumbers const *ph = phfwdReverse(pf, num1);
+		record(&samples[5], start);
+		ok = ph != NULL;
+		phnumDelete(ph);
+	}
+
+	for (size_t i = 0; ok && i < forwards / SLOW_RATIO; i++) {
+		char set[ALPHABET_SIZE + 1];
+		size_t n = randomLength(&queries, 1, ALPHABET_SIZE);
+		randomDigits(&queries, set, n);
+		set[n] = '\0';
+		size_t len = randomLength(&queries, 1, w->sourceMax);
+		uint64_t start = now();
+		phfwdNonTrivialCount(pf, set, len);
+		record(&samples[6], start);
+	}
+
+	// Zapytanie następuje tuż po usunięciu, gdy klucze usuniętych
+	// przekierowań są jeszcze w indeksie odwrotnym kopii.
+	uint64_t removals = queries;
+	queries = reverses;
+
+	for (size_t i = 0; ok && i < forwards / SLOW_RATIO; i++) {
+		randomReverseQuery(w, &queries, num1);
+		randomSource(w, &removals, stems, num2);
+		num2[1] = '\0';
+		struct PhoneForward *copy = phfwdCopy(pf);
+		ok = copy != NULL;
+
+		if (ok) {
+			phfwdRemove(copy, num2);
+			uint64_t start = now();
+			struct PhoneNumbers const *ph = phfwdReverse(copy, num1);
+			record(&samples[8], start);
+			ok = ph != NULL;
+			phnumDelete(ph);
+		}
+
+		phfwdDelete(copy);
+	}
+
+	// Po jednym usunięciu zapytania następują po sobie, a po każdym z nich,
+	// jak w interfejsie tekstowym, wykonywana jest część odłożonego
+	// usuwania, której czas wliczamy do zapytania.
+	queries = reverses;
+	randomSource(w, &removals, stems, num2);
+	num2[1] = '\0';
+	struct PhoneForward *copy = ok ? phfwdCopy(pf) : NULL;
+	ok = ok && copy != NULL;
+
+	if (ok)
+		phfwdRemove(copy, num2);
+
+	for (size_t i = 0; ok && i < forwards / SLOW_RATIO; i++) {
+		randomReverseQuery(w, &queries, num1);
+		uint64_t start = now();
+		struct PhoneNumbers const *ph = phfwdReverse(copy, num1);
+		phfwdReclaim(copy);
+		record(&samples[9], start);
+		ok = ph != NULL;
+		phnumDelete(ph);
+	}
+
+	phfwdDelete(copy);
+	sources = first;
+
+	for (size_t i = 0; ok && i < forwards; i++) {
+		randomSource(w, &sources, stems, num1);
+		uint64_t start = now();
+		phfwdRemove(pf, num1);
+		record(&samples[7], start);
+	}
+
+	phfwdDelete(pf);
+
+	return ok;
+}
+
+/** @brief Mierzy funkcje na jednym rodzaju drzewa i wypisuje wyniki.
+* Wywoływana w procesie potomnym, więc maksymalne zużycie pamięci procesu
+* dotyczy tylko tego rodzaju drzewa.
+* @param[in] w – rodzaj drzewa.
+* @param[in] forwards – liczba przekierowań.
+* @param[in] seed – ziarno generatora liczb losowych.
+* @return Wartość @p 0, gdy pomiar się powiódł.
+*         Wartość @p 1, gdy nie udało się zaalokować pamięci.
+*/
+static int runWorkload(Workload const *w, size_t forwards, uint64_t seed) {
+	Samples samples[OPERATIONS];
+	bool ok = true;
+
+	for (int k = 0; k < OPERATIONS; k++) {
+		samples[k].times = (uint64_t*)malloc(sizeof(uint64_t) * forwards);
+		samples[k].count = 0;
+		samples[k].total = 0;
+		ok = ok && samples[k].times != NULL;
+	}
+
+	ok = ok && measure(w, forwards, seed, samples);
+
+	if (ok) {
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+
+		for (int k = 0; k < OPERATIONS; k++)
+			report(w->name, operationNames[k], samples + k, usage.ru_maxrss);
+	}
+	else {
+		fprintf(stderr, "ERROR MEMORY\n");
+	}
+
+	for (int k = 0; k < OPERATIONS; k++)
+		free(samples[k].times);
+
+	return ok ? 0 : 1;
+}
+
+/** @brief Uruchamia test wydajności.
+* @param[in] argc – liczba argumentów.
+* @param[in] argv – argumenty: liczba przekierowań i ziarno generatora.
+* @return Wartość @p 0, gdy test zakończy się poprawnie.
+*         Wartość @p 1, gdy test zakończy się błędem.
+*/
+int main(int argc, char *argv[]) {
+	long forwards = argc > 1 ? atol(argv[1]) : DEFAULT_FORWARDS;
+	uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 10) : DEFAULT_SEED;
+
+	if (forwards <= 0 || seed == 0) {
+		fprintf(stderr, "usage: %s [forwards] [seed]\n", argv[0]);
+		return 1;
+	}
+
+	printf("workload,operation,calls,seconds,calls_per_s,p50_ns,p99_ns,"
+		   "peak_rss_kb\n");
+
+	for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+		// Bufor wyjścia opróżniamy przed rozwidleniem, by nie wypisać go dwa
+		// razy.
+		fflush(stdout);
+		pid_t pid = fork();
+
+		if (pid == 0) {
+			int code = runWorkload(workloads + i, forwards, seed);
+			fflush(stdout);
+			_exit(code);
+		}
+
+		int status;
+
+		// Proces potomny sam zgłasza brak pamięci.
+		if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+			fprintf(stderr, "ERROR %s\n", workloads[i].name);
+			return 1;
+		}
+
+		if (WEXITSTATUS(status) != 0)
+			return 1;
+	}
+
+	return 0;
+}
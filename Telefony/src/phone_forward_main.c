@@ -9,21 +9,47 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include "phone_forward.h"
 #include "text_interface.h"
 #include "phone_forward_base.h"
+#include "phone_forward_server.h"
 
 /** @brief Pozwala wykonywać operacje na bazach.
 * Umożliwia wykonywanie operacji opisanych w treści zadania 
-* przez interfejs tekstowy.
+* przez interfejs tekstowy. Wywołany z argumentami @p -s @p ścieżka
+* działa jako serwer, który przyjmuje operacje od wielu klientów przez
+* gniazdo uniksowe o podanej ścieżce i przechowuje bazy między
+* połączeniami.
+* @param[in] argc - liczba argumentów.
+* @param[in] argv - argumenty wywołania.
 * @return Wartość @p 0, gdy działanie programu zakończy się poprawnie.
 * 		  Wartość @p 1, gdy działanie programu zakończy się błędem.
 */
-int main() {
-	Reader *r = newReader();
+int main(int argc, char *argv[]) {
+	if (argc == 3 && strcmp(argv[1], "-s") == 0) {
+		Head *h = newHead();
+
+		if (h == NULL) {
+			printMemoryError();
+			return 1;
+		}
+
+		int returnCode = runServer(h, argv[2]);
+		clearAll(h);
+
+		return returnCode;
+	}
+
+	// Wyniki i błędy wypisujemy przez własne bufory zamiast przez stdio.
+	Output *out = newOutput(STDOUT_FILENO);
+	Output *err = newOutput(STDERR_FILENO);
+	Reader *r = out == NULL || err == NULL ? NULL : newReader(out, err);
 
 
 	if (r == NULL) {
+		clearOutput(out);
+		clearOutput(err);
 		printMemoryError();
 		return 1;
 	}
@@ -32,6 +58,8 @@ int main() {
 
 	if (h == NULL) {
 		clearReader(r);
+		clearOutput(out);
+		clearOutput(err);
 		printMemoryError();
 		return 1;
 	}
@@ -40,14 +68,18 @@ int main() {
 
 	while (1) {
 		int n = processOperation(r, h);
+		reclaimRecent(h);
 		if (n != GO_ON) {
 			processOperationReturnCode = n;
 			break;
 		}
 	}
 
+	flushOutput(out);
 	clearAll(h);
 	clearReader(r);
+	clearOutput(out);
+	clearOutput(err);
 	int returnCode = processOperationReturnCode - 1;
 
 	return returnCode;
@@ -0,0 +1,508 @@
+/** @file
+ * Implementacja klasy udostępniającej interfejs tekstowy przez gniazdo
+ * uniksowe.
+ *
+ * Wszystkie połączenia obsługuje jeden wątek w pętli zdarzeń epoll, więc
+ * centrala nie wymaga synchronizacji. Bezczynne połączenie zajmuje tylko
+ * swoją strukturę i strukturę wczytującą: dane od klienta są przetwarzane
+ * bezpośrednio ze wspólnego bufora odczytu, w buforze połączenia
+ * przechowywany jest jedynie niedokończony fragment operacji, a bufor
+ * z wynikami istnieje tylko do czasu ich wysłania.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "phone_forward_server.h"
+#include "text_interface.h"
+
+/// Maksymalna liczba zdarzeń pobieranych jednym wywołaniem epoll_wait.
+#define MAX_EVENTS 64
+
+/// Rozmiar wspólnego bufora odczytu.
+#define READ_SIZE 65536
+
+/// Maksymalna liczba znaków niedokończonej operacji jednego połączenia.
+#define INPUT_LIMIT (16u << 20)
+
+/// Komunikat wysyłany klientowi, którego operacja przekroczyła limit.
+#define INPUT_ERROR "ERROR operacja przekracza limit długości"
+
+/**
+ * Struktura przechowująca stan połączenia z klientem.
+ */
+typedef struct Connection {
+	int fd;                          ///< deskryptor gniazda połączenia
+	Reader *r;                       ///< struktura wczytująca operacje
+	Output *out;                     ///< bufor z wynikami do wysłania lub NULL
+	size_t sent;                     ///< liczba wysłanych znaków wyników
+	char *input;                     ///< niedokończony fragment operacji
+	size_t inputSize;                ///< długość fragmentu @p input
+	size_t inputCapacity;            ///< rozmiar bufora @p input
+	char *recent;                    ///< identyfikator aktualnej bazy lub NULL
+	bool closed;                     ///< czy klient zakończył wysyłanie
+	bool done;                       ///< czy należy zamknąć połączenie
+	struct Connection *prev;         ///< poprzednie połączenie na liście
+	struct Connection *next;         ///< następne połączenie na liście
+} Connection;
+
+/// Czy otrzymano sygnał kończący działanie serwera.
+static volatile sig_atomic_t stopping = 0;
+
+/// Wspólny bufor, do którego odczytywane są dane od klientów.
+static char readBuffer[READ_SIZE];
+
+/** @brief Obsługuje sygnał kończący działanie serwera.
+* @param[in] sig - numer sygnału.
+*/
+static void handleStop(int sig) {
+	(void)sig;
+	stopping = 1;
+}
+
+/** @brief Tworzy gniazdo nasłuchujące.
+* Usuwa pozostawione gniazdo o tej samej ścieżce, nie usuwa jednak innych
+* plików.
+* @param[in] path - Wskaźnik na ścieżkę gniazda.
+* @return Deskryptor gniazda lub @p -1, gdy nie udało się go utworzyć.
+*/
+static int listenOn(char const *path) {
+	struct sockaddr_un addr;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	struct stat st;
+
+	if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0)
+		return -1;
+
+	if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0
+		|| bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0
+		|| listen(fd, SOMAXCONN) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/** @brief Tworzy bufor z wynikami połączenia, jeśli go nie ma.
+* @param[in, out] c - Wskaźnik na połączenie.
+* @return Wartość @p true, jeśli bufor istnieje.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool openOutput(Connection *c) {
+	if (c->out == NULL)
+		c->out = newOutput(-1);
+
+	return c->out != NULL;
+}
+
+/** @brief Zwalnia bufor z wynikami połączenia.
+* @param[in, out] c - Wskaźnik na połączenie.
+*/
+static void closeOutput(Connection *c) {
+	clearOutput(c->out);
+	c->out = NULL;
+	c->sent = 0;
+}
+
+/** @brief Zamyka połączenie.
+* Usuwa połączenie z listy i zwalnia zajmowaną przez nie pamięć.
+* @param[in, out] list - Wskaźnik na początek listy połączeń.
+* @param[in] c - Wskaźnik na zamykane połączenie.
+*/
+static void closeConnection(Connection **list, Connection *c) {
+	if (c->prev != NULL)
+		c->prev->next = c->next;
+	else
+		*list = c->next;
+
+	if (c->next != NULL)
+		c->next->prev = c->prev;
+
+	close(c->fd);
+	clearReader(c->r);
+	closeOutput(c);
+	free(c->input);
+	free(c->recent);
+	free(c);
+}
+
+/** @brief Tworzy połączenie.
+* @param[in, out] list - Wskaźnik na początek listy połączeń.
+* @param[in] fd - Deskryptor gniazda połączenia.
+* @return Wskaźnik na utworzone połączenie lub NULL, gdy nie udało się
+*         zaalokować pamięci.
+*/
+static Connection * openConnection(Connection **list, int fd) {
+	Connection *c = (Connection*)malloc(sizeof(Connection));
+
+	if (c == NULL)
+		return NULL;
+
+	c->r = newBufferReader();
+
+	if (c->r == NULL) {
+		free(c);
+		return NULL;
+	}
+
+	c->fd = fd;
+	c->out = NULL;
+	c->sent = 0;
+	c->input = NULL;
+	c->inputSize = 0;
+	c->inputCapacity = 0;
+	c->recent = NULL;
+	c->closed = false;
+	c->done = false;
+	c->prev = NULL;
+	c->next = *list;
+
+	if (*list != NULL)
+		(*list)->prev = c;
+
+	*list = c;
+
+	return c;
+}
+
+/** @brief Zapamiętuje aktualną bazę połączenia.
+* @param[in] h - Wskaźnik na centralę.
+* @param[in, out] c - Wskaźnik na połączenie.
+* @return Wartość @p true, jeśli udało się zapamiętać bazę.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool rememberBase(Head *h, Connection *c) {
+	char const *name = recentBase(h);
+
+	if (name == NULL || c->recent == NULL || strcmp(name, c->recent) != 0) {
+		free(c->recent);
+		c->recent = name == NULL ? NULL : strdup(name);
+
+		if (name != NULL && c->recent == NULL)
+			return false;
+	}
+
+	return true;
+}
+
+/** @brief Zapewnia miejsce na niedokończony fragment operacji.
+* Bufor rośnie geometrycznie, więc dopisywanie kolejnych znaków fragmentu
+* zajmuje łącznie czas liniowy względem jego długości.
+* @param[in, out] c - Wskaźnik na połączenie.
+* @param[in] size - Wymagany rozmiar bufora.
+* @return Wartość @p true, jeśli bufor ma wymagany rozmiar.
+*         Wartość @p false, gdy nie udało się zaalokować pamięci.
+*/
+static bool reserveInput(Connection *c, size_t size) {
+	if (size <= c->inputCapacity)
+		return true;
+
+	size_t capacity = 2 * c->inputCapacity;
+
+	if (capacity < size)
+		capacity = size;
+
+	char *input = (char*)realloc(c->input, capacity);
+
+	if (input == NULL)
+		return false;
+
+	c->input = input;
+	c->inputCapacity = capacity;
+
+	return true;
+}
+
+/** @brief Wykonuje operacje przesłane przez klienta.
+* Wykonuje operacje zapisane w niedokończonym fragmencie połączenia
+* uzupełnionym o znaki @p data i zapamiętuje nowy niedokończony fragment.
+* Fragment dłuższy niż @p INPUT_LIMIT kończy połączenie.
+* @param[in] h - Wskaźnik na centralę.
+* @param[in, out] c - Wskaźnik na połączenie.
+* @param[in] data - Wskaźnik na nowe znaki od klienta.
+* @param[in] n - Liczba nowych znaków.
+*/
+static void serveInput(Head *h, Connection *c, char const *data, size_t n) {
+	if (!openOutput(c)) {
+		c->done = true;
+		return;
+	}
+
+	if (c->inputSize > 0) {
+		if (!reserveInput(c, c->inputSize + n)) {
+			printLine(c->out, MEMORY_ERROR);
+			c->done = true;
+			return;
+		}
+
+		memcpy(c->input + c->inputSize, data, n);
+		c->inputSize += n;
+		data = c->input;
+		n = c->inputSize;
+	}
+
+	size_t used;
+	selectBase(h, c->recent);
+	int x = processInput(c->r, h, data, n, c->closed, c->out, &used);
+	reclaimRecent(h);
+
+	if (!rememberBase(h, c)) {
+		printLine(c->out, MEMORY_ERROR);
+		x = ERROR;
+	}
+
+	if (x != GO_ON) {
+		c->done = true;
+		return;
+	}
+
+	// Przechowujemy niedokończony fragment operacji.
+	n -= used;
+
+	if (n > INPUT_LIMIT) {
+		printLine(c->out, INPUT_ERROR);
+		c->done = true;
+		return;
+	}
+
+	if (n == 0) {
+		free(c->input);
+		c->input = NULL;
+		c->inputCapacity = 0;
+	}
+	else if (data == c->input) {
+		if (used > 0)
+			memmove(c->input, c->input + used, n);
+	}
+	else {
+		if (!reserveInput(c, n)) {
+			printLine(c->out, MEMORY_ERROR);
+			c->done = true;
+			return;
+		}
+
+		memcpy(c->input, data + used, n);
+	}
+
+	c->inputSize = n;
+}
+
+/** @brief Wysyła klientowi wyniki operacji.
+* @param[in, out] c - Wskaźnik na połączenie.
+* @return Wartość @p true, jeśli wysłano wszystkie wyniki lub gniazdo nie
+*         przyjmuje chwilowo więcej danych.
+*         Wartość @p false, gdy połączenie zostało przerwane.
+*/
+static bool sendOutput(Connection *c) {
+	if (c->out == NULL)
+		return true;
+
+	size_t size = outputLength(c->out);
+	char const *output = outputData(c->out);
+
+	while (c->sent < size) {
+		ssize_t n = send(c->fd, output + c->sent, size - c->sent, MSG_NOSIGNAL);
+
+		if (n < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+		c->sent += n;
+	}
+
+	closeOutput(c);
+
+	return true;
+}
+
+/** @brief Sprawdza, czy są wyniki czekające na wysłanie.
+* @param[in] c - Wskaźnik na połączenie.
+* @return Wartość @p true, jeśli nie wszystkie wyniki zostały wysłane.
+*/
+static bool pendingOutput(Connection *c) {
+	if (c->out == NULL)
+		return false;
+
+	return c->sent < outputLength(c->out);
+}
+
+/** @brief Obsługuje zdarzenie na połączeniu.
+* Odczytuje dane od klienta, wykonuje przesłane operacje i wysyła wyniki.
+* Dopóki klient nie odbierze wszystkich wyników, kolejne dane nie są
+* odczytywane.
+* @param[in] h - Wskaźnik na centralę.
+* @param[in] epfd - Deskryptor epoll.
+* @param[in, out] list - Wskaźnik na początek listy połączeń.
+* @param[in] c - Wskaźnik na połączenie.
+* @param[in] events - Zdarzenia zgłoszone przez epoll.
+*/
+static void serveConnection(Head *h, int epfd, Connection **list,
+							Connection *c, uint32_t events) {
+	if (!pendingOutput(c) && !c->done
+		&& (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0) {
+		ssize_t n = read(c->fd, readBuffer, READ_SIZE);
+
+		if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+			closeConnection(list, c);
+			return;
+		}
+
+		if (n == 0)
+			c->closed = true;
+
+		if (n >= 0)
+			serveInput(h, c, readBuffer, n);
+	}
+
+	if (!sendOutput(c) || (c->done && !pendingOutput(c))) {
+		closeConnection(list, c);
+		return;
+	}
+
+	struct epoll_event ev;
+	ev.events = pendingOutput(c) ? EPOLLOUT : EPOLLIN;
+	ev.data.ptr = c;
+	epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+/** @brief Przyjmuje oczekujące połączenia.
+* @param[in] listener - Deskryptor gniazda nasłuchującego.
+* @param[in] epfd - Deskryptor epoll.
+* @param[in, out] list - Wskaźnik na początek listy połączeń.
+*/
+static void acceptConnections(int listener, int epfd, Connection **list) {
+	while (true) {
+		int fd = accept(listener, NULL, NULL);
+
+		if (fd < 0)
+			return;
+
+		Connection *c = NULL;
+
+		if (fcntl(fd, F_SETFL, O_NONBLOCK) == 0)
+			c = openConnection(list, fd);
+
+		if (c == NULL) {
+			close(fd);
+			continue;
+		}
+
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = c;
+
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+			closeConnection(list, c);
+	}
+}
+
+int runServer(Head *h, char const *path) {
+	int listener = listenOn(path);
+
+	if (listener < 0) {
+		fprintf(stderr, "%s %s\n", "ERROR SOCKET", path);
+		return 1;
+	}
+
+	int epfd = epoll_create1(0);
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+
+	if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, listener, &ev) < 0) {
+		fprintf(stderr, "%s %s\n", "ERROR SOCKET", path);
+
+		if (epfd >= 0)
+			close(epfd);
+
+		close(listener);
+		unlink(path);
+		return 1;
+	}
+
+	// Sygnały kończące są blokowane poza oczekiwaniem na zdarzenia, dzięki
+	// czemu nie mogą przerwać wykonywania operacji.
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handleStop;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	sigset_t blocked, waiting;
+	sigemptyset(&blocked);
+	sigaddset(&blocked, SIGINT);
+	sigaddset(&blocked, SIGTERM);
+	sigprocmask(SIG_BLOCK, &blocked, &waiting);
+	sigdelset(&waiting, SIGINT);
+	sigdelset(&waiting, SIGTERM);
+
+	Connection *list = NULL;
+	struct epoll_event events[MAX_EVENTS];
+	int returnCode = 0;
+	bool pending = false;
+
+	// Gdy nie ma zdarzeń, pętla wykonuje odłożone usuwanie przekierowań,
+	// a czeka bez ograniczenia czasu dopiero po jego zakończeniu.
+	while (!stopping) {
+		int n = epoll_pwait(epfd, events, MAX_EVENTS, pending ? 0 : -1, &waiting);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			returnCode = 1;
+			break;
+		}
+
+		if (n == 0) {
+			pending = reclaimBases(h);
+			continue;
+		}
+
+		pending = true;
+
+		for (int i = 0; i < n; i++) {
+			if (events[i].data.ptr == NULL)
+				acceptConnections(listener, epfd, &list);
+			else
+				serveConnection(h, epfd, &list, (Connection*)events[i].data.ptr,
+								events[i].events);
+		}
+	}
+
+	while (list != NULL)
+		closeConnection(&list, list);
+
+	close(epfd);
+	close(listener);
+	unlink(path);
+	sigprocmask(SIG_UNBLOCK, &blocked, NULL);
+
+	return returnCode;
+}
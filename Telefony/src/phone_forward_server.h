@@ -0,0 +1,28 @@
+/** @file
+ * Interfejs klasy udostępniającej interfejs tekstowy przez gniazdo
+ * uniksowe.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#ifndef __PHONE_FORWARD_SERVER_H__
+#define __PHONE_FORWARD_SERVER_H__
+
+#include "phone_forward_base.h"
+
+/** @brief Obsługuje klientów łączących się przez gniazdo.
+ * Nasłuchuje na gnieździe uniksowym @p path i wykonuje operacje interfejsu
+ * tekstowego przesyłane przez połączonych klientów na wspólnej centrali
+ * @p h, odsyłając im wyniki i komunikaty o błędach. Każde połączenie ma
+ * własną aktualną bazę, pamiętaną przez jej identyfikator. Błąd w operacji
+ * kończy tylko połączenie, w którym wystąpił. Połączenie kończy też
+ * niedokończona operacja, której długość przekroczy ustalony limit. Funkcja kończy działanie po
+ * otrzymaniu sygnału SIGINT lub SIGTERM.
+ * @param[in] h - Wskaźnik na centralę.
+ * @param[in] path - Wskaźnik na ścieżkę gniazda.
+ * @return Wartość @p 0, gdy serwer zakończy się poprawnie.
+ *         Wartość @p 1, gdy nie uda się utworzyć gniazda lub wystąpi błąd.
+ */
+int runServer(Head *h, char const *path);
+
+#endif /* __PHONE_FORWARD_SERVER_H__ */
@@ -0,0 +1,186 @@
+/** @file
+ * Implementacja klasy zbierającej statystyki operacji na przekierowaniach.
+ *
+ * Czasy operacji trafiają do histogramów o przedziałach
+ * logarytmiczno-liniowych, takich jak w HdrHistogram: zapisanie czasu to
+ * wyznaczenie numeru przedziału z pozycji najstarszego bitu i atomowe
+ * zwiększenie jednego licznika, bez blokad i bez alokacji. Liczby wywołań
+ * są dokładne, a czas mierzony jest dla próbki wywołań.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <time.h>
+#include "phone_forward_stats.h"
+
+/// Liczba bitów numeru podprzedziału w obrębie potęgi dwójki.
+#define SUB_BITS 2
+
+/// Licznik przydzielający wątkom ich zestawy liczników.
+static atomic_uint nextShard = 0;
+
+/// Numer zestawu liczników bieżącego wątku powiększony o 1 lub 0.
+static _Thread_local unsigned shard = 0;
+
+/// Liczby wywołań operacji kolejnych rodzajów w bieżącym wątku.
+static _Thread_local unsigned sample[PHFWD_OPERATIONS];
+
+/** @brief Podaje zestaw liczników bieżącego wątku.
+* @return Numer zestawu liczników.
+*/
+static unsigned threadShard(void) {
+	if (shard == 0)
+		shard = 1 + atomic_fetch_add_explicit(&nextShard, 1, memory_order_relaxed)
+				% STATS_SHARDS;
+
+	return shard - 1;
+}
+
+/** @brief Wyznacza przedział histogramu.
+* @param[in] time - czas w nanosekundach.
+* @return Numer przedziału, do którego należy czas.
+*/
+static size_t bucketOf(uint64_t time) {
+	if (time < PHFWD_SUB_BUCKETS)
+		return time;
+
+	int e = 63 - __builtin_clzll(time);
+	size_t bucket = PHFWD_SUB_BUCKETS * (e - SUB_BITS + 1)
+					+ ((time >> (e - SUB_BITS)) & (PHFWD_SUB_BUCKETS - 1));
+
+	return bucket < PHFWD_BUCKETS ? bucket : PHFWD_BUCKETS - 1;
+}
+
+uint64_t phstatsBucketLimit(size_t bucket) {
+	if (bucket < PHFWD_SUB_BUCKETS)
+		return bucket;
+
+	if (bucket >= PHFWD_BUCKETS - 1)
+		return UINT64_MAX;
+
+	int e = bucket / PHFWD_SUB_BUCKETS + SUB_BITS - 1;
+	uint64_t sub = PHFWD_SUB_BUCKETS + bucket % PHFWD_SUB_BUCKETS;
+
+	return ((sub + 1) << (e - SUB_BITS)) - 1;
+}
+
+uint64_t phstatsPercentile(struct PhoneForwardStats const *stats,
+						   enum PhoneForwardOperation op, double p) {
+	if (stats == NULL || op >= PHFWD_OPERATIONS)
+		return 0;
+
+	uint64_t total = 0;
+
+	for (size_t b = 0; b < PHFWD_BUCKETS; b++)
+		total += stats->histogram[op][b];
+
+	if (total == 0)
+		return 0;
+
+	// Szukamy przedziału, w którym leży wywołanie o numerze rank.
+	uint64_t rank = (uint64_t)(p * total);
+
+	if (rank >= total)
+		rank = total - 1;
+
+	uint64_t seen = 0;
+
+	for (size_t b = 0; b < PHFWD_BUCKETS; b++) {
+		seen += stats->histogram[op][b];
+
+		if (seen > rank)
+			return phstatsBucketLimit(b);
+	}
+
+	return phstatsBucketLimit(PHFWD_BUCKETS - 1);
+}
+
+void initStats(Stats *s) {
+	for (int i = 0; i < STATS_SHARDS; i++)
+		atomic_init(&s->shards[i], NULL);
+}
+
+void clearStats(Stats *s) {
+	for (int i = 0; i < STATS_SHARDS; i++)
+		free(atomic_load(&s->shards[i]));
+}
+
+uint64_t statsClock(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (uint64_t)t.tv_sec * 1000000000u + t.tv_nsec;
+}
+
+/** @brief Podaje zestaw liczników bieżącego wątku, tworząc go w razie potrzeby.
+* @param[in] s - wskaźnik na statystyki.
+* @return Wskaźnik na zestaw liczników lub NULL, gdy nie udało się
+*         zaalokować pamięci.
+*/
+static StatsShard * getShard(Stats *s) {
+	_Atomic(StatsShard*) *slot = &s->shards[threadShard()];
+	StatsShard *sh = atomic_load_explicit(slot, memory_order_acquire);
+
+	if (sh != NULL)
+		return sh;
+
+	StatsShard *fresh = (StatsShard*)calloc(1, sizeof(StatsShard));
+
+	if (fresh == NULL)
+		return NULL;
+
+	// Zestaw mógł w międzyczasie utworzyć inny wątek.
+	if (atomic_compare_exchange_strong(slot, &sh, fresh))
+		return fresh;
+
+	free(fresh);
+
+	return sh;
+}
+
+uint64_t startCall(Stats *s, enum PhoneForwardOperation op) {
+	StatsShard *sh = getShard(s);
+
+	if (sh == NULL)
+		return 0;
+
+	atomic_fetch_add_explicit(&sh->calls[op], 1, memory_order_relaxed);
+
+	return sample[op]++ % STATS_SAMPLE == 0 ? statsClock() : 0;
+}
+
+void recordTime(Stats *s, enum PhoneForwardOperation op, uint64_t time) {
+	StatsShard *sh = getShard(s);
+
+	if (sh != NULL)
+		atomic_fetch_add_explicit(&sh->histogram[op][bucketOf(time)], 1,
+								  memory_order_relaxed);
+}
+
+void collectStats(Stats *s, struct PhoneForwardStats *stats) {
+	for (int op = 0; op < PHFWD_OPERATIONS; op++) {
+		stats->calls[op] = 0;
+
+		for (size_t b = 0; b < PHFWD_BUCKETS; b++)
+			stats->histogram[op][b] = 0;
+	}
+
+	for (int i = 0; i < STATS_SHARDS; i++) {
+		StatsShard *sh = atomic_load_explicit(&s->shards[i], memory_order_acquire);
+
+		if (sh == NULL)
+			continue;
+
+		for (int op = 0; op < PHFWD_OPERATIONS; op++) {
+			stats->calls[op] += atomic_load_explicit(&sh->calls[op],
+													 memory_order_relaxed);
+
+			for (size_t b = 0; b < PHFWD_BUCKETS; b++)
+				stats->histogram[op][b] += atomic_load_explicit(&sh->histogram[op][b],
+																memory_order_relaxed);
+		}
+	}
+}
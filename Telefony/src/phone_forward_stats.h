@@ -0,0 +1,92 @@
+/** @file
+ * Interfejs klasy zbierającej statystyki operacji na przekierowaniach.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#ifndef __PHONE_FORWARD_STATS_H__
+#define __PHONE_FORWARD_STATS_H__
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include "phone_forward.h"
+
+/// Liczba zestawów liczników jednej struktury.
+#define STATS_SHARDS 16
+
+/// Co które wywołanie operacji danego rodzaju w wątku ma mierzony czas.
+#define STATS_SAMPLE 8
+
+/** @brief Zestaw liczników.
+* Liczniki jednego zestawu zwiększają wątki, którym przydzielono ten sam
+* zestaw, zwykle tylko jeden.
+*/
+typedef struct StatsShard {
+	/// Liczby wywołań operacji.
+	atomic_uint_fast64_t calls[PHFWD_OPERATIONS];
+	/// Liczby mierzonych wywołań w kolejnych przedziałach histogramów.
+	atomic_uint_fast64_t histogram[PHFWD_OPERATIONS][PHFWD_BUCKETS];
+} StatsShard;
+
+/** @brief Statystyki operacji na strukturze.
+* Każdy wątek zwiększa liczniki swojego zestawu, tworzonego przy pierwszym
+* użyciu, więc wątki nie blokują się wzajemnie.
+*/
+typedef struct Stats {
+	/// Zestawy liczników lub NULL, gdy nie zostały jeszcze utworzone.
+	_Atomic(StatsShard*) shards[STATS_SHARDS];
+} Stats;
+
+/** @brief Inicjuje statystyki.
+* @param[out] s - wskaźnik na inicjowane statystyki.
+*/
+void initStats(Stats *s);
+
+/** @brief Zwalnia statystyki.
+* @param[in] s - wskaźnik na zwalniane statystyki.
+*/
+void clearStats(Stats *s);
+
+/** @brief Podaje bieżący czas.
+* @return Czas w nanosekundach od ustalonej chwili.
+*/
+uint64_t statsClock(void);
+
+/** @brief Zlicza rozpoczynane wywołanie operacji.
+* Odczyt zegara kosztuje więcej niż wiele operacji, więc mierzony jest czas
+* tylko co @p STATS_SAMPLE-tego wywołania operacji danego rodzaju w wątku,
+* poczynając od pierwszego. Gdy nie uda się zaalokować zestawu liczników,
+* wywołanie nie jest liczone.
+* @param[in] s - wskaźnik na statystyki.
+* @param[in] op - rodzaj operacji.
+* @return Wynik funkcji @ref statsClock, gdy czas wywołania ma być
+*         zmierzony, lub @p 0 w przeciwnym przypadku.
+*/
+uint64_t startCall(Stats *s, enum PhoneForwardOperation op);
+
+/** @brief Zapisuje czas mierzonego wywołania operacji.
+* @param[in] s - wskaźnik na statystyki.
+* @param[in] op - rodzaj operacji.
+* @param[in] time - czas wywołania w nanosekundach.
+*/
+void recordTime(Stats *s, enum PhoneForwardOperation op, uint64_t time);
+
+/** @brief Kończy wywołanie operacji.
+* @param[in] s - wskaźnik na statystyki.
+* @param[in] op - rodzaj operacji.
+* @param[in] start - wynik funkcji @ref startCall z chwili rozpoczęcia.
+*/
+static inline void endCall(Stats *s, enum PhoneForwardOperation op,
+						   uint64_t start) {
+	if (start != 0)
+		recordTime(s, op, statsClock() - start);
+}
+
+/** @brief Sumuje liczniki wszystkich wątków.
+* Wypełnia liczby wywołań i histogramy statystyk @p stats.
+* @param[in] s - wskaźnik na statystyki.
+* @param[out] stats - wskaźnik na wypełniane statystyki.
+*/
+void collectStats(Stats *s, struct PhoneForwardStats *stats);
+
+#endif /* __PHONE_FORWARD_STATS_H__ */
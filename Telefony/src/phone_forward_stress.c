@@ -0,0 +1,238 @@
+/** @file
+ * Wielowątkowy test obciążeniowy przekierowań współdzielonych przez wątki.
+ * Dla kolejnych liczb wątków czytających mierzy łączną liczbę odczytów na
+ * sekundę, podczas gdy jeden wątek na bieżąco dodaje i usuwa przekierowania.
+ *
+ * Użycie: phone_forward_stress [wątki] [sekundy] [przekierowania]
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "concurrent_forward.h"
+
+/// Domyślna maksymalna liczba wątków czytających.
+#define DEFAULT_THREADS 8
+
+/// Domyślny czas jednego pomiaru w sekundach.
+#define DEFAULT_SECONDS 1
+
+/// Domyślna liczba przekierowań w strukturze.
+#define DEFAULT_FORWARDS 100000
+
+/// Maksymalna długość generowanego numeru.
+#define NUMBER_LENGTH 12
+
+/**
+ * Stan jednego pomiaru współdzielony przez wątki.
+ */
+typedef struct {
+	struct ConcurrentForward *cf; ///< badana struktura
+	atomic_bool stop;             ///< czy należy zakończyć pomiar
+	atomic_ullong reads;          ///< łączna liczba odczytów
+	atomic_ullong writes;         ///< łączna liczba modyfikacji
+} Stress;
+
+/**
+ * Argumenty wątku.
+ */
+typedef struct {
+	Stress *stress; ///< stan pomiaru
+	uint64_t seed;  ///< ziarno generatora liczb losowych
+} Worker;
+
+/** @brief Losuje liczbę.
+* @param[in, out] state – stan generatora xorshift.
+* @return Wylosowana liczba.
+*/
+static uint64_t nextRandom(uint64_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+
+	return *state;
+}
+
+/** @brief Losuje numer.
+* @param[in, out] state – stan generatora liczb losowych.
+* @param[out] buf – bufor na numer mieszczący @p NUMBER_LENGTH + 1 znaków.
+* @param[in] min – minimalna długość numeru.
+*/
+static void randomNumber(uint64_t *state, char *buf, size_t min) {
+	size_t n = min + nextRandom(state) % (NUMBER_LENGTH - min + 1);
+
+	for (size_t i = 0; i < n; i++)
+		buf[i] = '0' + nextRandom(state) % 10;
+
+	buf[n] = '\0';
+}
+
+/** @brief Podaje bieżący czas.
+* @return Czas w sekundach od ustalonej chwili.
+*/
+static double now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/** @brief Wykonuje odczyty aż do końca pomiaru.
+* @param[in] arg – wskaźnik na strukturę @ref Worker.
+* @return NULL.
+*/
+static void * reader(void *arg) {
+	Worker *w = (Worker*)arg;
+	uint64_t state = w->seed;
+	unsigned long long reads = 0;
+	char num[NUMBER_LENGTH + 1];
+
+	while (!atomic_load_explicit(&w->stress->stop, memory_order_relaxed)) {
+		randomNumber(&state, num, NUMBER_LENGTH);
+		struct PhoneNumbers const *ph = nextRandom(&state) % 16 == 0
+			? phcfReverse(w->stress->cf, num)
+			: phcfGet(w->stress->cf, num);
+		phnumDelete(ph);
+		reads++;
+	}
+
+	atomic_fetch_add(&w->stress->reads, reads);
+
+	return NULL;
+}
+
+/** @brief Wykonuje modyfikacje aż do końca pomiaru.
+* @param[in] arg – wskaźnik na strukturę @ref Worker.
+* @return NULL.
+*/
+static void * writer(void *arg) {
+	Worker *w = (Worker*)arg;
+	uint64_t state = w->seed;
+	unsigned long long writes = 0;
+	char num1[NUMBER_LENGTH + 1], num2[NUMBER_LENGTH + 1];
+
+	while (!atomic_load_explicit(&w->stress->stop, memory_order_relaxed)) {
+		randomNumber(&state, num1, 6);
+
+		if (nextRandom(&state) % 4 == 0) {
+			phcfRemove(w->stress->cf, num1);
+		}
+		else {
+			randomNumber(&state, num2, 3);
+			phcfAdd(w->stress->cf, num1, num2);
+		}
+
+		writes++;
+	}
+
+	atomic_fetch_add(&w->stress->writes, writes);
+
+	return NULL;
+}
+
+/** @brief Przeprowadza jeden pomiar.
+* @param[in] cf – badana struktura.
+* @param[in] threads – liczba wątków czytających.
+* @param[in] seconds – czas pomiaru w sekundach.
+* @return Wartość @p true, jeśli udało się uruchomić wątki.
+*/
+static bool measure(struct ConcurrentForward *cf, int threads, double seconds) {
+	Stress stress = { .cf = cf };
+	atomic_init(&stress.stop, false);
+	atomic_init(&stress.reads, 0);
+	atomic_init(&stress.writes, 0);
+
+	pthread_t ids[threads + 1];
+	Worker workers[threads + 1];
+	int started = 0;
+
+	for (int i = 0; i <= threads; i++) {
+		workers[i].stress = &stress;
+		workers[i].seed = 0x9E3779B97F4A7C15ull * (i + 1);
+	}
+
+	double start = now();
+
+	if (pthread_create(&ids[started], NULL, writer, &workers[0]) == 0)
+		started++;
+
+	while (started > 0 && started <= threads
+		   && pthread_create(&ids[started], NULL, reader, &workers[started]) == 0)
+		started++;
+
+	struct timespec pause = { .tv_sec = (time_t)seconds,
+		.tv_nsec = (long)((seconds - (time_t)seconds) * 1e9) };
+	nanosleep(&pause, NULL);
+	atomic_store(&stress.stop, true);
+
+	for (int i = 0; i < started; i++)
+		pthread_join(ids[i], NULL);
+
+	double elapsed = now() - start;
+
+	if (started != threads + 1)
+		return false;
+
+	unsigned long long reads = atomic_load(&stress.reads);
+	unsigned long long writes = atomic_load(&stress.writes);
+	printf("%3d %14.0f %14.0f %14.0f\n", threads, reads / elapsed,
+		   reads / elapsed / threads, writes / elapsed);
+
+	return true;
+}
+
+/** @brief Uruchamia test obciążeniowy.
+* @param[in] argc – liczba argumentów.
+* @param[in] argv – argumenty: maksymalna liczba wątków czytających, czas
+*                   jednego pomiaru w sekundach i liczba przekierowań.
+* @return Wartość @p 0, gdy test zakończy się poprawnie.
+*         Wartość @p 1, gdy test zakończy się błędem.
+*/
+int main(int argc, char *argv[]) {
+	int threads = argc > 1 ? atoi(argv[1]) : DEFAULT_THREADS;
+	double seconds = argc > 2 ? atof(argv[2]) : DEFAULT_SECONDS;
+	long forwards = argc > 3 ? atol(argv[3]) : DEFAULT_FORWARDS;
+
+	if (threads < 1 || seconds <= 0 || forwards < 0) {
+		fprintf(stderr, "usage: %s [threads] [seconds] [forwards]\n", argv[0]);
+		return 1;
+	}
+
+	struct PhoneForward *pf = phfwdNew();
+	uint64_t state = 88172645463325252ull;
+	char num1[NUMBER_LENGTH + 1], num2[NUMBER_LENGTH + 1];
+
+	for (long i = 0; pf != NULL && i < forwards; i++) {
+		randomNumber(&state, num1, 6);
+		randomNumber(&state, num2, 3);
+		phfwdAdd(pf, num1, num2);
+	}
+
+	struct ConcurrentForward *cf = phcfFrom(pf);
+
+	if (cf == NULL) {
+		fprintf(stderr, "ERROR MEMORY\n");
+		return 1;
+	}
+
+	printf("%3s %14s %14s %14s\n", "thr", "reads/s", "reads/s/thr", "writes/s");
+
+	for (int t = 1; t <= threads; t++)
+		if (!measure(cf, t, seconds)) {
+			fprintf(stderr, "ERROR THREADS\n");
+			phcfDelete(cf);
+			return 1;
+		}
+
+	phcfDelete(cf);
+
+	return 0;
+}
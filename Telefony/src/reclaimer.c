@@ -0,0 +1,266 @@
+/** @file
+ * Implementacja klasy stopniowo usuwającej z indeksu odwrotnego
+ * przekierowania poddrzew odłączonych od drzewa przekierowań.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "reclaimer.h"
+
+/// Początkowy rozmiar stosu odłączonych poddrzew.
+#define INITIAL_QUEUE 4
+
+Reclaimer * newReclaimer(void) {
+	Reclaimer *r = (Reclaimer*)malloc(sizeof(Reclaimer));
+
+	if (r == NULL)
+		return NULL;
+
+	r->queue = NULL;
+	r->queueSize = 0;
+	r->queueCapacity = 0;
+	r->roots = NULL;
+	r->rootsSize = 0;
+	r->rootsCapacity = 0;
+	r->stack = NULL;
+	r->stackSize = 0;
+	r->stackCapacity = 0;
+	r->path = NULL;
+	r->key = NULL;
+	r->maxSource = 0;
+	r->maxTarget = 0;
+
+	return r;
+}
+
+void clearReclaimer(Reclaimer *r, NodePool *pool) {
+	if (r == NULL)
+		return;
+
+	if (pool != NULL) {
+		for (size_t i = 0; i < r->queueSize; i++)
+			deferBlock(pool, r->queue[i].kids,
+						 __builtin_popcount(r->queue[i].mask), true);
+
+		if (r->stackSize > 0)
+			deferBlock(pool, r->stack[0].kids, r->stack[0].n, true);
+	}
+
+	free(r->queue);
+	free(r->roots);
+	free(r->stack);
+	free(r->path);
+	free(r->key);
+	free(r);
+}
+
+Reclaimer * copyReclaimer(Reclaimer const *r, NodePool *pool) {
+	Reclaimer *copy = newReclaimer();
+
+	if (copy == NULL)
+		return NULL;
+
+	copy->queue = (Detached*)malloc(sizeof(Detached) * r->queueCapacity);
+	copy->roots = (char*)malloc(sizeof(char) * r->rootsCapacity);
+	copy->stack = (Frame*)malloc(sizeof(Frame) * r->stackCapacity);
+	copy->path = (char*)malloc(sizeof(char) * r->maxSource);
+	copy->key = (char*)malloc(sizeof(char) * (r->maxTarget + 1 + r->maxSource));
+
+	if (copy->queue == NULL || copy->roots == NULL || copy->stack == NULL
+		|| copy->path == NULL || copy->key == NULL) {
+		clearReclaimer(copy, NULL);
+		return NULL;
+	}
+
+	memcpy(copy->queue, r->queue, sizeof(Detached) * r->queueSize);
+	memcpy(copy->roots, r->roots, sizeof(char) * r->rootsSize);
+	memcpy(copy->stack, r->stack, sizeof(Frame) * r->stackSize);
+	memcpy(copy->path, r->path, sizeof(char) * r->maxSource);
+	copy->queueSize = r->queueSize;
+	copy->queueCapacity = r->queueCapacity;
+	copy->rootsSize = r->rootsSize;
+	copy->rootsCapacity = r->rootsCapacity;
+	copy->stackSize = r->stackSize;
+	copy->stackCapacity = r->stackCapacity;
+	copy->maxSource = r->maxSource;
+	copy->maxTarget = r->maxTarget;
+
+	// Głębsze bloki przeglądanego poddrzewa należą do bloku stack[0].
+	for (size_t i = 0; i < r->queueSize; i++)
+		pool->refs[r->queue[i].kids]++;
+
+	if (r->stackSize > 0)
+		pool->refs[r->stack[0].kids]++;
+
+	return copy;
+}
+
+bool reserveReclaimer(Reclaimer *r, size_t len, size_t maxSource,
+					  size_t maxTarget) {
+	if (r->queueSize == r->queueCapacity) {
+		size_t capacity = r->queueCapacity == 0 ? INITIAL_QUEUE : 2 * r->queueCapacity;
+		Detached *queue = (Detached*)realloc(r->queue, sizeof(Detached) * capacity);
+
+		if (queue == NULL)
+			return false;
+
+		r->queue = queue;
+		r->queueCapacity = capacity;
+	}
+
+	if (r->rootsCapacity - r->rootsSize < len) {
+		size_t capacity = 2 * r->rootsCapacity;
+
+		if (capacity - r->rootsSize < len)
+			capacity = r->rootsSize + len;
+
+		char *roots = (char*)realloc(r->roots, sizeof(char) * capacity);
+
+		if (roots == NULL)
+			return false;
+
+		r->roots = roots;
+		r->rootsCapacity = capacity;
+	}
+
+	if (maxSource <= r->maxSource && maxTarget <= r->maxTarget)
+		return true;
+
+	maxSource = maxSource > r->maxSource ? maxSource : r->maxSource;
+	maxTarget = maxTarget > r->maxTarget ? maxTarget : r->maxTarget;
+
+	// Każdy blok na ścieżce wydłuża numer, więc ścieżka ma co najwyżej
+	// maxSource + 1 bloków. Bufory powiększamy przed zapisaniem rozmiarów,
+	// więc nieudana alokacja ich nie psuje.
+	Frame *stack = (Frame*)realloc(r->stack, sizeof(Frame) * (maxSource + 1));
+
+	if (stack == NULL)
+		return false;
+
+	r->stack = stack;
+	char *path = (char*)realloc(r->path, sizeof(char) * maxSource);
+
+	if (path == NULL)
+		return false;
+
+	r->path = path;
+	char *key = (char*)realloc(r->key, sizeof(char) * (maxTarget + 1 + maxSource));
+
+	if (key == NULL)
+		return false;
+
+	r->key = key;
+	r->stackCapacity = maxSource + 1;
+	r->maxSource = maxSource;
+	r->maxTarget = maxTarget;
+
+	return true;
+}
+
+void pushDetached(Reclaimer *r, NodeIdx kids, uint16_t mask, char const *key,
+				  size_t len) {
+	Detached *d = r->queue + r->queueSize++;
+	d->kids = kids;
+	d->mask = mask;
+	d->len = len;
+	memcpy(r->roots + r->rootsSize, key, len);
+	r->rootsSize += len;
+}
+
+bool liveKey(NodePool const *pool, NodeIdx root, char const *source, size_t n,
+			 char const *target, size_t m) {
+	NodeIdx idx = findKey(pool, root, source, n);
+	uint32_t value = idx == NO_NODE ? 0 : getNode(pool, idx)->value;
+
+	if (value == 0)
+		return false;
+
+	return numberSize(pool, value) == m
+		   && memcmp(getNumber(pool, value), target, m) == 0;
+}
+
+/** @brief Usuwa nieaktualny klucz indeksu odwrotnego.
+* Usuwa klucz y SEPARATOR x, gdzie x jest numerem odwiedzanego węzła
+* zapisanym w buforze @p path, a y numerem @p value, chyba że x jest
+* ponownie przekierowany na y.
+* @param[in,out] r - wskaźnik na strukturę przeglądającą.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] root - indeks korzenia drzewa przekierowań.
+* @param[in] reverse - indeks korzenia indeksu odwrotnego.
+* @param[in] len - długość numeru x.
+* @param[in] value - wartość identyfikująca numer y.
+*/
+static void eraseStale(Reclaimer *r, NodePool *pool, NodeIdx root,
+					   NodeIdx reverse, size_t len, uint32_t value) {
+	char const *target = getNumber(pool, value);
+	size_t n = numberSize(pool, value);
+
+	if (liveKey(pool, root, r->path, len, target, n))
+		return;
+
+	memcpy(r->key, target, n);
+	r->key[n] = SEPARATOR;
+	memcpy(r->key + n + 1, r->path, len);
+	eraseKey(pool, reverse, r->key, n + 1 + len, false);
+}
+
+bool reclaimSlice(Reclaimer *r, NodePool *pool, NodeIdx root, NodeIdx reverse,
+				  size_t budget) {
+	if (r == NULL)
+		return false;
+
+	for (size_t done = 0; done < budget; done++) {
+		if (r->stackSize == 0) {
+			if (r->queueSize == 0)
+				return false;
+
+			Detached const *d = r->queue + --r->queueSize;
+			r->rootsSize -= d->len;
+			memcpy(r->path, r->roots + r->rootsSize, d->len);
+			r->stack[0].kids = d->kids;
+			r->stack[0].n = __builtin_popcount(d->mask);
+			r->stack[0].next = 0;
+			r->stack[0].mask = d->mask;
+			r->stack[0].depth = d->len;
+			r->stackSize = 1;
+		}
+
+		Frame *f = r->stack + r->stackSize - 1;
+
+		// Przejrzane poddrzewo zwalnia pula, ale bloki głębsze od jego
+		// korzenia należą do niego aż do zwolnienia korzenia.
+		if (f->mask == 0) {
+			if (--r->stackSize == 0)
+				deferBlock(pool, f->kids, f->n, true);
+
+			continue;
+		}
+
+		int symbol = __builtin_ctz(f->mask);
+		f->mask &= f->mask - 1;
+		NodeIdx idx = f->kids + f->next++;
+		Node const *node = getNode(pool, idx);
+		uint16_t mask = node->mask;
+		NodeIdx kids = node->kids;
+		uint32_t value = node->value;
+		size_t depth = f->depth + 1 + node->length;
+		r->path[f->depth] = '0' + symbol;
+		memcpy(r->path + f->depth + 1, getLabel(pool, idx), node->length);
+
+		if (value != 0)
+			eraseStale(r, pool, root, reverse, depth, value);
+
+		if (mask != 0) {
+			Frame *g = r->stack + r->stackSize++;
+			g->kids = kids;
+			g->n = __builtin_popcount(mask);
+			g->next = 0;
+			g->mask = mask;
+			g->depth = depth;
+		}
+	}
+
+	return reclaimPending(r);
+}
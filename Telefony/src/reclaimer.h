@@ -0,0 +1,165 @@
+/** @file
+ * Interfejs klasy stopniowo usuwającej z indeksu odwrotnego przekierowania
+ * poddrzew odłączonych od drzewa przekierowań.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#ifndef __RECLAIMER_H__
+#define __RECLAIMER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "node_pool.h"
+
+/** @brief Odłączone poddrzewo oczekujące na przejrzenie.
+* Numer korzenia poddrzewa leży na końcu bufora numerów odłączonych
+* poddrzew, bo poddrzewa są przeglądane od ostatnio odłączonego.
+*/
+typedef struct Detached {
+	/// Indeks bloku dzieci korzenia poddrzewa.
+	NodeIdx kids;
+	/// Maska symboli dzieci korzenia poddrzewa.
+	uint16_t mask;
+	/// Długość numeru korzenia poddrzewa.
+	size_t len;
+} Detached;
+
+/** @brief Blok na ścieżce przeglądania poddrzewa.
+*/
+typedef struct Frame {
+	/// Indeks pierwszego węzła bloku.
+	NodeIdx kids;
+	/// Liczba węzłów bloku.
+	uint32_t n;
+	/// Pozycja w bloku następnego węzła do odwiedzenia.
+	uint32_t next;
+	/// Maska symboli węzłów bloku, które nie zostały jeszcze odwiedzone.
+	uint16_t mask;
+	/// Długość numeru rodzica węzłów bloku.
+	size_t depth;
+} Frame;
+
+/** @brief Struktura przeglądająca odłączone poddrzewa.
+* Poddrzewo odłączone przez usunięcie przekierowań jest przeglądane w głąb
+* po kilka węzłów na raz. Dla każdego przekierowania x na y usuwany jest
+* klucz y SEPARATOR x indeksu odwrotnego, o ile x nie został w międzyczasie
+* ponownie przekierowany na y. Przejrzane poddrzewo trafia na stos bloków
+* oczekujących na zwolnienie puli. Do czasu przejrzenia poddrzewa należy do
+* niego jedno odwołanie do bloku @p kids, więc nikt go nie zmienia.
+*/
+typedef struct Reclaimer {
+	/// Stos odłączonych poddrzew oczekujących na przejrzenie.
+	Detached *queue;
+	/// Liczba poddrzew na stosie @p queue.
+	size_t queueSize;
+	/// Rozmiar stosu @p queue.
+	size_t queueCapacity;
+	/// Numery korzeni poddrzew ze stosu @p queue.
+	char *roots;
+	/// Łączna długość numerów w buforze @p roots.
+	size_t rootsSize;
+	/// Rozmiar bufora @p roots.
+	size_t rootsCapacity;
+	/// Ścieżka przeglądanego poddrzewa, pusta, gdy żadne nie jest przeglądane.
+	Frame *stack;
+	/// Liczba bloków na ścieżce @p stack.
+	size_t stackSize;
+	/// Rozmiar tablicy @p stack.
+	size_t stackCapacity;
+	/// Numer odwiedzanego węzła.
+	char *path;
+	/// Bufor, w którym budowane są klucze indeksu odwrotnego.
+	char *key;
+	/// Rozmiar bufora @p path.
+	size_t maxSource;
+	/// Maksymalna długość numeru docelowego mieszcząca się w buforze @p key.
+	size_t maxTarget;
+} Reclaimer;
+
+/** @brief Tworzy pustą strukturę przeglądającą.
+* @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
+*         zaalokować pamięci.
+*/
+Reclaimer * newReclaimer(void);
+
+/** @brief Usuwa strukturę przeglądającą.
+* Nieprzejrzane poddrzewa odkłada do zwolnienia w puli @p pool, nie
+* usuwając ich przekierowań z indeksu odwrotnego.
+* @param[in] r - wskaźnik na usuwaną strukturę lub NULL.
+* @param[in] pool - wskaźnik na pulę lub NULL, gdy jest ona usuwana
+*                   w całości.
+*/
+void clearReclaimer(Reclaimer *r, NodePool *pool);
+
+/** @brief Kopiuje strukturę przeglądającą.
+* Kopia przegląda te same odłączone poddrzewa, więc zwiększane są liczniki
+* odwołań do ich bloków. Pula musi być przygotowana funkcją @ref sharePool.
+* @param[in] r - wskaźnik na kopiowaną strukturę.
+* @param[in,out] pool - wskaźnik na pulę.
+* @return Wskaźnik na kopię lub NULL, gdy nie udało się zaalokować pamięci.
+*/
+Reclaimer * copyReclaimer(Reclaimer const *r, NodePool *pool);
+
+/** @brief Przygotowuje miejsce na kolejne poddrzewo.
+* Zapewnia, że funkcja @ref pushDetached nie będzie potrzebowała pamięci.
+* @param[in,out] r - wskaźnik na strukturę przeglądającą.
+* @param[in] len - długość numeru korzenia poddrzewa.
+* @param[in] maxSource - długość najdłuższego numeru przekierowywanego.
+* @param[in] maxTarget - długość najdłuższego numeru docelowego.
+* @return Wartość @p true, jeśli udało się zaalokować pamięć.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+bool reserveReclaimer(Reclaimer *r, size_t len, size_t maxSource,
+					  size_t maxTarget);
+
+/** @brief Dodaje odłączone poddrzewo.
+* @param[in,out] r - wskaźnik na strukturę przygotowaną funkcją
+*                    @ref reserveReclaimer.
+* @param[in] kids - indeks bloku dzieci korzenia poddrzewa.
+* @param[in] mask - maska symboli dzieci korzenia poddrzewa.
+* @param[in] key - wskaźnik na numer korzenia poddrzewa.
+* @param[in] len - długość numeru.
+*/
+void pushDetached(Reclaimer *r, NodeIdx kids, uint16_t mask, char const *key,
+				  size_t len);
+
+/** @brief Przegląda część odłączonych poddrzew.
+* @param[in,out] r - wskaźnik na strukturę przeglądającą lub NULL.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] root - indeks korzenia drzewa przekierowań.
+* @param[in] reverse - indeks korzenia indeksu odwrotnego.
+* @param[in] budget - liczba węzłów, które można odwiedzić.
+* @return Wartość @p true, jeśli pozostały poddrzewa do przejrzenia.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+bool reclaimSlice(Reclaimer *r, NodePool *pool, NodeIdx root, NodeIdx reverse,
+				  size_t budget);
+
+/** @brief Sprawdza, czy klucz indeksu odwrotnego jest aktualny.
+* Klucz y SEPARATOR x przekierowania z odłączonego poddrzewa pozostaje
+* w indeksie odwrotnym do czasu przejrzenia poddrzewa. Jest on aktualny
+* wtedy i tylko wtedy, gdy x jest przekierowany na y.
+* @param[in] pool - wskaźnik na pulę.
+* @param[in] root - indeks korzenia drzewa przekierowań.
+* @param[in] source - wskaźnik na numer x.
+* @param[in] n - długość numeru x.
+* @param[in] target - wskaźnik na numer y.
+* @param[in] m - długość numeru y.
+* @return Wartość @p true, jeśli x jest przekierowany na y.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+bool liveKey(NodePool const *pool, NodeIdx root, char const *source, size_t n,
+			 char const *target, size_t m);
+
+/** @brief Sprawdza, czy są poddrzewa do przejrzenia.
+* @param[in] r - wskaźnik na strukturę przeglądającą lub NULL.
+* @return Wartość @p true, jeśli pozostały poddrzewa do przejrzenia.
+*         Wartość @p false w przeciwnym przypadku.
+*/
+static inline bool reclaimPending(Reclaimer const *r) {
+	return r != NULL && (r->queueSize > 0 || r->stackSize > 0);
+}
+
+#endif /* __RECLAIMER_H__ */
@@ -0,0 +1,156 @@
+/** @file
+ * Implementacja klasy przechowującej wielokrokowy indeks drzewa
+ * przekierowań.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "stride_index.h"
+
+/** @brief Wyznacza pozycję indeksu.
+* Przechodzi ścieżkę ciągu @p q długości @p STRIDE, zapamiętując ostatni
+* węzeł z wartością i ostatni węzeł, do którego prowadzi krawędź kończąca
+* się w obrębie ciągu.
+* @param[out] e - wskaźnik na wyznaczaną pozycję.
+* @param[in] pool - wskaźnik na pulę węzłów drzewa.
+* @param[in] root - indeks korzenia drzewa.
+* @param[in] q - wskaźnik na ciąg symboli.
+*/
+static void fillEntry(StrideEntry *e, NodePool const *pool, NodeIdx root,
+					  char const *q) {
+	NodeIdx idx = root;
+	size_t i = 0;
+	e->best = NO_NODE;
+	e->bestDepth = 0;
+	e->node = NO_NODE;
+	e->depth = 0;
+
+	while (i < STRIDE) {
+		NodeIdx child = getChild(pool, idx, q[i]);
+
+		// Ścieżka się urywa, więc dłuższych prefixów nie ma.
+		if (child == NO_NODE)
+			return;
+
+		Node const *node = getNode(pool, child);
+		size_t n = STRIDE - i - 1 < node->length ? STRIDE - i - 1 : node->length;
+
+		if (memcmp(getLabel(pool, child), q + i + 1, n) != 0)
+			return;
+
+		// Krawędź wychodzi poza ciąg, więc sprawdzi ją dalsze wyszukiwanie.
+		if (n < node->length)
+			break;
+
+		idx = child;
+		i += 1 + node->length;
+
+		if (node->value != 0) {
+			e->best = child;
+			e->bestDepth = i;
+		}
+	}
+
+	if (getNode(pool, idx)->mask != 0) {
+		e->node = idx;
+		e->depth = i;
+	}
+}
+
+StrideIndex * newStrideIndex(NodePool const *pool, NodeIdx root) {
+	StrideIndex *x = (StrideIndex*)malloc(sizeof(StrideIndex));
+
+	if (x == NULL)
+		return NULL;
+
+	refreshStrideIndex(x, pool, root, "", 0);
+
+	return x;
+}
+
+void clearStrideIndex(StrideIndex *x) {
+	free(x);
+}
+
+size_t strideRegion(NodePool const *pool, NodeIdx root, char const *key, size_t len,
+					bool erase) {
+	// Pozycje wskazują węzły leżące na ich ścieżkach, więc zmiana węzła lub
+	// przeniesienie bloku jego dzieci dotyczy tylko pozycji zaczynających
+	// się kluczem tego węzła.
+	size_t shared = STRIDE;
+	size_t changed = 0;
+	size_t depth = 0;
+	NodeIdx idx = root;
+
+	while (true) {
+		Node const *node = getNode(pool, idx);
+
+		// Dzielone bloki są kopiowane przed modyfikacją.
+		if (depth < shared && pool->refs != NULL && node->mask != 0
+			&& pool->refs[node->kids] > 1)
+			shared = depth;
+
+		// Usuwany węzeł znika razem z poddrzewem, a zmienia się ostatni
+		// pozostający węzeł powyżej niego, który ma wartość lub kilkoro
+		// dzieci. Wstawianie zmienia ostatni węzeł ścieżki.
+		if (erase && depth >= len)
+			break;
+
+		if (!erase || idx == root || node->value != 0
+			|| __builtin_popcount(node->mask) > 1)
+			changed = depth;
+
+		if (depth >= STRIDE || depth >= len)
+			break;
+
+		NodeIdx child = getChild(pool, idx, key[depth]);
+
+		if (child == NO_NODE)
+			break;
+
+		size_t length = getNode(pool, child)->length;
+
+		if (len - depth - 1 < length
+			|| memcmp(getLabel(pool, child), key + depth + 1, length) != 0)
+			break;
+
+		depth += 1 + length;
+		idx = child;
+	}
+
+	if (changed > shared)
+		changed = shared;
+
+	return changed < STRIDE ? changed : STRIDE;
+}
+
+void refreshStrideIndex(StrideIndex *x, NodePool const *pool, NodeIdx root,
+						char const *key, size_t region) {
+	char q[STRIDE];
+	size_t first = 0;
+	size_t count = 1;
+
+	for (size_t i = 0; i < region; i++)
+		first = first * ALPHABET_SIZE + (key[i] - '0');
+
+	for (size_t i = region; i < STRIDE; i++) {
+		first *= ALPHABET_SIZE;
+		count *= ALPHABET_SIZE;
+	}
+
+	memcpy(q, key, region);
+
+	// Pozycje zaczynające się prefixem zajmują spójny fragment tablicy.
+	for (size_t k = 0; k < count; k++) {
+		size_t rest = k;
+
+		for (size_t i = STRIDE; i > region; i--) {
+			q[i - 1] = '0' + rest % ALPHABET_SIZE;
+			rest /= ALPHABET_SIZE;
+		}
+
+		fillEntry(x->entries + first + k, pool, root, q);
+	}
+}
@@ -0,0 +1,114 @@
+/** @file
+ * Interfejs klasy przechowującej wielokrokowy indeks drzewa przekierowań.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#ifndef __STRIDE_INDEX_H__
+#define __STRIDE_INDEX_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "node_pool.h"
+
+/// Liczba symboli numeru, którą indeks pokonuje w jednym kroku.
+#define STRIDE 4
+
+/// Liczba pozycji indeksu, równa @p ALPHABET_SIZE do potęgi @p STRIDE.
+#define STRIDE_ENTRIES (ALPHABET_SIZE * ALPHABET_SIZE * ALPHABET_SIZE * ALPHABET_SIZE)
+
+/** @brief Pozycja indeksu.
+* Opisuje wszystkie numery zaczynające się danym ciągiem @p STRIDE symboli:
+* najdłuższy prefix tego ciągu, który ma przekierowanie, oraz węzeł,
+* od którego należy kontynuować wyszukiwanie dłuższych prefixów.
+*/
+typedef struct StrideEntry {
+	/// Węzeł najdłuższego prefixu z przekierowaniem lub @p NO_NODE.
+	NodeIdx best;
+	/// Najgłębszy węzeł ścieżki ciągu, leżący nie głębiej niż @p STRIDE,
+	/// lub @p NO_NODE, gdy w drzewie nie ma dłuższych prefixów numerów.
+	NodeIdx node;
+	/// Długość prefixu odpowiadającego węzłowi @p best.
+	uint8_t bestDepth;
+	/// Długość prefixu odpowiadającego węzłowi @p node.
+	uint8_t depth;
+} StrideEntry;
+
+/** @brief Wielokrokowy indeks drzewa przekierowań.
+* Tablica indeksowana pierwszymi @p STRIDE symbolami numeru, w stylu
+* tablic DIR-24-8 routerów: najlepsze dopasowanie krótkich prefixów jest
+* w niej zapisane dla każdego ciągu, który się nimi zaczyna, więc
+* wyszukiwanie zaczyna się od jednego odczytu zamiast @p STRIDE kroków
+* w drzewie. Pozycje wskazują węzły, a nie numery, bo upakowanie numerów
+* zmienia wartości węzłów, ale nie ich indeksy.
+*/
+typedef struct StrideIndex {
+	/// Pozycje indeksu.
+	StrideEntry entries[STRIDE_ENTRIES];
+} StrideIndex;
+
+/** @brief Tworzy indeks drzewa.
+* @param[in] pool - wskaźnik na pulę węzłów drzewa.
+* @param[in] root - indeks korzenia drzewa.
+* @return Wskaźnik na utworzony indeks lub NULL, gdy nie udało się
+*         zaalokować pamięci.
+*/
+StrideIndex * newStrideIndex(NodePool const *pool, NodeIdx root);
+
+/** @brief Usuwa indeks.
+* @param[in] x - wskaźnik na usuwany indeks.
+*/
+void clearStrideIndex(StrideIndex *x);
+
+/** @brief Wyznacza część indeksu, którą zmieni modyfikacja klucza.
+* Wstawienie lub usunięcie klucza zmienia jedynie bloki dzieci węzłów na
+* jego ścieżce, więc nieaktualne mogą stać się tylko pozycje zaczynające
+* się pewnym prefixem klucza. Funkcję należy wywołać przed modyfikacją.
+* Gdy wstawienie klucza się nie powiedzie, wycofanie zmian może dotyczyć
+* całego indeksu.
+* @param[in] pool - wskaźnik na pulę węzłów drzewa.
+* @param[in] root - indeks korzenia drzewa.
+* @param[in] key - wskaźnik na ciąg symboli klucza.
+* @param[in] len - długość klucza.
+* @param[in] erase - przyjmuje wartość @p true, gdy klucz będzie usuwany
+*                    razem z poddrzewem, a @p false, gdy będzie wstawiany.
+* @return Długość prefixu klucza, którym zaczynają się zmieniane pozycje,
+*         nie większa od @p STRIDE.
+*/
+size_t strideRegion(NodePool const *pool, NodeIdx root, char const *key, size_t len,
+					bool erase);
+
+/** @brief Odświeża część indeksu.
+* Wyznacza ponownie pozycje zaczynające się prefixem @p key długości
+* @p region.
+* @param[in,out] x - wskaźnik na indeks.
+* @param[in] pool - wskaźnik na pulę węzłów drzewa.
+* @param[in] root - indeks korzenia drzewa.
+* @param[in] key - wskaźnik na ciąg symboli.
+* @param[in] region - wynik funkcji @ref strideRegion.
+*/
+void refreshStrideIndex(StrideIndex *x, NodePool const *pool, NodeIdx root,
+						char const *key, size_t region);
+
+/** @brief Znajduje pozycję indeksu dla numeru.
+* @param[in] x - wskaźnik na indeks.
+* @param[in] num - wskaźnik na numer.
+* @param[in] n - długość numeru.
+* @return Wskaźnik na pozycję lub NULL, gdy numer jest krótszy od
+*         @p STRIDE symboli.
+*/
+static inline StrideEntry const * strideEntry(StrideIndex const *x, char const *num,
+											  size_t n) {
+	if (n < STRIDE)
+		return NULL;
+
+	size_t idx = 0;
+
+	for (int i = 0; i < STRIDE; i++)
+		idx = idx * ALPHABET_SIZE + (num[i] - '0');
+
+	return x->entries + idx;
+}
+
+#endif /* __STRIDE_INDEX_H__ */
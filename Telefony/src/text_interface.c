@@ -5,8 +5,12 @@
  * @author Philip Smolenski-Jensen
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include "phone_forward.h"
 #include "text_interface.h"
 #include "phone_forward_base.h"
@@ -15,43 +19,100 @@
 /// Znak oddzielający komentarze od poleceń.
 #define COMMENT_CHAR '$'
 
-/** @brief Element listy.
- * Struktura stanowiąca element listy. Składa się ze
- * wskaźników na elementy poprzedni i następny oraz znaku.
- */
-typedef struct Elem {
-    /// Znak przechowywany przez element.
-    char ch;
-    /// Wskaźnik na następny element.
-    struct Elem *next;
-    /// Wskaźnik na poprzedni element.
-    struct Elem *prev;
-}Elem;
-
-/** @brief Struktura listy
- * Struktura listy przechowująca znaki wczytane z wejścia.
- * Składa się ze wskaźników na pierwszy i ostatni element.
+/// Rozmiar porcji standardowego wejścia wczytywanej jednym wywołaniem read.
+#define READ_SIZE 65536
+
+/// Maksymalna długość komunikatu o błędzie.
+#define ERROR_LENGTH 64
+
+/// Maksymalna długość wiersza wypisywanego przez operację STATS.
+#define STATS_LENGTH 192
+
+/// Nazwy rodzajów operacji wypisywane przez operację STATS.
+static char const * const operationNames[PHFWD_OPERATIONS] = {
+	[PHFWD_ADD] = "add",
+	[PHFWD_REMOVE] = "remove",
+	[PHFWD_GET] = "get",
+	[PHFWD_GET_BATCH] = "get_batch",
+	[PHFWD_REVERSE] = "reverse",
+	[PHFWD_GET_REVERSE] = "get_reverse",
+	[PHFWD_REVERSE_COUNT] = "reverse_count",
+	[PHFWD_NON_TRIVIAL_COUNT] = "non_trivial_count"
+};
+
+/** @brief Blok pamięci bufora.
+ * Bufor struktury wczytującej odłożony do ponownego użycia lub do czasu
+ * zakończenia operacji, która korzysta z zapisanych w nim słów.
  */
-typedef struct List {
-    /// Wskaźnik na początek listy.
-    Elem *beg;
-    /// Wskaźnik na koniec listy.
-    Elem *end;
-}List;
+typedef struct Block {
+    /// Wskaźnik na pamięć bufora.
+    char *data;
+    /// Rozmiar bufora (bez miejsca na kończący znak '\0').
+    size_t capacity;
+}Block;
 
 /** @brief Struktura służąca do wczytywania wejścia.
- * Struktura przetwarzająca znaki wczytane ze standardowego wejścia.
- * zawiera wskaźnik na listę przechowywującą znaki oraz dwie wartości 
- * liczbowe: liczbę znaków znajdujących się aktualnie w liście oraz
- * liczę znaków dotychczas wczytanych.
+ * Struktura przetwarzająca znaki wczytane ze standardowego wejścia lub
+ * przekazane funkcją processInput. Znaki wczytywane są dużymi porcjami do
+ * bufora, a wczytane słowa są zwracane jako fragmenty tego bufora, w których
+ * znak kończący słowo zastąpiono znakiem '\0'. Dopóki wykonywana operacja
+ * korzysta ze swoich słów, bufor nie jest nadpisywany: kolejna porcja
+ * trafia wtedy do nowego bufora, a słowo przecinające granicę porcji jest
+ * przenoszone do niego w całości.
  */
 typedef struct Reader {
-    /// Wskaźnik na listę przechowującą znaki.
-    List *list;
-    /// Liczba znaków przechowywanych przez listę.
-    int size;
+    /// Bufor z wczytanymi znakami, z miejscem na dodatkowy znak '\0'.
+    char *buffer;
+    /// Rozmiar bufora (bez miejsca na dodatkowy znak).
+    size_t capacity;
+    /// Liczba znaków w buforze.
+    size_t length;
+    /// Pozycja następnego znaku do wczytania.
+    size_t pos;
+    /// Pozycja za ostatnim słowem bieżącej operacji zapisanym w buforze
+    /// lub 0, gdy bufor nie zawiera takich słów.
+    size_t liveEnd;
+    /// Zastąpione bufory ze słowami bieżącej operacji.
+    Block *retired;
+    /// Liczba zastąpionych buforów.
+    size_t retiredSize;
+    /// Rozmiar tablicy @p retired.
+    size_t retiredCapacity;
+    /// Wolny bufor do ponownego użycia (@p data ma wartość NULL, gdy go nie ma).
+    Block spare;
+    /// Ostatnio wczytany znak, który nie został jeszcze przetworzony.
+    char current;
+    /// Czy jest wczytany znak, który nie został jeszcze przetworzony.
+    bool hasCurrent;
+    /// Czy znak @p current znajduje się w buforze na pozycji @p pos - 1.
+    bool currentInBuffer;
     /// Liczba dotychczas wczytanych znaków z wejścia.
     int read;
+    /// Liczba znaków pobranych z bufora przekazanego funkcji processInput.
+    size_t consumed;
+    /// Długość ostatnio wczytanego słowa.
+    size_t wordLength;
+    /// Bufor, w którym zapisywane są wyniki przekierowań.
+    char *result;
+    /// Rozmiar bufora na wyniki przekierowań.
+    size_t resultSize;
+    /// Czy znaki wczytywane są ze standardowego wejścia.
+    bool stdinInput;
+    /// Czy po znakach z bufora nie pojawią się już kolejne.
+    bool closed;
+    /// Czy zabrakło znaków w buforze, choć mogą się jeszcze pojawić kolejne.
+    bool starved;
+    /// Stan automatu pomijającego komentarze i białe znaki, w którym brak
+    /// znaków przerwał operację, lub @p STATES, gdy przerwał on wczytywanie
+    /// innych znaków.
+    int scanState;
+    /// Liczba znaków z początku bufora przekazywanego funkcji processInput,
+    /// przejrzanych już bez zakończenia przerwanej operacji.
+    size_t scanned;
+    /// Bufor, do którego wypisywane są wyniki operacji.
+    Output *out;
+    /// Bufor, do którego wypisywane są błędy.
+    Output *err;
 }Reader;
 
 
@@ -60,77 +121,277 @@ enum ProcessIrrelevantResult {
 	OK, 
 	GOOD_EOF, 
 	ERROR_EOF, 
-	SYNTAX_ERROR, 
-	MEM_ERROR
+	SYNTAX_ERROR
 };
 
-/** @brief Tworzy listę.
-* Tworzy nową listę zawierającą tylko pierwszy i ostatni element 
-* (które są puste). 
-* @return Wskaźnik na utworzoną listę lub NULL gdy nie uda się 
-* 		  zaalokować pamięci.
-*/
-List * newList() {
-	List *l = (List*)malloc(sizeof(List));
-
-	if (l == NULL) 
-		return NULL;
-
-	l->beg = (Elem*)malloc(sizeof(Elem));
-	l->end = (Elem*)malloc(sizeof(Elem));
+/// Klasy znaków rozróżniane przy pomijaniu komentarzy i białych znaków.
+enum CharClass {
+	CHAR_OTHER,
+	CHAR_SPACE,
+	CHAR_COMMENT,
+	CHAR_END,
+	CHAR_CLASSES
+};
 
-	if (l->beg == NULL || l->end == NULL) {
-		free(l->beg);
-		free(l->end);
-		free(l);
-		return NULL; 
-	}
+/** @brief Klasy kolejnych znaków.
+* Znak o kodzie 255 jest równy EOF po zrzutowaniu na typ char, więc podobnie
+* jak w funkcji readChar kończy on wejście.
+*/
+static unsigned char const charClass[256] = {
+	['\t'] = CHAR_SPACE, ['\n'] = CHAR_SPACE, ['\v'] = CHAR_SPACE,
+	['\f'] = CHAR_SPACE, ['\r'] = CHAR_SPACE, [' '] = CHAR_SPACE,
+	[COMMENT_CHAR] = CHAR_COMMENT,
+	[(unsigned char)EOF] = CHAR_END
+};
 
-	l->beg->next = l->end;
-	l->end->prev = l->beg;
+/// Stany automatu pomijającego komentarze i białe znaki.
+enum LexerState {
+	BLANK,         ///< białe znaki między słowami
+	OPENING,       ///< pierwszy znak otwierający komentarz po białych znakach
+	GLUED_OPENING, ///< pierwszy znak otwierający komentarz tuż po słowie
+	COMMENT,       ///< treść komentarza
+	CLOSING,       ///< pierwszy znak zamykający komentarz
+	STATES
+};
 
-	return l;
-}
+/// Przejście do stanu końcowego z wynikiem @p x typu ProcessIrrelevantResult.
+#define FINAL(x) (STATES + (x))
 
-/** @brief Usuwa listę.
-* Usuwa listę oraz zwalnia całą pamięć przez nią zajmowaną. 
-* @param[in] l = Wskaźnik na usuwaną listę.
+/** @brief Funkcja przejścia automatu.
+* Dla stanu i klasy wczytanego znaku podaje kolejny stan lub, gdy
+* wczytywanie się kończy, wartość @ref FINAL z jego wynikiem.
 */
-void clearList (List *l) {
-	for (Elem *i = l->beg; i != l->end; ) {
-		Elem *next = i->next;
-		free(i);
-		i = next;
+static unsigned char const transition[STATES][CHAR_CLASSES] = {
+	[BLANK] = {
+		[CHAR_OTHER] = FINAL(OK), [CHAR_SPACE] = BLANK,
+		[CHAR_COMMENT] = OPENING, [CHAR_END] = FINAL(GOOD_EOF)
+	},
+	[OPENING] = {
+		[CHAR_OTHER] = FINAL(SYNTAX_ERROR), [CHAR_SPACE] = FINAL(SYNTAX_ERROR),
+		[CHAR_COMMENT] = COMMENT, [CHAR_END] = FINAL(ERROR_EOF)
+	},
+	[GLUED_OPENING] = {
+		[CHAR_OTHER] = FINAL(SYNTAX_ERROR), [CHAR_SPACE] = FINAL(SYNTAX_ERROR),
+		[CHAR_COMMENT] = COMMENT, [CHAR_END] = FINAL(SYNTAX_ERROR)
+	},
+	[COMMENT] = {
+		[CHAR_OTHER] = COMMENT, [CHAR_SPACE] = COMMENT,
+		[CHAR_COMMENT] = CLOSING, [CHAR_END] = FINAL(ERROR_EOF)
+	},
+	[CLOSING] = {
+		[CHAR_OTHER] = COMMENT, [CHAR_SPACE] = COMMENT,
+		[CHAR_COMMENT] = BLANK, [CHAR_END] = FINAL(ERROR_EOF)
 	}
+};
 
-	free(l->end);
-	free(l);
-}
-
-Reader * newReader() {
+Reader * newReader(Output *out, Output *err) {
 	Reader *r = (Reader*)malloc(sizeof(Reader));
 
 	if (r == NULL)
 		return NULL;
 
-	r->list = newList();
+	r->buffer = (char*)malloc(sizeof(char) * (READ_SIZE + 1));
 
-	if (r->list == NULL) {
+	if (r->buffer == NULL) {
 		free(r);
 		return NULL;
 	}
 
+	r->capacity = READ_SIZE;
+	r->length = 0;
+	r->pos = 0;
+	r->liveEnd = 0;
+	r->retired = NULL;
+	r->retiredSize = 0;
+	r->retiredCapacity = 0;
+	r->spare.data = NULL;
+	r->spare.capacity = 0;
+	r->current = ' ';
+	r->hasCurrent = false;
+	r->currentInBuffer = false;
 	r->read = 0;
-	r->size = 0;
+	r->consumed = 0;
+	r->wordLength = 0;
+	r->result = NULL;
+	r->resultSize = 0;
+	r->stdinInput = true;
+	r->closed = false;
+	r->starved = false;
+	r->scanState = STATES;
+	r->scanned = 0;
+	r->out = out;
+	r->err = err;
 
 	return r;
 }
 
+Reader * newBufferReader() {
+	Reader *r = newReader(NULL, NULL);
+
+	if (r == NULL)
+		return NULL;
+
+	// Bufor jest tworzony dopiero dla przekazanego wejścia, dzięki czemu
+	// nieaktywna struktura zajmuje mało pamięci.
+	free(r->buffer);
+	r->buffer = NULL;
+	r->capacity = 0;
+	r->stdinInput = false;
+	r->out = NULL;
+	r->err = NULL;
+
+	return r;
+}
+
+/** @brief Odkłada bufor do ponownego użycia.
+* Zachowuje większy z buforów @p b i wolnego bufora struktury, a drugi
+* zwalnia.
+* @param[in] r - Wskaźnik na strukturę wczytującą.
+* @param[in] b - Odkładany bufor.
+*/
+void releaseBlock(Reader *r, Block b) {
+	if (r->spare.data == NULL || r->spare.capacity < b.capacity) {
+		free(r->spare.data);
+		r->spare = b;
+	}
+	else {
+		free(b.data);
+	}
+}
+
+/** @brief Zwalnia słowa zakończonej operacji.
+* Odkłada bufory zastąpione w trakcie operacji i pozwala nadpisywać bieżący
+* bufor.
+* @param[in] r - Wskaźnik na strukturę wczytującą.
+*/
+void releaseWords(Reader *r) {
+	for (size_t i = 0; i < r->retiredSize; i++)
+		releaseBlock(r, r->retired[i]);
+
+	r->retiredSize = 0;
+	r->liveEnd = 0;
+}
+
 void clearReader(Reader *r) {
-	clearList(r->list);
+	releaseWords(r);
+	free(r->retired);
+	free(r->spare.data);
+	free(r->buffer);
+	free(r->result);
 	free(r);
 }
 
+/** @brief Przenosi nieprzetworzone znaki bufora.
+* Przenosi znaki bufora od pozycji @p from na pozycję @p to. Jeśli bufor
+* zawiera słowa bieżącej operacji lub jest mniejszy niż @p capacity, znaki
+* trafiają do nowego bufora, a stary jest zachowywany do końca operacji.
+* Nie zmienia pozycji następnego znaku.
+* @param[in] r - Wskaźnik na strukturę wczytującą.
+* @param[in] from - Pozycja pierwszego przenoszonego znaku.
+* @param[in] to - Pozycja, na którą jest on przenoszony.
+* @param[in] capacity - Minimalny rozmiar bufora.
+* @return Wartość @p true, jeżeli znaki przeniesiono pomyślnie.
+* 		  Wartość @p false, jeżeli nie udało się zaalokować pamięci.
+*/
+bool moveChars(Reader *r, size_t from, size_t to, size_t capacity) {
+	size_t n = r->length - from;
+
+	if (r->liveEnd == 0 && capacity <= r->capacity) {
+		memmove(r->buffer + to, r->buffer + from, n);
+		r->length = to + n;
+
+		return true;
+	}
+
+	if (r->liveEnd > 0 && r->retiredSize == r->retiredCapacity) {
+		size_t size = r->retiredCapacity == 0 ? 4 : 2 * r->retiredCapacity;
+		Block *retired = (Block*)realloc(r->retired, sizeof(Block) * size);
+
+		if (retired == NULL)
+			return false;
+
+		r->retired = retired;
+		r->retiredCapacity = size;
+	}
+
+	Block b = r->spare;
+
+	if (b.data != NULL && b.capacity >= capacity) {
+		r->spare.data = NULL;
+		r->spare.capacity = 0;
+	}
+	else {
+		b.capacity = capacity;
+		b.data = (char*)malloc(sizeof(char) * (capacity + 1));
+
+		if (b.data == NULL)
+			return false;
+	}
+
+	memcpy(b.data + to, r->buffer + from, n);
+	Block old = {r->buffer, r->capacity};
+
+	if (r->liveEnd > 0)
+		r->retired[r->retiredSize++] = old;
+	else if (old.data != NULL)
+		releaseBlock(r, old);
+
+	r->buffer = b.data;
+	r->capacity = b.capacity;
+	r->length = to + n;
+	r->liveEnd = 0;
+
+	return true;
+}
+
+/** @brief Wczytuje kolejną porcję wejścia.
+* Zachowuje znaki bufora od pozycji @p keep, przenosząc je na początek
+* bufora, i dopisuje za nimi kolejne znaki standardowego wejścia.
+* Gdy znaki pochodzą z bufora przekazanego funkcji processInput, kolejnych
+* znaków nie ma.
+* @param[in] r - Wskaźnik na strukturę wczytującą.
+* @param[in] keep - Pozycja pierwszego zachowywanego znaku.
+* @return Liczba dopisanych znaków, @p 0 gdy wejście się skończyło lub
+* 		  wartość @p -1, gdy nie udało się zaalokować pamięci.
+*/
+long refill(Reader *r, size_t keep) {
+	r->currentInBuffer = false;
+
+	if (!r->stdinInput) {
+		if (!r->closed && !r->starved) {
+			r->starved = true;
+			r->scanState = STATES;
+		}
+
+		return 0;
+	}
+
+	size_t n = r->length - keep;
+	size_t capacity = n < r->capacity ? r->capacity : 2 * r->capacity;
+
+	if (!moveChars(r, keep, 0, capacity))
+		return -1;
+
+	r->pos -= keep;
+
+	// Zanim zaczekamy na kolejne znaki, zapisujemy wyniki dotychczasowych
+	// operacji, by użytkownik wpisujący polecenia od razu je zobaczył.
+	flushOutput(r->out);
+
+	ssize_t got;
+
+	do
+		got = read(STDIN_FILENO, r->buffer + n, r->capacity - n);
+	while (got < 0 && errno == EINTR);
+
+	if (got <= 0)
+		return 0;
+
+	r->length += got;
+
+	return got;
+}
+
 /** @brief Wczytuje znak.
 * Wczytuje znak Readerem @p r zwiększając przy tym liczbę 
 * wczytanych liter.
@@ -138,82 +399,89 @@ void clearReader(Reader *r) {
 * @return wczytany znak.
 */
 char readChar(Reader *r) {
-	char c = getchar();
 	r->read++;
-	return c;
-} 
 
-/** @brief Dodaje znak do struktury wczytującej
-* Dodaje znak @p c do listy przechowującej litery, znajdującej się
-* w strukturze @p r.
+	if (r->pos == r->length && refill(r, r->length) <= 0)
+		return EOF;
+
+	r->consumed++;
+
+	return r->buffer[r->pos++];
+}
+
+/** @brief Podgląda następny znak.
+* Zwraca znak, który zostanie wczytany przez następne wywołanie funkcji
+* readChar, nie wczytując go.
 * @param[in] r - Wskaźnik na strukturę wczytującą.
-* @param[in] c - dodawany znak.
-* return Wartość @p true, jeżeli znak dodano pomyślnie.
-* 		 Wartość @p false, jeżeli nie udało się zaalokować pamięci.
+* @return Następny znak wejścia.
 */
-bool insertChar(Reader *r, char c) {
-	List *l = r->list;
-	Elem *e = (Elem*)malloc(sizeof(Elem));
+char peekChar(Reader *r) {
+	if (r->pos == r->length && refill(r, r->length) <= 0)
+		return EOF;
 
-	if (e == NULL)
-		return false;
-
-	e->ch = c;
-	Elem *last = l->end->prev;
-	e->next = l->end;
-	e->prev = last;
-	last->next = e;
-	l->end->prev = e;
-	r->size++;
+	return r->buffer[r->pos];
+}
 
-	return true;
+/** @brief Zapamiętuje ostatnio wczytany znak.
+* Zapamiętuje znak @p c, zwrócony przez ostatnie wywołanie funkcji readChar,
+* jako nieprzetworzony.
+* @param[in] r - Wskaźnik na strukturę wczytującą.
+* @param[in] c - Ostatnio wczytany znak.
+*/
+void keepChar(Reader *r, char c) {
+	r->current = c;
+	r->hasCurrent = true;
+	r->currentInBuffer = true;
 }
 
-/** @brief Usuwa znaki ze struktury wczytującej.
-* Usuwa znaki z końca listy należącej do struktury wczytującej.
+/** @brief Ustawia nieprzetworzony znak.
+* Ustawia znak @p c, który nie pochodzi z bufora, jako nieprzetworzony.
 * @param[in] r - Wskaźnik na strukturę wczytującą.
-* @param[in] remain - Liczba liter w liście, które pozostaną w liście po 
-* 					  wykonaniu operacji.
+* @param[in] c - Ustawiany znak.
 */
-void removeLetters(Reader *r, int remain) {
-	if (r->size <= remain)
-		return;
+void setCurrent(Reader *r, char c) {
+	r->current = c;
+	r->hasCurrent = true;
+	r->currentInBuffer = false;
+}
 
-	List *l = r->list;
-	while (r->size > remain) {
-		Elem *last = l->end->prev;
-		Elem *prev = last->prev;
-		prev->next = l->end;
-		l->end->prev = prev;
-		free(last);
-		r->size--;
-	}
+/** @brief Usuwa nieprzetworzony znak.
+* @param[in] r - Wskaźnik na strukturę wczytującą.
+*/
+void dropCurrent(Reader *r) {
+	r->hasCurrent = false;
+	r->currentInBuffer = false;
 }
 
-/** @brief Konwertuje napis do Stringa
-* Znaki znajdujące się w liście struktury wczytującej @p r wpisuje
-* do tablicy znaków i zwraca utworzony napis.
-* @param[in] r - Wskaźnik na strukturę wczytującą, która przechowuje znaki.
-* @return Tablica charów reprezentująca napis przechowywany w 
-*   	  strukturze wczytującej.
+/** @brief Umieszcza nieprzetworzony znak przed następnym znakiem bufora.
+* Słowo zaczyna się od nieprzetworzonego znaku, więc musi on poprzedzać
+* w buforze kolejne znaki słowa.
+* @param[in] r - Wskaźnik na strukturę wczytującą.
+* @return Wartość @p true, jeżeli znak umieszczono pomyślnie.
+* 		 Wartość @p false, jeżeli nie udało się zaalokować pamięci.
 */
-char * toString (Reader *r) {
-	int n = r->size;
-	List *l = r->list;
-	char *result = (char*)malloc(sizeof(char) * (n + 1));
+bool startToken(Reader *r) {
+	if (r->currentInBuffer)
+		return true;
 
-	if (result == NULL)
-		return NULL;
+	// Pozycja przed następnym znakiem nie należy do słowa bieżącej operacji.
+	if (r->pos > r->liveEnd) {
+		r->buffer[r->pos - 1] = r->current;
+	}
+	else {
+		size_t n = r->length - r->pos;
+		size_t capacity = n < r->capacity ? r->capacity : 2 * n + 1;
 
-	Elem *e = l->beg;
-	
-	for (int i = 0; i < n; i++) {
-		e = e->next;
-		result[i] = e->ch;
+		if (!moveChars(r, r->pos, 1, capacity))
+			return false;
+
+		r->buffer[0] = r->current;
+		r->pos = 1;
 	}
-	result[n] = '\0';
 
-	return result;
+	r->currentInBuffer = true;
+
+	return true;
 }
 
 /** @brief Sprawdza czy znak cyfrą
@@ -237,108 +505,59 @@ bool isLetter(char c) {
 	return isalpha(c) || (isDigit(c) && c != ':' && c != ';');
 }
 
-// 0 brak EOFa, jest ok
-// 1 EOF podczas czytania spacji
-// 2 EOF w komentarzu
-// 3 sekwencja $X, X != $ podczas wczytywania białych znaków
-// 4 zabrakło pamięci w trakcie wczytywania znaku
-
-/** @brief Wczytuje komentarze i białe znaki.
-* Wczytuje wczystkie białe znaki i komentarze, które mogą pojawić się 
-* między Stringami zawierającymi parametry do wywołania funkcji. 
-* Wczytuje również pierwszy znak kolejnej operacji i umieszcza go w liście 
-* struktury @p r oraz sprawdza czy podczas wczytywania 
-* wystąpił błąd, a jeśli tak to jakiego jest on typu.
-* @param[in] r - wskaźnik na strukturę wczytującą.
-* @param[in] comment - przyjmuje wartość @p true jeżeli funkcja 
-* 			 uruchamiana jest wewnątrz komentarza, zaś wartość @p false
-* 			 w przeciwnym przypadku.
-* @return Wartość @p ok, jeżeli pomyślnie wczytano komentarze i można kontynuować
-* 		  wczytywanie.
-* 		  Wartość @p GOOD_EOF, jeżeli struktura wczytująca natrafi na EOF podczas
-* 		  wczytywania białych znaków.
-*  		  Wartość @p ERROR_EOF, jeżeli struktura wczyta na EOF w obrębie komentarza.
-*		  Wartość @p SYNTAX_ERROR, gdy w trakcie wczytywania białych znaków natrafimy
-*		  na sekwencję $X, gdzie X jest znakiem różnym of $ i EOF.
-*		  Wartość @p MEM_ERROR, gdy nie uda się zaalokować pamięci podczas wczytywania.
-*			
-*/
-int readIrrelevant(Reader *r, bool comment) {
-	if (comment) {
-		bool last = false;
-		while (1) {
-			char c = readChar(r);
-
-			if (c == EOF)
-				return ERROR_EOF;
-
-			if (last && c == COMMENT_CHAR)
-				return readIrrelevant(r, false);
-
-			if (c == COMMENT_CHAR)
-				last = true;
-			else 
-				last = false;
-		}
-	}
-
-	else {
-		while (1) {
-			char c = readChar(r);
-
-			if (c == EOF)
-				return GOOD_EOF;
-
-			if (!isspace(c)) {
-				if (c != COMMENT_CHAR) {
-					bool b = insertChar(r, c);
-
-					if (b == false)
-						return MEM_ERROR;
-
-					return OK;
-				}
-
-				char d = readChar(r);
-
-				if (d == COMMENT_CHAR)
-					return readIrrelevant(r, true);
-
-				if (d == EOF)
-					return ERROR_EOF;
-
-				return SYNTAX_ERROR;
-			}
-		}
-	}
+/** @brief Wypisuje komunikat o błędzie.
+* Wypisuje komunikat @p message, zapisując przedtem wyniki poprzednich
+* operacji, i od razu zapisuje go do deskryptora.
+* @param[in] r - Wskaźnik na strukturę wczytującą znaki.
+* @param[in] message - Wskaźnik na treść komunikatu.
+*/
+void printReaderError(Reader *r, char const *message) {
+	flushOutput(r->out);
+	printLine(r->err, message);
+	flushOutput(r->err);
 }
 
 /** @brief Wypisuje błąd składniowy.
 * Wypisuje błąd składniowy, który pojawia się po wczytaniu
 * znaku o numerze @p n.
+* @param[in] r - Wskaźnik na strukturę wczytującą znaki.
 * @param[in] n - numer znaku, który wywołał błąd.
 */
-void printSyntaxError(int n) {
-	fprintf(stderr, "%s %d\n", "ERROR", n);
+void printSyntaxError(Reader *r, int n) {
+	char message[ERROR_LENGTH];
+	snprintf(message, ERROR_LENGTH, "%s %d", "ERROR", n);
+	printReaderError(r, message);
 }
 
-/// Wypisuje błąd spowodowany nagłym końcem pliku.
-void printErrorEOF() {
-	fprintf(stderr, "%s\n", "ERROR EOF");
+/** @brief Wypisuje błąd spowodowany nagłym końcem pliku.
+* @param[in] r - Wskaźnik na strukturę wczytującą znaki.
+*/
+void printErrorEOF(Reader *r) {
+	printReaderError(r, "ERROR EOF");
 }
 
 /** @brief Wypisuje błąd wykonania.
 * Wypisuje błąd wykonania operacji @p operator, 
 * który pojawia się po wczytaniu znaku o numerze @p n.
+* @param[in] r - Wskaźnik na strukturę wczytującą znaki.
 * @param[in] n - numer znaku, który wywołał błąd.
 * @param[in] operator - wskaźnik na napis reprezentujacy operator.
 */
-void printOperatorError(char const *operator, int n) {
-	fprintf(stderr, "%s %s %d\n", "ERROR", operator, n);
+void printOperatorError(Reader *r, char const *operator, int n) {
+	char message[ERROR_LENGTH];
+	snprintf(message, ERROR_LENGTH, "%s %s %d", "ERROR", operator, n);
+	printReaderError(r, message);
 }
 
 void printMemoryError() {
-	fprintf(stderr, "%s\n", "zabrakło pamięci przy wczytywaniu");
+	fprintf(stderr, "%s\n", MEMORY_ERROR);
+}
+
+/** @brief Wypisuje błąd spowodowany brakiem pamięci.
+* @param[in] r - Wskaźnik na strukturę wczytującą znaki.
+*/
+void printReaderMemoryError(Reader *r) {
+	printReaderError(r, MEMORY_ERROR);
 }
 
 /** @brief Wypisuje błąd wczytywania komentarzy.
@@ -355,35 +574,93 @@ void printError (Reader *r, int n, bool middle) {
 	// EOF w czasie wczytywania spacji.
 	if (n == GOOD_EOF) 
 		if (middle)
-			printErrorEOF();
+			printErrorEOF(r);
 
 	// EOF w czasie wczytywania komentarzy.
 	if (n == ERROR_EOF) 
-		printErrorEOF();
+		printErrorEOF(r);
 
 	// Sekwencja $X w czasie wczytywania spacji.
 	if (n == SYNTAX_ERROR)
-		printSyntaxError(r->read);
-
-	// Gdy nie uda się zaalokować pamięci przy wczytywaniu.
-	if (n == MEM_ERROR)
-		printMemoryError();
+		printSyntaxError(r, r->read);
 }
 
 
-/** @brief Sprawdza czy znak spełnie określoną własność.
-* Sprawdza, czy znak @p c jest cyfrą gdy @p num ma wartość false,
-* lub sprawdcza czy znak @p c jest literą w przeciwnym przypadku.
-* @param[in] c - znak, o którym chcemy dowiedzieć się, czy jest cyfrą/literą.
-* @param[in] num - jeżeli ma wartość @p true to sprawczamy czy @p c jest 
-* 			 cyfrą. W przeciwnym przypadku sprawdzamy czy jest literą.
-* @return Wartość @p true jeśli @p c spełnia opisaną wyżej własność.
+/** @brief Sprawdza czy znak może należeć do nazwy pliku.
+* Nazwa pliku składa się z widocznych znaków innych niż znak komentarza.
+* @param[in] c - znak, o którym chcemy dowiedzieć się, czy może należeć do
+* nazwy pliku.
+* @return Wartość @p true jeśli @p c może należeć do nazwy pliku.
 *		  Wartość @p false w przeciwnym przypadku.
 */
-bool isOK (char c, bool num) {
-	if (num)
-		return isDigit(c);
-	return isLetter(c);
+bool isPathChar(char c) {
+	return isgraph((unsigned char)c) && c != COMMENT_CHAR;
+}
+
+/** @brief Wczytuje słowo.
+* Wczytuje najdłuższy ciąg znaków spełniających własność @p accept,
+* zaczynający się od nieprzetworzonego znaku. Pierwszy znak, który jej nie
+* spełnia, staje się nieprzetworzonym znakiem struktury @p r.
+* @param[in] r - Wskaźnik na strukturę wczytującą.
+* @param[in] accept - funkcja sprawdzająca, czy znak należy do słowa.
+* @return Wskaźnik na wczytane słowo, ważny do końca przetwarzania bieżącej
+*		 operacji, lub NULL, jeśli nie uda się zaalokować pamięci.
+*/
+char * readToken(Reader *r, bool (*accept)(char)) {
+	if (!startToken(r)) {
+		printReaderMemoryError(r);
+		return NULL;
+	}
+
+	size_t start = r->pos - 1;
+
+	while (1) {
+		size_t i = r->pos;
+
+		while (i < r->length && accept(r->buffer[i]))
+			i++;
+
+		r->read += i - r->pos;
+		r->consumed += i - r->pos;
+		r->pos = i;
+
+		if (i < r->length)
+			break;
+
+		// Słowo sięga końca bufora, więc przenosimy je razem z kolejną
+		// porcją wejścia.
+		size_t offset = r->pos - start;
+		long got = refill(r, start);
+
+		if (got < 0) {
+			printReaderMemoryError(r);
+			return NULL;
+		}
+
+		start = r->pos - offset;
+
+		if (got == 0)
+			break;
+	}
+
+	// Wczytujemy znak kończący słowo i zastępujemy go znakiem '\0'.
+	r->wordLength = r->pos - start;
+	r->read++;
+
+	if (r->pos < r->length) {
+		setCurrent(r, r->buffer[r->pos]);
+		r->consumed++;
+		r->pos++;
+		r->buffer[r->pos - 1] = '\0';
+		r->liveEnd = r->pos;
+	}
+	else {
+		setCurrent(r, EOF);
+		r->buffer[r->pos] = '\0';
+		r->liveEnd = r->pos + 1;
+	}
+
+	return r->buffer + start;
 }
 
 /** @brief Wczytuje liczbę lub identyfikator.
@@ -396,58 +673,143 @@ bool isOK (char c, bool num) {
 *		 uda się zaalokować pamięci.
 */
 char * readWord(Reader *r, bool num) {
+	return readToken(r, num ? isDigit : isLetter);
+}
+
+/** @brief Podaje długość początku treści komentarza.
+* Wyszukuje w znakach @p s pierwszy znak komentarza lub znak kończący
+* wejście, przeglądając je funkcją memchr.
+* @param[in] s - Wskaźnik na pierwszy znak.
+* @param[in] n - Liczba znaków.
+* @return Liczba znaków poprzedzających znaleziony znak lub @p n, gdy go nie ma.
+*/
+size_t commentSpan(char const *s, size_t n) {
+	char const *end = memchr(s, COMMENT_CHAR, n);
+
+	if (end != NULL)
+		n = end - s;
+
+	// Znak kończący wejście w komentarzu jest bardzo rzadki, więc osobne
+	// przejrzenie znaków jest tańsze niż sprawdzanie każdego z nich.
+	end = memchr(s, (unsigned char)EOF, n);
+
+	return end == NULL ? n : (size_t)(end - s);
+}
+
+/** @brief Przegląda znaki automatem pomijającym komentarze i białe znaki.
+* Przegląda znaki @p s, aż automat opisany tablicą @ref transition osiągnie
+* stan końcowy lub skończą się znaki.
+* @param[in] s - Wskaźnik na pierwszy znak.
+* @param[in] n - Liczba znaków.
+* @param[in, out] state - Stan automatu.
+* @return Liczba przejrzanych znaków, łącznie ze znakiem, po którym automat
+*         osiągnął stan końcowy.
+*/
+static size_t runLexer(char const *s, size_t n, int *state) {
+	size_t i = 0;
+
+	while (i < n && *state < STATES) {
+		if (*state == COMMENT) {
+			i += commentSpan(s + i, n - i);
+
+			if (i == n)
+				break;
+		}
+
+		*state = transition[*state][charClass[(unsigned char)s[i++]]];
+	}
+
+	return i;
+}
+
+/** @brief Pomija komentarze i białe znaki.
+* Wczytuje wszystkie białe znaki i komentarze, które mogą pojawić się
+* między słowami operacji, zaczynając w stanie @p state automatu opisanego
+* tablicą @ref transition. Białe znaki pomijane są znak po znaku, a treść
+* komentarza w całości za pomocą funkcji @ref commentSpan. Pierwszy znak
+* kolejnego słowa staje się nieprzetworzonym znakiem struktury @p r.
+* @param[in] r - Wskaźnik na strukturę wczytującą.
+* @param[in] state - Stan początkowy automatu.
+* @return Wartość @p OK, jeżeli pomyślnie wczytano komentarze i można
+*		  kontynuować wczytywanie.
+*		  Wartość @p GOOD_EOF, jeżeli wejście skończy się podczas wczytywania
+*		  białych znaków.
+*		  Wartość @p ERROR_EOF, jeżeli wejście skończy się w obrębie
+*		  komentarza.
+*		  Wartość @p SYNTAX_ERROR, gdy po znaku komentarza nie występuje
+*		  drugi taki znak.
+*/
+int readIrrelevant(Reader *r, int state) {
 	while (1) {
-		char d = readChar(r);
+		bool starved = r->starved;
 
-		if (isOK(d, num)) {
-			bool b = insertChar(r, d);
+		if (r->pos == r->length && refill(r, r->length) <= 0) {
+			// Funkcja processInput dokończy przeglądanie kolejnych znaków
+			// od tego stanu.
+			if (!starved && r->starved)
+				r->scanState = state;
 
-			if(!b) {
-				printMemoryError();
-				return NULL;
-			}
+			r->read++;
+			return transition[state][CHAR_END] - STATES;
 		}
-		else {
-			char *word = toString(r);
 
-			if (word == NULL) {
-				printMemoryError();
-				return NULL;
-			}
+		char const *s = r->buffer + r->pos;
+		size_t i = runLexer(s, r->length - r->pos, &state);
 
-			removeLetters(r, 0);
-			bool b = insertChar(r, d); 
+		r->read += i;
+		r->consumed += i;
+		r->pos += i;
 
-			if (!b) {
-				printMemoryError();
-				free(word);
-				return NULL;
-			}
+		if (state >= STATES) {
+			if (state == FINAL(OK))
+				keepChar(r, s[i - 1]);
 
-			return word;
+			return state - STATES;
 		}
 	}
 }
 
-/** @brief Zwraca wynik wczytywania komentarza
-* Wczytuje komentarz i białe znaki i zwraca wartość informującą, czy wczytywanie
-* przebiegło pomyślnie. Wartości zwracane są dopasowane tak, aby funkcję można
-* było wygodnie używać wewnątrz funkcji processComment.
+/** @brief Przetwarza komentarz.
+* Pomija komentarze i białe znaki poprzedzające kolejne słowo, zaczynając
+* od nieprzetworzonego znaku struktury @p r, i wypisuje stosowny komunikat
+* na wyjście diagnostyczne, gdy wystąpi błąd.
 * @param[in] r - Wskaźnik na strukturę wczytującą znaki.
 * @param[in] middle - przyjmuje wartość @p true jeśli komentarz wczytywany jest
-* 					  między słowami kluczowymi pewnej operacji, zaś wartość  
+* 					  między słowami kluczowymi pewnej operacji, zaś wartość
 *					  @p false w przeciwnym przypadku.
-* @param[in] comment - przyjmuje wartość @p true jeśli wczytywany jest komentraz,
-* 					   lub @p false jeśli wczytywane są białe znaki.
 * @return Wartość @p GO_ON jeżeli pomyślnie wczytano komentarz i można dalej
 * 		 wczytywać dane.
-* 		 Wartość @p END gdy pomyślnie wczytano dane struktura wczytująca 
+* 		 Wartość @p END gdy pomyślnie wczytano dane struktura wczytująca
 * 		 napotkała znak EOF.
-*		 Wartość @p ERROR gdy wystąpi błąd wczytywania lub nie uda się 
+*		 Wartość @p ERROR gdy wystąpi błąd wczytywania lub nie uda się
 *		 zaalokować pamięci.
 */
-int processCommentHelper (Reader *r, bool middle, bool comment) {
-	int n = readIrrelevant(r, comment);
+int processComment (Reader *r, bool middle) {
+	int state;
+
+	if (!r->hasCurrent)
+		state = BLANK;
+	else {
+		switch (charClass[(unsigned char)r->current]) {
+			case CHAR_SPACE:
+				state = BLANK;
+				break;
+
+			case CHAR_COMMENT:
+				state = GLUED_OPENING;
+				break;
+
+			case CHAR_END:
+				return middle ? ERROR : GOOD_EOF;
+
+			default:
+				return GO_ON;
+		}
+	}
+
+	dropCurrent(r);
+
+	int n = readIrrelevant(r, state);
 	printError(r, n, middle);
 
 	if (n == OK)
@@ -462,121 +824,279 @@ int processCommentHelper (Reader *r, bool middle, bool comment) {
 	return ERROR;
 }
 
-/** @brief Przetwarza komentarz.
-* Za pomocą wcześniejszych operacji wczytuje komentarz i wykrywa ewentualne
-* błędy wypisując stosowny komunikat na wyjście diagnostyczne.
+/** @brief Wczytuje pozostałe znaki operatora.
+* Gdy wczytana zostaje pierwsza litera operatora "NEW", "DEL", "COPY",
+* "SAVE", "LOAD", "IMPORT" lub "STATS"
+* funkcja sprawdza, czy następne znaki odpowiadają kolejnym literom
+* wczytywanego operatora i czy po nim występuje biały znak lub komentarz,
+* i wypisuje odpowiedni komunikat w razie błędu.
 * @param[in] r - Wskaźnik na strukturę wczytującą znaki.
-* @param[in] middle - przyjmuje wartość @p false, jeżeli funkcja readIrrelevant
-* 			 została wywołana przed lub po wczytaniu komponentów niezbędnych do
-*			 wykonania operacji oraz wartość @p false jeżeli została wywołana 
-*			 między tymi Stringami.
-* @return Wartość @p GO_ON jeżeli pomyślnie wczytano komentarz i można dalej
-* 		 wczytywać dane.
-* 		 Wartość @p END gdy pomyślnie wczytano dane struktura wczytująca 
-* 		 napotkała znak EOF.
-*		 Wartość @p ERROR gdy wystąpi błąd wczytywania lub nie uda się 
-*		 zaalokować pamięci.
+* @param[in] operator - Wskaźnik na stringa będącego resztą nazwy operatora.
+* @param[in] last - przyjmuje wartość @p true, jeśli operator nie ma
+*                   argumentów, więc po nim może skończyć się wejście.
+* @return Wartość @p true gdy następne wczytane znaki są resztą nazwy operatora,
+*		  Wartość @p fasle w przeciwnym wypadku.
 */
-int processComment (Reader *r, bool middle) {
-	if (r->size == 0)
-		insertChar(r, ' ');
+bool readOperator (Reader *r, char const *operator, bool last) {
+	for (int i = 0; operator[i] != '\0'; i++) {
+		char c = readChar(r);
+
+		if (c == EOF) {
+			printErrorEOF(r);
+			return false;
+		}
+
+		if (c != operator[i]) {
+			printSyntaxError(r, r->read);
+			return false;
+		}
+	}
 
-	char c = r->list->beg->next->ch;
+	int next = charClass[(unsigned char)peekChar(r)];
 
-	if (isspace(c)) {
-		removeLetters(r, 0);
-		return processCommentHelper(r, middle, false);
+	if (next != CHAR_SPACE && next != CHAR_COMMENT && (!last || next != CHAR_END)) {
+		printSyntaxError(r, r->read + 1);
+		return false;
 	}
 
-	if (c == COMMENT_CHAR) {
-		removeLetters(r, 0);
+	return true;
+}
+
+/** @brief Wyznacza przekierowanie numeru.
+* Zapisuje przekierowanie numeru @p num w buforze wyników Readera @p r,
+* powiększając bufor, gdy wynik się w nim nie mieści.
+* @param[in] r - Wskaźnik na strukturę wczytującą znaki.
+* @param[in] pf - Wskaźnik na strukturę przechowującą przekierowania.
+* @param[in] num - Wskaźnik na przekierowywany numer.
+* @param[in] n - Długość numeru.
+* @return Wartość @p true gdy wynik został zapisany w buforze,
+*		  Wartość @p false gdy nie udało się zaalokować pamięci.
+*/
+bool forwardNumber (Reader *r, struct PhoneForward *pf, char const *num,
+					size_t n) {
+	size_t len = phfwdGetIntoN(pf, num, n, r->result, r->resultSize);
+
+	if (len < r->resultSize)
+		return true;
 
-		char d = readChar(r);
+	char *result = (char*)realloc(r->result, sizeof(char) * (2 * len + 1));
+
+	if (result == NULL)
+		return false;
 
-		if (d != COMMENT_CHAR) {
-			printSyntaxError(r->read);
+	r->result = result;
+	r->resultSize = 2 * len + 1;
+	phfwdGetIntoN(pf, num, n, r->result, r->resultSize);
+
+	return true;
+}
+
+/** @brief Przetwarza operację typu numer numer ... numer ?.
+* Wczytuje kolejne numery aż do znaku '?', a następnie wypisuje
+* przekierowania wszystkich wczytanych numerów, wyznaczone jednym
+* wywołaniem funkcji phfwdGetBatch.
+* @param[in] r - Wskaźnik na strukturę wczytującą znaki.
+* @param[in] h - Wskaźnik na centralę, na której wykonana zostanie operacja.
+* @param[in] fstNum - Wskaźnik na pierwszy, już wczytany numer.
+* @return Wartość @p GO_ON jeżeli operację wykonano pomyślnie,
+*		  Wartość @p ERROR gdy wystąpi błąd lub nie uda się zaalokować pamięci.
+*/
+int processBatch (Reader *r, Head *h, char *fstNum) {
+	size_t n = 1;
+	size_t capacity = 2;
+	char **nums = (char**)malloc(sizeof(char*) * capacity);
+
+	if (nums == NULL) {
+		printReaderMemoryError(r);
+		return ERROR;
+	}
+
+	nums[0] = fstNum;
+	char c = r->current;
+
+	while (isDigit(c)) {
+		if (n == capacity) {
+			char **bigger = (char**)realloc(nums, sizeof(char*) * 2 * capacity);
+
+			if (bigger == NULL) {
+				printReaderMemoryError(r);
+				free(nums);
+				return ERROR;
+			}
+
+			nums = bigger;
+			capacity *= 2;
+		}
+
+		nums[n] = readWord(r, true);
+
+		if (nums[n] == NULL) {
+			free(nums);
 			return ERROR;
 		}
 
-		return processCommentHelper(r, middle, true);
+		n++;
+		int x = processComment(r, true);
+
+		if (x != OK) {
+			free(nums);
+			return x;
+		}
+
+		c = r->current;
 	}
 
-	if (c == EOF) {
-		if (middle)
-			return ERROR;
+	if (c != '?') {
+		printSyntaxError(r, r->read);
+		free(nums);
+		return ERROR;
+	}
+
+	int k = h->recent;
+	struct PhoneNumbers const *pnum = NULL;
+
+	if (k != NONE)
+		pnum = phfwdGetBatch((h->base + k)->pf, (char const * const *)nums, n);
+
+	free(nums);
 
-		return GOOD_EOF;
+	if (pnum == NULL) {
+		printOperatorError(r, "?", r->read);
+		return ERROR;
 	}
 
+	bool b = true;
+
+	for (size_t i = 0; i < n && b; i++)
+		b = printLine(r->out, phnumGet(pnum, i));
+
+	phnumDelete(pnum);
+
+	if (!b) {
+		printReaderMemoryError(r);
+		return ERROR;
+	}
+
+	dropCurrent(r);
+
 	return GO_ON;
 }
 
-/** @brief Wczytuje pozostałe znaki operatora.
-* Gdy wczytana zostaje pierwsza litera operatora "NEW" lub "DEL"
-* funkcja sprawdza, czy następne znaki odpowiadają kolejnym literom
-* wczytywanego operatora i wypisuje odpowiedni komunikat w razie błędu.
-* @param[in] r - Wskaźnik na strukturę wczytującą znaki.
-* @param[in] operator - Wskaźnik na stringa będącego resztą nazwy operatora.
-* @return Wartość @p true gdy następne wczytane znaki są resztą nazwy operatora,
-*		  Wartość @p fasle w przeciwnym wypadku.
+/** @brief Porównuje bazy według identyfikatorów.
+* @param[in] a - Wskaźnik na wskaźnik na pierwszą bazę.
+* @param[in] b - Wskaźnik na wskaźnik na drugą bazę.
+* @return Wartość ujemna, zero lub dodatnia, gdy identyfikator pierwszej bazy
+*         jest mniejszy, równy lub większy od identyfikatora drugiej.
 */
-bool readOperator (Reader *r, char const *operator) {
-	int len = strlen(operator);
+int compareBases (void const *a, void const *b) {
+	return strcmp((*(Base const * const *)a)->name, (*(Base const * const *)b)->name);
+}
 
-	for (int i = 0; i < len; i++) {
-		char c = readChar(r);
+/** @brief Wypisuje statystyki bazy.
+* Wypisuje wiersz z rozmiarem drzewa bazy oraz, dla każdego rodzaju
+* wywołanych na niej operacji, wiersz z liczbą wywołań i percentylami ich
+* czasów w nanosekundach.
+* @param[in] r - Wskaźnik na strukturę wczytującą znaki.
+* @param[in] b - Wskaźnik na bazę.
+* @return Wartość @p true gdy statystyki zostały wypisane,
+*		  Wartość @p false gdy nie udało się zaalokować pamięci.
+*/
+bool printBaseStats (Reader *r, Base const *b) {
+	struct PhoneForwardStats *stats = (struct PhoneForwardStats*)malloc(sizeof(struct PhoneForwardStats));
 
-		if (c == EOF) {
-			printErrorEOF();
-			return false;
-		}
+	if (stats == NULL || !phfwdStats(b->pf, stats)) {
+		free(stats);
+		return false;
+	}
 
-		if (c != operator[i]) {
-			printSyntaxError(r->read);
-			return false;
-		}
+	// Identyfikator może być dowolnie długi, więc wypisujemy go osobno.
+	size_t length = strlen(b->name);
+	char line[STATS_LENGTH];
+	snprintf(line, STATS_LENGTH, " nodes %zu node_bytes %zu string_bytes %zu max_depth %zu",
+			 stats->nodes, stats->nodeBytes, stats->stringBytes, stats->maxDepth);
+	bool printed = printText(r->out, b->name, length) && printLine(r->out, line);
+
+	for (int op = 0; printed && op < PHFWD_OPERATIONS; op++) {
+		if (stats->calls[op] == 0)
+			continue;
+
+		snprintf(line, STATS_LENGTH, " %s calls %llu p50 %llu p90 %llu p99 %llu max %llu",
+				 operationNames[op], (unsigned long long)stats->calls[op],
+				 (unsigned long long)phstatsPercentile(stats, op, 0.5),
+				 (unsigned long long)phstatsPercentile(stats, op, 0.9),
+				 (unsigned long long)phstatsPercentile(stats, op, 0.99),
+				 (unsigned long long)phstatsPercentile(stats, op, 1));
+		printed = printText(r->out, b->name, length) && printLine(r->out, line);
 	}
 
-	return true;
+	free(stats);
+
+	return printed;
+}
+
+/** @brief Przetwarza operację STATS.
+* Wypisuje statystyki wszystkich baz centrali w kolejności ich
+* identyfikatorów.
+* @param[in] r - Wskaźnik na strukturę wczytującą znaki.
+* @param[in] h - Wskaźnik na centralę.
+* @return Wartość @p true gdy statystyki zostały wypisane,
+*		  Wartość @p false gdy nie udało się zaalokować pamięci.
+*/
+bool processStats (Reader *r, Head *h) {
+	Base const **bases = (Base const**)malloc(sizeof(Base*) * (h->size + 1));
+
+	if (bases == NULL)
+		return false;
+
+	size_t n = 0;
+
+	for (size_t i = 0; i < h->capacity; i++)
+		if (h->base[i].pf != NULL)
+			bases[n++] = h->base + i;
+
+	qsort(bases, n, sizeof(Base*), compareBases);
+	bool b = true;
+
+	for (size_t i = 0; i < n && b; i++)
+		b = printBaseStats(r, bases[i]);
+
+	free(bases);
+
+	return b;
 }
 
 int processOperation (Reader *r, Head *h) {
+	// Słowa poprzedniej operacji nie są już potrzebne.
+	releaseWords(r);
+
 	// Najpierw wczytujemy komentarze.
 	int x = processComment(r, false);
 
 	if (x != GO_ON)
 		return x;
 
-	char c = r->list->beg->next->ch;
+	char c = r->current;
 
 	// Gdy operacja zaczyna się słowem "NEW".
 	if (c == 'N') {
 		int entrySize = r->read;
 
 		// Są to kolejne litery operatora "NEW".
-		bool bo = readOperator(r, "EW");
+		bool bo = readOperator(r, "EW", false);
 
 		if (!bo)
 			return ERROR;
 
-		char c = getchar();
-		if (!isspace(c) && c != COMMENT_CHAR) {
-			printSyntaxError(r->read + 1);
-			return ERROR;
-		}
-		ungetc(c, stdin);
-
-
-		removeLetters(r, 0);
+		dropCurrent(r);
 		int x = processComment(r, true);
 
 		if (x != OK)
 			return x;
 
-		c = r->list->beg->next->ch;
+		c = r->current;
 
 		if (isDigit(c) || !isLetter(c)) {
-			printSyntaxError(r->read);
+			printSyntaxError(r, r->read);
 			return ERROR;
 		}
 
@@ -586,16 +1106,93 @@ int processOperation (Reader *r, Head *h) {
 			return ERROR;
 
 		if (strcmp(name, "NEW") == 0 || strcmp(name, "DEL") == 0) {
-			printSyntaxError(r->read);
-			free(name);
+			printSyntaxError(r, r->read);
 			return ERROR;
 		}
 
 		bool b = newBase(h, name);
-		free (name);
 
 		if (!b) {
-			printOperatorError("NEW", entrySize);
+			printOperatorError(r, "NEW", entrySize);
+			return ERROR;
+		}
+
+		return GO_ON;
+	}
+
+	// Gdy operacja zaczyna się słowem "STATS".
+	if (c == 'S' && peekChar(r) == 'T') {
+		int entrySize = r->read;
+
+		if (!readOperator(r, "TATS", true))
+			return ERROR;
+
+		dropCurrent(r);
+
+		if (!processStats(r, h)) {
+			printOperatorError(r, "STATS", entrySize);
+			return ERROR;
+		}
+
+		return GO_ON;
+	}
+
+	// Gdy operacja zaczyna się słowem "COPY", "SAVE", "LOAD" lub "IMPORT".
+	if (c == 'C' || c == 'S' || c == 'L' || c == 'I') {
+		int entrySize = r->read;
+		char const *operator = c == 'C' ? "COPY" : c == 'S' ? "SAVE"
+							   : c == 'L' ? "LOAD" : "IMPORT";
+
+		bool bo = readOperator(r, operator + 1, false);
+
+		if (!bo)
+			return ERROR;
+
+
+		// Wczytujemy identyfikator bazy, a następnie identyfikator kopii
+		// lub nazwę pliku.
+		bool file = c != 'C';
+		char *args[2] = {NULL, NULL};
+
+		for (int i = 0; i < 2; i++) {
+			dropCurrent(r);
+			int x = processComment(r, true);
+
+			if (x != OK)
+				return x;
+
+			char e = r->current;
+			bool path = file && i == 1;
+
+			if (path ? !isPathChar(e) : isDigit(e) || !isLetter(e)) {
+				printSyntaxError(r, r->read);
+				return ERROR;
+			}
+
+			args[i] = path ? readToken(r, isPathChar) : readWord(r, false);
+
+			if (args[i] == NULL)
+				return ERROR;
+
+			if (!path && (strcmp(args[i], "NEW") == 0 || strcmp(args[i], "DEL") == 0)) {
+				printSyntaxError(r, r->read);
+				return ERROR;
+			}
+		}
+
+		bool b;
+
+		if (c == 'C')
+			b = copyBase(h, args[0], args[1]);
+		else if (c == 'S')
+			b = saveBase(h, args[0], args[1]);
+		else if (c == 'L')
+			b = loadBase(h, args[0], args[1]);
+		else
+			b = importBase(h, args[0], args[1]);
+
+		if (!b) {
+			printOperatorError(r, operator, entrySize);
 			return ERROR;
 		}
 
@@ -606,28 +1203,22 @@ int processOperation (Reader *r, Head *h) {
 	if (c == 'D') {
 		int entrySize = r->read;
 		
-		bool bo = readOperator(r, "EL");
+		bool bo = readOperator(r, "EL", false);
 
 		if (!bo)
 			return ERROR;
 
-		char c = getchar();
-		if (!isspace(c) && c != COMMENT_CHAR) {
-			printSyntaxError(r->read + 1);
-			return ERROR;
-		}
-		ungetc(c, stdin);
 
-		removeLetters(r, 0);
+		dropCurrent(r);
 		int x = processComment(r, true);
 
 		if (x != OK)
 			return x;
 
-		c = r->list->beg->next->ch;
+		c = r->current;
 
 		if (!isLetter(c)) {
-			printSyntaxError(r->read);
+			printSyntaxError(r, r->read);
 			return ERROR;
 		}
 
@@ -641,13 +1232,11 @@ int processOperation (Reader *r, Head *h) {
 			int k = h->recent;
 
 			if (k == NONE) {
-				printOperatorError("DEL", entrySize);
-				free(number);
+				printOperatorError(r, "DEL", entrySize);
 				return ERROR;
 			}
 
 			phfwdRemove((h->base + k)->pf, number);
-			free(number);
 
 			return GO_ON;
 		}
@@ -660,16 +1249,14 @@ int processOperation (Reader *r, Head *h) {
 				return ERROR;
 
 			if (strcmp(name, "NEW") == 0 || strcmp(name, "DEL") == 0) {
-				printSyntaxError(r->read);
-				free(name);
+				printSyntaxError(r, r->read);
 				return ERROR;
 			}
 
 			bool b = delBase(h, name);
-			free (name);
 
 			if (!b) {
-				printOperatorError("DEL", entrySize);
+				printOperatorError(r, "DEL", entrySize);
 				return ERROR;
 			}
 
@@ -684,18 +1271,20 @@ int processOperation (Reader *r, Head *h) {
 		if (fstNum == NULL)
 			return ERROR;
 
+		size_t fstLength = r->wordLength;
 		int x = processComment(r, true);
 
-		if (x != OK){
-			free(fstNum);
+		if (x != OK)
 			return x;
-		}
 
-		c = r->list->beg->next->ch;
+		c = r->current;
+
+		// Operacja typu numer numer ... numer ?.
+		if (isDigit(c))
+			return processBatch(r, h, fstNum);
 
 		if (c != '?' && c != '>') {
-			printSyntaxError(r->read);
-			free (fstNum);
+			printSyntaxError(r, r->read);
 			return ERROR;
 		}
 
@@ -705,25 +1294,24 @@ int processOperation (Reader *r, Head *h) {
 			int k = h->recent;
 
 			if (k == NONE) {
-				printOperatorError("?", r->read);
-				free(fstNum);
+				printOperatorError(r, "?", r->read);
 				return ERROR;
 			}
 
 			else {
-				struct PhoneNumbers const *pnum; 
-				pnum = phfwdGet((h->base + k)->pf, fstNum);
-				free(fstNum);
+				bool b = forwardNumber(r, (h->base + k)->pf, fstNum, fstLength);
 
-				if (pnum == NULL) {
-					printOperatorError("?", r->read);
+				if (!b) {
+					printOperatorError(r, "?", r->read);
 					return ERROR;
 				}
 
-				printf("%s\n", phnumGet(pnum, 0));
+				if (!printLine(r->out, r->result)) {
+					printReaderMemoryError(r);
+					return ERROR;
+				}
 
-				phnumDelete(pnum);
-				removeLetters(r, 0);
+				dropCurrent(r);
 
 				return GO_ON;
 			}
@@ -732,45 +1320,37 @@ int processOperation (Reader *r, Head *h) {
 		// Operacja typu numer > numer.
 		else {
 			int entrySize = r->read; 
-			removeLetters(r, 0);
+			dropCurrent(r);
 
 			int x = processComment(r, true);
 
-			if (x != OK){
-				free(fstNum);
+			if (x != OK)
 				return x;
-			}
 
-			char c = r->list->beg->next->ch;
+			char c = r->current;
 
 			if (!isDigit(c)) {
-				printSyntaxError(r->read);
-				free(fstNum);
+				printSyntaxError(r, r->read);
 				return ERROR;
 			}
 			
 			char *sndNum = readWord(r, true);
 
-			if (sndNum == NULL) {
-				free(fstNum);
+			if (sndNum == NULL)
 				return ERROR;
-			}
 			
 			int k = h-> recent;
 
 			if (k == NONE) {
-				printOperatorError(">", entrySize);
-				free(fstNum);
-				free(sndNum);
+				printOperatorError(r, ">", entrySize);
 				return ERROR;
 			}
 
-			bool b = phfwdAdd((h->base + k)->pf , fstNum, sndNum);
-			free(fstNum);
-			free(sndNum);
+			bool b = phfwdAddN((h->base + k)->pf, fstNum, fstLength, sndNum,
+							   r->wordLength);
 
 			if (!b) {
-				printOperatorError(">", entrySize);
+				printOperatorError(r, ">", entrySize);
 				return ERROR;
 			}
 
@@ -778,19 +1358,20 @@ int processOperation (Reader *r, Head *h) {
 		}
 	}
 
-	// Operacja typu ?numer.
-	if (c == '?') {
+	// Operacja typu ?numer lub !numer.
+	if (c == '?' || c == '!') {
 		int entrySize = r->read;
-		removeLetters(r, 0);
+		char const *operator = c == '?' ? "?" : "!";
+		dropCurrent(r);
 		int x = processComment(r, true);
 
 		if (x != OK)
 			return x;
 
-		c = r->list->beg->next->ch;
+		c = r->current;
 
 		if (!isDigit(c)) {
-			printSyntaxError(r->read);
+			printSyntaxError(r, r->read);
 			return ERROR;
 		}
 
@@ -802,43 +1383,56 @@ int processOperation (Reader *r, Head *h) {
 		int k = h->recent;
 
 		if (k == NONE) {
-			printOperatorError("?", entrySize);
-			free(num);
+			printOperatorError(r, operator, entrySize);
 			return ERROR;
 		}
 
-		struct PhoneNumbers const * pnum;
-		pnum = phfwdReverse((h->base + k)->pf, num);
-		free(num);
+		// numery wypisujemy na bieżąco, w miarę ich wyznaczania; operacja
+		// !numer wypisuje tylko te, których przekierowaniem jest numer.
+		struct PhoneForward *pf = (h->base + k)->pf;
+		struct ReverseIterator *it = *operator == '?' ? phfwdReverseIterator(pf, num)
+									 : phfwdGetReverseIterator(pf, num);
 
-		if (pnum == NULL) {
-			printOperatorError("?", entrySize);
+		if (it == NULL) {
+			printOperatorError(r, operator, entrySize);
 			return ERROR;
 		}
 
 		char const *numer;
-			
-		size_t idx = 0;
-		while ((numer = phnumGet(pnum, idx++)) != NULL)
-     	printf("%s\n", numer);
-     	phnumDelete(pnum);
+		bool b;
+		bool printed = true;
+
+		while (printed && (b = phrevNext(it, &numer)) && numer != NULL)
+			printed = printLine(r->out, numer);
+
+		phrevDelete(it);
+
+		if (!printed) {
+			printReaderMemoryError(r);
+			return ERROR;
+		}
 
-     	return GO_ON;
+		if (!b) {
+			printOperatorError(r, operator, entrySize);
+			return ERROR;
+		}
+
+		return GO_ON;
 	}
 
 	//operacja typu @numer.
 	if (c == '@') {
 		int entrySize = r->read;
-		removeLetters(r, 0);
+		dropCurrent(r);
 		int x = processComment(r, true);
 
 		if (x != OK)
 			return x;
 
-		c = r->list->beg->next->ch;
+		c = r->current;
 
 		if (!isDigit(c)) {
-			printSyntaxError(r->read);
+			printSyntaxError(r, r->read);
 			return ERROR;
 		}
 
@@ -850,8 +1444,7 @@ int processOperation (Reader *r, Head *h) {
 		int k = h->recent;
 
 		if (k == NONE) {
-			printOperatorError("@", entrySize);
-			free(set);
+			printOperatorError(r, "@", entrySize);
 			return ERROR;
 		}
 
@@ -861,15 +1454,178 @@ int processOperation (Reader *r, Head *h) {
 			len = 0;
 
 		size_t result = phfwdNonTrivialCount((h->base + k)->pf, set, len);
-		free (set);
-		printf("%lu\n", result);
+
+		if (!printNumber(r->out, result)) {
+			printReaderMemoryError(r);
+			return ERROR;
+		}
+
+		return GO_ON;
+	}
+
+	// Operacja typu #numer.
+	if (c == '#') {
+		int entrySize = r->read;
+		dropCurrent(r);
+		int x = processComment(r, true);
+
+		if (x != OK)
+			return x;
+
+		c = r->current;
+
+		if (!isDigit(c)) {
+			printSyntaxError(r, r->read);
+			return ERROR;
+		}
+
+		char *num = readWord(r, true);
+
+		if (num == NULL)
+			return ERROR;
+
+		int k = h->recent;
+
+		if (k == NONE) {
+			printOperatorError(r, "#", entrySize);
+			return ERROR;
+		}
+
+		size_t result = phfwdReverseCount((h->base + k)->pf, num);
+
+		if (result == 0) {
+			printOperatorError(r, "#", entrySize);
+			return ERROR;
+		}
+
+		if (!printNumber(r->out, result)) {
+			printReaderMemoryError(r);
+			return ERROR;
+		}
 
 		return GO_ON;
 	}
 
 	else {
-		printSyntaxError(r->read);
+		printSyntaxError(r, r->read);
 		return ERROR;
 	}
 
-}
\ No newline at end of file
+}
+/** @brief Sprawdza, czy nowe znaki mogą zakończyć przerwaną operację.
+* Operacja przerwana w trakcie pomijania komentarzy i białych znaków może
+* się zakończyć dopiero wtedy, gdy automat je pomijający osiągnie stan
+* końcowy, więc wystarczy przejrzeć nim jedynie nowe znaki. Jeśli ich nie
+* ma lub nie kończą one pomijania, zapamiętuje nowy stan automatu.
+* @param[in, out] r - Wskaźnik na strukturę wczytującą.
+* @param[in] input - Wskaźnik na bufor z wejściem.
+* @param[in] size - Liczba znaków w buforze, które można przetworzyć.
+* @return Wartość @p true, jeśli operacje należy wczytać ponownie.
+*         Wartość @p false, gdy ponowne wczytanie zostałoby przerwane
+*         w tym samym miejscu.
+*/
+static bool resumeScan(Reader *r, char const *input, size_t size) {
+	if (size <= r->scanned)
+		return false;
+
+	if (r->scanState == STATES)
+		return true;
+
+	int state = r->scanState;
+	runLexer(input + r->scanned, size - r->scanned, &state);
+
+	if (state >= STATES)
+		return true;
+
+	r->scanState = state;
+	r->scanned = size;
+
+	return false;
+}
+
+int processInput (Reader *r, Head *h, char const *input, size_t size,
+				  bool closed, Output *out, size_t *used) {
+	*used = 0;
+
+	// Słowo kończące się na ostatnim znaku bufora mogłoby być dalej
+	// kontynuowane, więc przetwarzamy wejście tylko do ostatniego białego
+	// znaku. Znaki przerwanej operacji przejrzane przy poprzednim wywołaniu
+	// nie są przeglądane ponownie, dopóki kolejne znaki nie mogą jej
+	// zakończyć.
+	if (!closed) {
+		while (size > r->scanned && !isspace((unsigned char)input[size - 1]))
+			size--;
+
+		if (!resumeScan(r, input, size))
+			return GO_ON;
+	}
+
+	r->out = out;
+	r->err = out;
+
+	// Kopiujemy wejście do bufora, w którym można zapisywać zakończenia
+	// słów; miejsce na jeden dodatkowy znak pozwala umieścić przed nimi
+	// nieprzetworzony znak.
+	if (r->capacity < size + 1) {
+		free(r->buffer);
+		r->buffer = (char*)malloc(sizeof(char) * (size + 2));
+		r->capacity = r->buffer == NULL ? 0 : size + 1;
+
+		if (r->buffer == NULL) {
+			printReaderMemoryError(r);
+			return ERROR;
+		}
+	}
+
+	memcpy(r->buffer, input, size);
+	r->length = size;
+	r->pos = 0;
+	r->consumed = 0;
+	r->currentInBuffer = false;
+	r->closed = closed;
+
+	int x = GO_ON;
+
+	while (x == GO_ON) {
+		// Zapamiętujemy stan sprzed operacji, by móc do niego wrócić, jeśli
+		// zabraknie znaków.
+		size_t consumed = r->consumed;
+		int read = r->read;
+		bool hasCurrent = r->hasCurrent;
+		char current = r->current;
+		size_t written = outputLength(r->out);
+
+		r->starved = false;
+		x = processOperation(r, h);
+
+		if (r->starved) {
+			r->consumed = consumed;
+			r->read = read;
+			r->current = current;
+			r->hasCurrent = hasCurrent;
+			truncateOutput(r->out, written);
+			x = GO_ON;
+
+			break;
+		}
+	}
+
+	*used = r->consumed;
+	r->scanned = size - r->consumed;
+
+	// Bufory są zwalniane, by nieaktywna struktura zajmowała mało pamięci.
+	releaseWords(r);
+	free(r->spare.data);
+	free(r->buffer);
+	r->spare.data = NULL;
+	r->spare.capacity = 0;
+	r->buffer = NULL;
+	r->capacity = 0;
+	r->length = 0;
+	r->pos = 0;
+	r->currentInBuffer = false;
+	r->out = NULL;
+	r->err = NULL;
+
+	return x;
+}
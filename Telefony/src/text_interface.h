@@ -11,6 +11,7 @@
 #include <string.h>
 #include "phone_forward.h"
 #include "phone_forward_base.h"
+#include "text_output.h"
 
 /// Enumerator określający wynik przetwarzania operacji.
 enum ProcessOperationResult {
@@ -22,24 +23,31 @@ enum ProcessOperationResult {
 /// Numer pierwszego białego znaku w kodzie ASCII.
 #define FIRST_WHITE_SPACE 9
 
+/// Komunikat o braku pamięci.
+#define MEMORY_ERROR "zabrakło pamięci przy wczytywaniu"
+
 /// Numer ostatniego białego znaku w kodzie ASCII (nie licząc spacji)
 #define LAST_WHITE_SPACE 13
 
-/// Element listy.
-typedef struct Elem Elem;
-
-/// Struktura listy
-typedef struct List List;
-
 /// Struktura służąca do wczytywania wejścia.
 typedef struct Reader Reader;
 
 /** @brief Tworzy strukturę wczytującą.
- * Tworzy strukturę służącą do przetwarzania wejścia. 
+ * Tworzy strukturę służącą do przetwarzania standardowego wejścia. 
+ * @param[in] out - Wskaźnik na bufor, do którego wypisywane są wyniki.
+ * @param[in] err - Wskaźnik na bufor, do którego wypisywane są błędy.
  * @return Wskaźnik na utworzoną strukturę lub NULL jeśli nie udało się
  *         zaalokować pamięci.
  */
-Reader * newReader();
+Reader * newReader(Output *out, Output *err);
+
+/** @brief Tworzy strukturę wczytującą z bufora.
+ * Tworzy strukturę służącą do przetwarzania wejścia przekazywanego
+ * w kolejnych fragmentach funkcji @ref processInput.
+ * @return Wskaźnik na utworzoną strukturę lub NULL jeśli nie udało się
+ *         zaalokować pamięci.
+ */
+Reader * newBufferReader();
 
 /** @brief Usuwa strukturę wczytującą.
  * Usuwa strukturę służącą do przetwarzania wejścia. 
@@ -65,4 +73,31 @@ void printMemoryError();
  */
 int processOperation (Reader *r, Head *h);
 
+/** @brief Przetwarza operacje zapisane w buforze.
+ * Wykonuje kolejne operacje zapisane w buforze @p input, dopóki są one
+ * w nim zapisane w całości. Operacja, której końca jeszcze nie ma
+ * w buforze, nie jest wykonywana ani nie wypisuje błędu; należy ją
+ * przekazać ponownie, gdy nadejdą kolejne znaki. Jej znaki przejrzane
+ * przy poprzednim wywołaniu nie są przeglądane ponownie, dopóki kolejne
+ * znaki nie mogą jej zakończyć, więc operacja przesyłana w wielu
+ * fragmentach jest wczytywana w czasie liniowym względem jej długości.
+ * @param[in] r - Wskaźnik na strukturę utworzoną funkcją @ref newBufferReader.
+ * @param[in] h - Wskaźnik na centralę, na której wykonywane są operacje.
+ * @param[in] input - Wskaźnik na bufor z wejściem.
+ * @param[in] size - Liczba znaków w buforze.
+ * @param[in] closed - przyjmuje wartość @p true, jeśli po znakach z bufora
+ *                     nie pojawią się już kolejne.
+ * @param[in] out - Bufor, do którego wypisywane są wyniki i błędy.
+ * @param[out] used - Liczba znaków z początku bufora, które zostały
+ *                    przetworzone i nie należy ich przekazywać ponownie.
+ * @return Wartość @p GO_ON, jeżeli wszystkie operacje zapisane w całości
+ *         wykonano pomyślnie i należy czekać na kolejne znaki.
+ *         Wartość @p END, gdy wejście zostało zamknięte i przetworzone bez
+ *         błędu.
+ *         Wartość @p ERROR, gdy wystąpi błąd, tak jak w funkcji
+ *         @ref processOperation.
+ */
+int processInput (Reader *r, Head *h, char const *input, size_t size,
+				  bool closed, Output *out, size_t *used);
+
  #endif /* __TEXT_INTERFACE_H__ */
\ No newline at end of file
@@ -0,0 +1,199 @@
+/** @file
+ * Implementacja klasy buforującej wyniki interfejsu tekstowego.
+ *
+ * Wyniki zapytań są kopiowane do dużego bufora i zapisywane do deskryptora
+ * pojedynczymi wywołaniami write, bez blokad i formatowania biblioteki
+ * stdio. Wiersz dłuższy niż bufor jest zapisywany razem z zawartością bufora
+ * jednym wywołaniem writev, bez kopiowania.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "text_output.h"
+
+/// Rozmiar bufora zapisywanego do deskryptora.
+#define OUTPUT_SIZE 131072
+
+/// Początkowy rozmiar bufora gromadzonego w pamięci.
+#define MEMORY_OUTPUT_SIZE 256
+
+/// Maksymalna długość zapisu liczby wraz ze znakiem nowej linii.
+#define NUMBER_LENGTH 24
+
+/**
+ * Struktura buforująca wypisywane znaki.
+ */
+struct Output {
+	char *data;      ///< bufor ze znakami
+	size_t length;   ///< liczba znaków w buforze
+	size_t capacity; ///< rozmiar bufora
+	int fd;          ///< deskryptor, do którego zapisywane są znaki, lub -1
+};
+
+Output * newOutput(int fd) {
+	Output *o = (Output*)malloc(sizeof(Output));
+
+	if (o == NULL)
+		return NULL;
+
+	o->capacity = fd < 0 ? MEMORY_OUTPUT_SIZE : OUTPUT_SIZE;
+	o->data = (char*)malloc(sizeof(char) * o->capacity);
+
+	if (o->data == NULL) {
+		free(o);
+		return NULL;
+	}
+
+	o->length = 0;
+	o->fd = fd;
+
+	return o;
+}
+
+void clearOutput(Output *o) {
+	if (o == NULL)
+		return;
+
+	free(o->data);
+	free(o);
+}
+
+/** @brief Zapisuje fragmenty do deskryptora.
+* Zapisuje w całości kolejne fragmenty @p iov, ponawiając zapis, gdy
+* deskryptor przyjmie tylko ich część.
+* @param[in] fd - Deskryptor.
+* @param[in, out] iov - Tablica fragmentów; jest modyfikowana.
+* @param[in] count - Liczba fragmentów.
+* @return Wartość @p true, jeśli zapisano wszystkie fragmenty.
+*         Wartość @p false, gdy zapis się nie powiódł.
+*/
+static bool writeAll(int fd, struct iovec *iov, int count) {
+	while (count > 0) {
+		ssize_t n = writev(fd, iov, count);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			return false;
+		}
+
+		while (count > 0 && (size_t)n >= iov->iov_len) {
+			n -= iov->iov_len;
+			iov++;
+			count--;
+		}
+
+		if (count > 0) {
+			iov->iov_base = (char*)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+
+	return true;
+}
+
+bool flushOutput(Output *o) {
+	if (o->fd < 0 || o->length == 0)
+		return true;
+
+	struct iovec iov = {o->data, o->length};
+	o->length = 0;
+
+	return writeAll(o->fd, &iov, 1);
+}
+
+/** @brief Dopisuje znaki do bufora.
+* Dopisuje znaki @p s i, jeśli @p newline ma wartość @p true, znak nowej
+* linii. Gdy bufor zapisywany do deskryptora się zapełni, jest on
+* opróżniany, a znaki, które się w nim nie mieszczą, są zapisywane
+* bezpośrednio. Bufor gromadzony w pamięci jest powiększany; jeśli nie
+* uda się go powiększyć, znaki nie są dopisywane.
+* @param[in] o - Wskaźnik na strukturę buforującą.
+* @param[in] s - Wskaźnik na dopisywane znaki.
+* @param[in] n - Liczba dopisywanych znaków.
+* @param[in] newline - Czy dopisać znak nowej linii.
+* @return Wartość @p true, jeśli znaki zostały dopisane.
+*         Wartość @p false, gdy nie udało się powiększyć bufora.
+*/
+static bool append(Output *o, char const *s, size_t n, bool newline) {
+	size_t total = n + newline;
+
+	if (o->capacity - o->length < total) {
+		if (o->fd >= 0 && total > o->capacity) {
+			struct iovec iov[3] = {
+				{o->data, o->length}, {(char*)s, n}, {"\n", newline}
+			};
+			o->length = 0;
+			writeAll(o->fd, iov, 3);
+
+			return true;
+		}
+
+		if (o->fd >= 0) {
+			flushOutput(o);
+		}
+		else {
+			size_t capacity = 2 * o->capacity;
+
+			if (capacity - o->length < total)
+				capacity = o->length + total;
+
+			char *data = (char*)realloc(o->data, sizeof(char) * capacity);
+
+			if (data == NULL)
+				return false;
+
+			o->data = data;
+			o->capacity = capacity;
+		}
+	}
+
+	memcpy(o->data + o->length, s, n);
+	o->length += n;
+
+	if (newline)
+		o->data[o->length++] = '\n';
+
+	return true;
+}
+
+bool printText(Output *o, char const *s, size_t n) {
+	return append(o, s, n, false);
+}
+
+bool printLine(Output *o, char const *s) {
+	return append(o, s, strlen(s), true);
+}
+
+bool printNumber(Output *o, size_t n) {
+	char buf[NUMBER_LENGTH];
+	char *s = buf + NUMBER_LENGTH;
+
+	do {
+		*--s = '0' + n % 10;
+		n /= 10;
+	} while (n > 0);
+
+	return append(o, s, buf + NUMBER_LENGTH - s, true);
+}
+
+char const * outputData(Output *o) {
+	return o->data;
+}
+
+size_t outputLength(Output *o) {
+	return o->length;
+}
+
+void truncateOutput(Output *o, size_t length) {
+	if (length < o->length)
+		o->length = length;
+}
@@ -0,0 +1,93 @@
+/** @file
+ * Interfejs klasy buforującej wyniki interfejsu tekstowego.
+ *
+ * @author Philip Smolenski-Jensen
+ */
+
+#ifndef __TEXT_OUTPUT_H__
+#define __TEXT_OUTPUT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/// Struktura buforująca wypisywane znaki.
+typedef struct Output Output;
+
+/** @brief Tworzy strukturę buforującą.
+ * Tworzy strukturę, która gromadzi wypisywane znaki we własnym buforze
+ * i zapisuje je do deskryptora @p fd, gdy bufor się zapełni lub zostanie
+ * opróżniony funkcją @ref flushOutput. Dla ujemnego @p fd znaki są tylko
+ * gromadzone w pamięci, a bufor powiększa się w miarę potrzeby.
+ * @param[in] fd - Deskryptor, do którego zapisywane są znaki, lub @p -1.
+ * @return Wskaźnik na utworzoną strukturę lub NULL jeśli nie udało się
+ *         zaalokować pamięci.
+ */
+Output * newOutput(int fd);
+
+/** @brief Usuwa strukturę buforującą.
+ * Usuwa strukturę wraz ze znakami, które nie zostały zapisane. Nic nie
+ * robi, jeśli wskaźnik ma wartość NULL.
+ * @param[in] o - Wskaźnik na usuwaną strukturę.
+ */
+void clearOutput(Output *o);
+
+/** @brief Zapisuje zgromadzone znaki.
+ * Zapisuje do deskryptora struktury wszystkie znaki z bufora. Nic nie
+ * robi, jeśli znaki gromadzone są tylko w pamięci.
+ * @param[in] o - Wskaźnik na strukturę buforującą.
+ * @return Wartość @p true, jeśli zapisano wszystkie znaki.
+ *         Wartość @p false, gdy zapis się nie powiódł.
+ */
+bool flushOutput(Output *o);
+
+/** @brief Wypisuje znaki.
+ * @param[in] o - Wskaźnik na strukturę buforującą.
+ * @param[in] s - Wskaźnik na wypisywane znaki.
+ * @param[in] n - Liczba wypisywanych znaków.
+ * @return Wartość @p true, jeśli znaki zostały wypisane.
+ *         Wartość @p false, gdy nie udało się powiększyć bufora
+ *         gromadzonego w pamięci.
+ */
+bool printText(Output *o, char const *s, size_t n);
+
+/** @brief Wypisuje wiersz.
+ * Wypisuje napis @p s zakończony znakiem nowej linii.
+ * @param[in] o - Wskaźnik na strukturę buforującą.
+ * @param[in] s - Wskaźnik na wypisywany napis.
+ * @return Wartość @p true, jeśli znaki zostały wypisane.
+ *         Wartość @p false, gdy nie udało się powiększyć bufora
+ *         gromadzonego w pamięci.
+ */
+bool printLine(Output *o, char const *s);
+
+/** @brief Wypisuje liczbę.
+ * Wypisuje liczbę @p n zakończoną znakiem nowej linii.
+ * @param[in] o - Wskaźnik na strukturę buforującą.
+ * @param[in] n - Wypisywana liczba.
+ * @return Wartość @p true, jeśli znaki zostały wypisane.
+ *         Wartość @p false, gdy nie udało się powiększyć bufora
+ *         gromadzonego w pamięci.
+ */
+bool printNumber(Output *o, size_t n);
+
+/** @brief Podaje zgromadzone znaki.
+ * @param[in] o - Wskaźnik na strukturę buforującą.
+ * @return Wskaźnik na znaki znajdujące się w buforze.
+ */
+char const * outputData(Output *o);
+
+/** @brief Podaje liczbę zgromadzonych znaków.
+ * @param[in] o - Wskaźnik na strukturę buforującą.
+ * @return Liczba znaków znajdujących się w buforze.
+ */
+size_t outputLength(Output *o);
+
+/** @brief Wycofuje wypisane znaki.
+ * Usuwa z bufora znaki wypisane po tym, jak zawierał on @p length znaków.
+ * Znaki te nie mogą zostać wcześniej zapisane do deskryptora.
+ * @param[in] o - Wskaźnik na strukturę buforującą.
+ * @param[in] length - Liczba znaków, które pozostają w buforze.
+ */
+void truncateOutput(Output *o, size_t length);
+
+#endif /* __TEXT_OUTPUT_H__ */